@@ -0,0 +1,87 @@
+// Response compression: wire size per content-coding and where the CPU goes
+// - compressing once per data version at a high level versus compressing on
+// every request at a fast level.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "../compression.h"
+
+using namespace std;
+
+namespace {
+
+// Fast levels a per-request compressor would typically use
+int onTheFlyLevel(Encoding e) {
+    switch(e) {
+        case Encoding::Gzip: return 6;
+        case Encoding::Brotli: return 4;
+        case Encoding::Zstd: return 3;
+        default: return 0;
+    }
+}
+
+template<typename Fn>
+double averageUs(int iterations, Fn fn) {
+    auto start = bench::Clock::now();
+    for(int i = 0; i < iterations; i++) fn();
+    return bench::elapsedNs(start, bench::Clock::now()) / iterations / 1e3;
+}
+
+void comparePayload(const string& name, const string& body, int iterations) {
+    printf("\n  %s (%zu bytes identity)\n", name.c_str(), body.size());
+    printf("  %-10s %10s %8s %16s %18s %16s\n",
+           "encoding", "bytes", "ratio", "precompress(us)", "on-the-fly(us)", "serve(us)");
+
+    for(size_t i = 0; i < ENCODING_COUNT; i++) {
+        Encoding e = (Encoding)i;
+        if(!encodingAvailable(e)) {
+            printf("  %-10s %10s\n", encodingName(e), "n/a");
+            continue;
+        }
+
+        string compressed = e == Encoding::Identity ? body : compressBody(e, body);
+        double pre = e == Encoding::Identity ? 0 : averageUs(max(1, iterations / 10), [&] { compressBody(e, body); });
+        double fly = e == Encoding::Identity ? 0 : averageUs(iterations, [&] { compressBody(e, body, onTheFlyLevel(e)); });
+
+        // Serving a pre-compressed variant: negotiate and copy the bytes out
+        string accept = string(encodingName(e)) + ", identity;q=0.1";
+        size_t sink = 0;
+        double serve = averageUs(iterations * 10, [&] {
+            Encoding chosen = negotiateEncoding(accept);
+            string out = chosen == e ? compressed : body;
+            sink += out.size();
+        });
+
+        printf("  %-10s %10zu %7.2fx %16.1f %18.1f %16.2f\n",
+               encodingName(e), compressed.size(), (double)body.size() / compressed.size(), pre, fly, serve);
+        if(sink == 1) printf(" ");
+    }
+}
+
+} // namespace
+
+int runCompressionBench(const bench::Args& args) {
+    int coinCount = (int)args.getInt("coins", 50);
+    int iterations = (int)args.getInt("iterations", 50);
+
+    MarketSnapshot snapshot;
+    snapshot.coins = bench::makeSyntheticCoins(coinCount);
+    snapshot.index.rebuild(snapshot.coins);
+
+    auto start = bench::Clock::now();
+    renderResponses(snapshot);
+    double renderMs = bench::elapsedNs(start, bench::Clock::now()) / 1e6;
+
+    printf("compression: %d coins, full render + precompress of every payload: %.1f ms per data version\n",
+           coinCount, renderMs);
+    printf("  precompress = default pre-compression level, once per data version\n");
+    printf("  on-the-fly  = fast level, paid on every request without the cache\n");
+    printf("  serve       = Accept-Encoding negotiation + copying the cached variant\n");
+
+    comparePayload("/api/coins", snapshot.responses.coinsJson.identity(), iterations);
+    comparePayload("/api/coin/<id>", snapshot.responses.coinJson[0]->identity(), iterations);
+    return 0;
+}
@@ -0,0 +1,133 @@
+// Read-path contention: readers fetching the /api/coins body while a writer
+// runs the live-update pass, with the old global-mutex layout versus
+// snapshots published through an atomic shared_ptr.
+
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace std;
+
+namespace {
+
+// One tick of the rolling-window update, as done by updateLiveData()
+void appendTick(vector<CoinData>& coins, long long now) {
+    for(auto& coin : coins) {
+        for(const auto& spec : PERIODS) {
+            coin.historicalData.mutate().append(spec.period, now, coin.price);
+        }
+        coin.price *= 1.0001;
+    }
+}
+
+struct Samples {
+    vector<double> idle;
+    vector<double> duringUpdate;
+};
+
+// Run `read` on several threads while `write` runs back to back on another,
+// tagging every read sample by whether an update was in flight when it started.
+template<typename ReadFn, typename WriteFn>
+Samples runContention(int readers, int seconds, ReadFn read, WriteFn write) {
+    atomic<bool> stop{false};
+    atomic<bool> writing{false};
+    vector<Samples> perThread(readers);
+    vector<thread> threads;
+
+    for(int r = 0; r < readers; r++) {
+        threads.emplace_back([&, r] {
+            Samples& out = perThread[r];
+            size_t sink = 0;
+            while(!stop.load(memory_order_relaxed)) {
+                bool duringUpdate = writing.load(memory_order_relaxed);
+                auto start = bench::Clock::now();
+                sink += read();
+                double ns = bench::elapsedNs(start, bench::Clock::now());
+                (duringUpdate ? out.duringUpdate : out.idle).push_back(ns);
+            }
+            if(sink == 42) printf(" ");
+        });
+    }
+
+    thread writer([&] {
+        long long now = 1760000000000LL;
+        while(!stop.load(memory_order_relaxed)) {
+            writing = true;
+            write(now += 300000);
+            writing = false;
+            this_thread::sleep_for(chrono::milliseconds(5));
+        }
+    });
+
+    this_thread::sleep_for(chrono::seconds(seconds));
+    stop = true;
+    writer.join();
+    for(auto& t : threads) t.join();
+
+    Samples all;
+    for(auto& s : perThread) {
+        all.idle.insert(all.idle.end(), s.idle.begin(), s.idle.end());
+        all.duringUpdate.insert(all.duringUpdate.end(), s.duringUpdate.begin(), s.duringUpdate.end());
+    }
+    return all;
+}
+
+} // namespace
+
+int runContentionBench(const bench::Args& args) {
+    int coinCount = (int)args.getInt("coins", 50);
+    int readers = (int)args.getInt("readers", 4);
+    int seconds = (int)args.getInt("seconds", 3);
+
+    printf("contention: %d coins, %d reader threads, %ds per mode\n", coinCount, readers, seconds);
+    vector<CoinData> seed = bench::makeSyntheticCoins(coinCount);
+
+    // Global mutex: writer holds the lock for the whole pass and re-render
+    Samples mutexSamples;
+    {
+        mutex dataMutex;
+        MarketSnapshot shared;
+        shared.coins = seed;
+        renderResponses(shared);
+
+        mutexSamples = runContention(readers, seconds,
+            [&] {
+                lock_guard<mutex> lock(dataMutex);
+                string body = shared.responses.coinsJson.identity();
+                return body.size();
+            },
+            [&](long long now) {
+                lock_guard<mutex> lock(dataMutex);
+                appendTick(shared.coins, now);
+                renderResponses(shared);
+            });
+    }
+
+    // Snapshot: writer builds the next version off to the side and swaps it in
+    Samples snapshotSamples;
+    {
+        updateSnapshot([&](MarketSnapshot& next) { next.coins = seed; });
+
+        snapshotSamples = runContention(readers, seconds,
+            [] {
+                SnapshotPtr snapshot = currentSnapshot();
+                string body = snapshot->responses.coinsJson.identity();
+                return body.size();
+            },
+            [](long long now) {
+                updateSnapshot([&](MarketSnapshot& next) { appendTick(next.coins, now); });
+            });
+    }
+
+    bench::printLatencyHeader();
+    bench::printLatencyRow("mutex / idle", bench::summarize(mutexSamples.idle));
+    bench::printLatencyRow("mutex / during update", bench::summarize(mutexSamples.duringUpdate));
+    bench::printLatencyRow("snapshot / idle", bench::summarize(snapshotSamples.idle));
+    bench::printLatencyRow("snapshot / during update", bench::summarize(snapshotSamples.duringUpdate));
+    return 0;
+}
@@ -0,0 +1,113 @@
+// Wire formats: bytes on the wire and encode/decode time of each response
+// format and series layout, against the nlohmann DOM rendering they replace.
+//
+//   bytes     identity body;  gzip  the same body gzipped (default level)
+//   encode    rendering the body from the stored data
+//   decode    parsing it back with nlohmann (parse / from_msgpack / from_cbor),
+//             a stand-in for what a client pays
+
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "../compression.h"
+#include "../history_query.h"
+
+using json = nlohmann::json;
+using namespace std;
+
+namespace {
+
+const Representation REPRESENTATIONS[] = {
+    {WireFormat::Json, SeriesLayout::Rows},
+    {WireFormat::Json, SeriesLayout::Columns},
+    {WireFormat::MsgPack, SeriesLayout::Rows},
+    {WireFormat::MsgPack, SeriesLayout::Columns},
+    {WireFormat::Cbor, SeriesLayout::Rows},
+    {WireFormat::Cbor, SeriesLayout::Columns},
+};
+
+template<typename Fn>
+double averageUs(int iterations, Fn fn) {
+    auto start = bench::Clock::now();
+    for(int i = 0; i < iterations; i++) fn();
+    return bench::elapsedNs(start, bench::Clock::now()) / iterations / 1e3;
+}
+
+json decode(WireFormat format, const string& body) {
+    switch(format) {
+        case WireFormat::MsgPack: return json::from_msgpack(body);
+        case WireFormat::Cbor: return json::from_cbor(body, true, true, json::cbor_tag_handler_t::ignore);
+        default: return json::parse(body);
+    }
+}
+
+void printRow(const string& name, const string& body, WireFormat format, double encodeUs, int iterations) {
+    size_t sink = 0;
+    double decodeUs = averageUs(iterations, [&] { sink += decode(format, body).size(); });
+    printf("  %-22s %10zu %10zu %12.1f %12.1f\n", name.c_str(), body.size(),
+           compressBody(Encoding::Gzip, body).size(), encodeUs, decodeUs);
+    if(sink == 1) printf(" ");
+}
+
+void comparePayload(const string& name, const function<string()>& dom,
+                    const function<string(const Representation&)>& render, int iterations) {
+    printf("\n  %s\n", name.c_str());
+    printf("  %-22s %10s %10s %12s %12s\n", "format", "bytes", "gzip", "encode(us)", "decode(us)");
+
+    size_t sink = 0;
+    double domUs = averageUs(iterations, [&] { sink += dom().size(); });
+    printRow("json (nlohmann DOM)", dom(), WireFormat::Json, domUs, iterations);
+
+    for(const auto& rep : REPRESENTATIONS) {
+        double encodeUs = averageUs(iterations, [&] { sink += render(rep).size(); });
+        string label = rep.tag().empty() ? "json" : rep.tag();
+        if(rep.format == WireFormat::Json && rep.layout == SeriesLayout::Columns) label = "json+columns";
+        printRow(label, render(rep), rep.format, encodeUs, iterations);
+    }
+    if(sink == 1) printf(" ");
+}
+
+} // namespace
+
+int runFormatsBench(const bench::Args& args) {
+    int coinCount = (int)args.getInt("coins", 500);
+    int iterations = (int)args.getInt("iterations", 50);
+    int points = (int)args.getInt("points", 200);
+
+    vector<CoinData> coins = bench::makeSyntheticCoins(coinCount);
+    const CoinData& coin = coins.front();
+    printf("formats: %d coins, %d iterations each\n", coinCount, iterations);
+
+    comparePayload("/api/coin/:id (every period)",
+                   [&] { return coinToJson(coin, true).dump(); },
+                   [&](const Representation& rep) { return encodeCoinDetail(coin, rep); }, iterations);
+
+    HistoryQuery query;
+    query.period = Period::D7;
+    query.points = (size_t)points;
+    comparePayload("/api/coin/:id/history?period=7d&points=" + to_string(points),
+                   [&] {
+                       json data = json::array();
+                       CoinHistory::Spans spans = coin.historicalData.spans(query.period);
+                       for(size_t i : selectLTTB(spans, 0, spans.size(), query.points)) {
+                           data.push_back({{"time", spans.time(i)}, {"price", spans.price(i)}});
+                       }
+                       return json{{"id", coin.id}, {"period", "7d"}, {"data", move(data)}}.dump();
+                   },
+                   [&](const Representation& rep) { return renderHistory(coin, query, rep); }, iterations);
+
+    comparePayload("/api/coins (" + to_string(coinCount) + " coins with sparklines)",
+                   [&] {
+                       json list = json::array();
+                       for(const auto& c : coins) list.push_back(coinToJson(c));
+                       return list.dump();
+                   },
+                   [&](const Representation& rep) { return encodeCoinList(coins, rep); },
+                   max(1, iterations / 10));
+
+    printf("\n  columns = {\"t\":[..],\"p\":[..]}; raw little-endian arrays in msgpack/cbor\n");
+    return 0;
+}
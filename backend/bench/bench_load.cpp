@@ -0,0 +1,475 @@
+// End-to-end load test: starts crypto_server against an in-process fake
+// CoinGecko on loopback, waits for it to report ready, then drives
+// concurrent keep-alive clients at /api/coins and /api/coin/<id> and
+// reports throughput and latency percentiles per route.
+//
+//   crypto_bench load --clients=16 --seconds=10 --coins=50
+//   crypto_bench load --server=./build/crypto_server --payload-dir=recorded/
+//
+// The fake serves /coins/markets (paged), /coins/<id>/market_chart, /global,
+// /search/trending and /exchange_rates from payloads.h, so the server runs its real startup
+// path - streaming decode, resampling, rendering - with no network and no
+// rate limit to wait for.
+
+#include <atomic>
+#include <climits>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "payloads.h"
+
+using json = nlohmann::json;
+using namespace std;
+
+namespace {
+
+// --- Loopback HTTP/1.1, just enough for both sides of the test ---
+
+int listenLoopback(int& port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    socklen_t length = sizeof(addr);
+    if(bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 128) != 0 ||
+       getsockname(fd, (sockaddr*)&addr, &length) != 0) {
+        close(fd);
+        return -1;
+    }
+    port = ntohs(addr.sin_port);
+    return fd;
+}
+
+int connectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if(connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+bool sendAll(int fd, const string& data) {
+    for(size_t sent = 0; sent < data.size();) {
+        ssize_t n = send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+        if(n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+// Reads one message head (through the blank line) into `head`; bytes read
+// past it stay in `buffer`
+bool readHead(int fd, string& buffer, string& head) {
+    char chunk[16384];
+    size_t end;
+    while((end = buffer.find("\r\n\r\n")) == string::npos) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if(n <= 0) return false;
+        buffer.append(chunk, n);
+    }
+    head = buffer.substr(0, end + 4);
+    buffer.erase(0, end + 4);
+    return true;
+}
+
+// Reads and drops a body of `length` bytes, keeping anything after it
+bool skipBody(int fd, string& buffer, size_t length) {
+    if(buffer.size() >= length) {
+        buffer.erase(0, length);
+        return true;
+    }
+    length -= buffer.size();
+    buffer.clear();
+    char chunk[65536];
+    while(length > 0) {
+        ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+        if(n <= 0) return false;
+        if((size_t)n > length) {
+            buffer.assign(chunk + length, n - length);
+            return true;
+        }
+        length -= n;
+    }
+    return true;
+}
+
+size_t contentLength(const string& head) {
+    for(const char* name : {"Content-Length:", "content-length:"}) {
+        size_t at = head.find(name);
+        if(at != string::npos) return strtoull(head.c_str() + at + 15, nullptr, 10);
+    }
+    return 0;
+}
+
+long queryInt(const string& target, const string& key, long fallback) {
+    size_t at = target.find(key + "=");
+    if(at == string::npos || (at > 0 && target[at - 1] != '?' && target[at - 1] != '&')) return fallback;
+    return strtol(target.c_str() + at + key.size() + 1, nullptr, 10);
+}
+
+// --- Fake CoinGecko ---
+
+class FakeCoinGecko {
+public:
+    FakeCoinGecko(size_t coins, const string& dir) : dir_(dir) {
+        rows_ = json::parse(bench::marketsPayload(coins, dir));
+        for(int days : CHART_SOURCE_DAYS) charts_[days] = bench::marketChartPayload(days, dir);
+        global_ = bench::globalPayload(dir);
+        trending_ = bench::trendingPayload(dir);
+        exchangeRates_ = bench::exchangeRatesPayload(dir);
+    }
+
+    ~FakeCoinGecko() { stop(); }
+
+    // Listen on an ephemeral loopback port; false if that failed
+    bool start() {
+        port_ = 0;
+        listenFd_ = listenLoopback(port_);
+        if(listenFd_ < 0) return false;
+        acceptor_ = thread([this] {
+            while(true) {
+                int fd = accept(listenFd_, nullptr, nullptr);
+                if(fd < 0) return;
+                lock_guard<mutex> lock(mutex_);
+                connections_.emplace_back([this, fd] { serve(fd); });
+            }
+        });
+        return true;
+    }
+
+    // Connections end when the server process exits
+    void stop() {
+        if(listenFd_ < 0) return;
+        shutdown(listenFd_, SHUT_RDWR);
+        close(listenFd_);
+        listenFd_ = -1;
+        acceptor_.join();
+        lock_guard<mutex> lock(mutex_);
+        for(auto& t : connections_) t.join();
+        connections_.clear();
+    }
+
+    string baseUrl() const { return "http://127.0.0.1:" + to_string(port_) + "/api/v3"; }
+    vector<string> ids() const {
+        vector<string> out;
+        for(const auto& row : rows_) out.push_back(row.value("id", ""));
+        return out;
+    }
+    size_t requests() const { return requests_.load(); }
+
+private:
+    void serve(int fd) {
+        string buffer, head;
+        while(readHead(fd, buffer, head)) {
+            requests_++;
+            size_t space = head.find(' ');
+            string target = head.substr(space + 1, head.find(' ', space + 1) - space - 1);
+            string body;
+            int status = respond(target, body);
+            string response = "HTTP/1.1 " + to_string(status) + (status == 200 ? " OK" : " Not Found") +
+                              "\r\nContent-Type: application/json\r\nContent-Length: " + to_string(body.size()) +
+                              "\r\n\r\n" + body;
+            if(!sendAll(fd, response)) break;
+        }
+        close(fd);
+    }
+
+    int respond(const string& target, string& body) {
+        string path = target.substr(0, target.find('?'));
+        if(path.compare(0, 7, "/api/v3") == 0) path.erase(0, 7);
+
+        if(path == "/coins/markets") {
+            long perPage = max(1L, queryInt(target, "per_page", 100));
+            long page = max(1L, queryInt(target, "page", 1));
+            json slice = json::array();
+            for(long i = (page - 1) * perPage; i < page * perPage && i < (long)rows_.size(); i++) slice.push_back(rows_[i]);
+            body = slice.dump();
+            return 200;
+        }
+        if(path == "/global") {
+            body = global_;
+            return 200;
+        }
+        if(path == "/search/trending") {
+            body = trending_;
+            return 200;
+        }
+        if(path == "/exchange_rates") {
+            body = exchangeRates_;
+            return 200;
+        }
+        if(path.size() > 13 && path.compare(path.size() - 13, 13, "/market_chart") == 0) {
+            int days = (int)queryInt(target, "days", 1);
+            lock_guard<mutex> lock(mutex_);
+            auto it = charts_.find(days);
+            if(it == charts_.end()) it = charts_.emplace(days, bench::marketChartPayload(days, dir_)).first;
+            body = it->second;
+            return 200;
+        }
+        body = "{\"error\":\"not found\"}";
+        return 404;
+    }
+
+    string dir_;
+    json rows_;
+    map<int, string> charts_;
+    string global_;
+    string trending_;
+    string exchangeRates_;
+
+    int port_ = 0;
+    int listenFd_ = -1;
+    thread acceptor_;
+    mutex mutex_;
+    vector<thread> connections_;
+    atomic<size_t> requests_{0};
+};
+
+// --- Server process ---
+
+string defaultServerPath() {
+    char self[PATH_MAX];
+    ssize_t n = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if(n <= 0) return "crypto_server";
+    string dir(self, n);
+    dir.erase(dir.rfind('/'));
+    return dir + "/../crypto_server";
+}
+
+pid_t startServer(const string& path, const map<string, string>& env, const string& logPath) {
+    fflush(stdout); // or the child's freopen writes our buffered output a second time
+    pid_t pid = fork();
+    if(pid == 0) {
+        for(const auto& [key, value] : env) setenv(key.c_str(), value.c_str(), 1);
+        FILE* log = freopen(logPath.c_str(), "w", stdout);
+        if(log) dup2(fileno(stdout), STDERR_FILENO);
+        execl(path.c_str(), path.c_str(), (char*)nullptr);
+        _exit(127);
+    }
+    return pid;
+}
+
+void stopServer(pid_t pid) {
+    kill(pid, SIGTERM);
+    for(int i = 0; i < 40; i++) {
+        if(waitpid(pid, nullptr, WNOHANG) == pid) return;
+        this_thread::sleep_for(chrono::milliseconds(50));
+    }
+    kill(pid, SIGKILL);
+    waitpid(pid, nullptr, 0);
+}
+
+// One GET on a fresh connection; the body, or "" on failure
+string fetchOnce(int port, const string& target) {
+    int fd = connectLoopback(port);
+    if(fd < 0) return "";
+    string buffer, head, body;
+    if(sendAll(fd, "GET " + target + " HTTP/1.1\r\nHost: 127.0.0.1\r\nConnection: close\r\n\r\n") &&
+       readHead(fd, buffer, head)) {
+        size_t length = contentLength(head);
+        char chunk[16384];
+        while(buffer.size() < length) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if(n <= 0) break;
+            buffer.append(chunk, n);
+        }
+        body = buffer;
+    }
+    close(fd);
+    return body;
+}
+
+// --- Load clients ---
+
+enum { ROUTE_COINS, ROUTE_COIN, ROUTE_COUNT };
+const char* const ROUTE_NAMES[ROUTE_COUNT] = {"/api/coins", "/api/coin/<id>"};
+
+struct ClientResult {
+    vector<double> latencyNs[ROUTE_COUNT];
+    size_t bytes[ROUTE_COUNT] = {};
+    size_t errors = 0;
+};
+
+void runClient(int port, const vector<string>& ids, int coinShare, unsigned seed, const atomic<bool>& measuring,
+               const atomic<bool>& done, ClientResult& out) {
+    mt19937 rng(seed);
+    uniform_int_distribution<int> percent(0, 99);
+    uniform_int_distribution<size_t> pick(0, ids.size() - 1);
+
+    int fd = -1;
+    string buffer, head;
+    while(!done) {
+        if(fd < 0) {
+            fd = connectLoopback(port);
+            buffer.clear();
+            if(fd < 0) {
+                out.errors++;
+                this_thread::sleep_for(chrono::milliseconds(10));
+                continue;
+            }
+        }
+
+        int route = percent(rng) < coinShare ? ROUTE_COIN : ROUTE_COINS;
+        string target = route == ROUTE_COIN ? "/api/coin/" + ids[pick(rng)] : "/api/coins";
+        string request = "GET " + target + " HTTP/1.1\r\nHost: 127.0.0.1\r\nAccept-Encoding: br, gzip\r\n\r\n";
+
+        auto start = bench::Clock::now();
+        bool ok = sendAll(fd, request) && readHead(fd, buffer, head);
+        size_t length = ok ? contentLength(head) : 0;
+        ok = ok && skipBody(fd, buffer, length);
+        double ns = bench::elapsedNs(start, bench::Clock::now());
+
+        if(!ok || head.compare(0, 12, "HTTP/1.1 200") != 0) {
+            out.errors += measuring.load();
+            close(fd);
+            fd = -1;
+            continue;
+        }
+        if(measuring) {
+            out.latencyNs[route].push_back(ns);
+            out.bytes[route] += length;
+        }
+    }
+    if(fd >= 0) close(fd);
+}
+
+} // namespace
+
+int runLoadBench(const bench::Args& args) {
+    int clients = (int)args.getInt("clients", 16);
+    int seconds = (int)args.getInt("seconds", 10);
+    int warmup = (int)args.getInt("warmup", 2);
+    int coins = (int)args.getInt("coins", 50);
+    int coinShare = (int)args.getInt("coin-share", 50);
+    int startupSeconds = (int)args.getInt("startup-timeout", 120);
+    string dir = args.getString("payload-dir", "");
+    string serverPath = args.getString("server", "");
+    string logPath = args.getString("server-log", "/dev/null");
+
+    if(serverPath.empty()) {
+        serverPath = defaultServerPath();
+        if(access(serverPath.c_str(), X_OK) != 0) {
+            printf("load: no crypto_server next to crypto_bench (%s); pass --server=<path>. Skipped.\n",
+                   serverPath.c_str());
+            return 0;
+        }
+    }
+
+    FakeCoinGecko upstream(coins, dir);
+    if(!upstream.start()) {
+        printf("load: cannot listen on loopback\n");
+        return 1;
+    }
+
+    int port = 0;
+    int probe = listenLoopback(port);
+    close(probe);
+    string snapshotPath = "/tmp/crypto_bench_load_" + to_string(getpid()) + ".snapshot";
+
+    auto launched = bench::Clock::now();
+    pid_t server = startServer(serverPath, {
+        {"PORT", to_string(port)},
+        {"COINGECKO_BASE_URL", upstream.baseUrl()},
+        {"RATE_LIMIT_PER_MINUTE", "60000"},
+        {"TOP_COINS_COUNT", to_string(coins)},
+        {"SNAPSHOT_PATH", snapshotPath},
+    }, logPath);
+
+    // Ready once /health says so (the hot set's history is loaded by then)
+    bool ready = false, exited = false;
+    while(!ready && bench::elapsedNs(launched, bench::Clock::now()) < startupSeconds * 1e9) {
+        if(waitpid(server, nullptr, WNOHANG) == server) {
+            exited = true;
+            break;
+        }
+        ready = fetchOnce(port, "/health").find("\"status\":\"ready\"") != string::npos;
+        if(!ready) this_thread::sleep_for(chrono::milliseconds(100));
+    }
+    double startupMs = bench::elapsedNs(launched, bench::Clock::now()) / 1e6;
+    if(!ready) {
+        printf("load: %s %s (log: %s)\n", serverPath.c_str(),
+               exited ? "exited during startup" : ("not ready within " + to_string(startupSeconds) + "s").c_str(),
+               logPath.c_str());
+        if(!exited) stopServer(server);
+        unlink(snapshotPath.c_str());
+        return 1;
+    }
+
+    printf("load: %d coins, %d clients, %ds (+%ds warmup), %d%% /api/coin/<id>\n", coins, clients, seconds, warmup,
+           coinShare);
+    printf("  server ready in %.0f ms after %zu upstream requests\n", startupMs, upstream.requests());
+
+    vector<string> ids = upstream.ids();
+    atomic<bool> measuring{false}, done{false};
+    vector<ClientResult> results(clients);
+    vector<thread> threads;
+    for(int c = 0; c < clients; c++) {
+        threads.emplace_back(runClient, port, cref(ids), coinShare, 1000u + c, cref(measuring), cref(done),
+                             ref(results[c]));
+    }
+    this_thread::sleep_for(chrono::seconds(warmup));
+    measuring = true;
+    auto start = bench::Clock::now();
+    this_thread::sleep_for(chrono::seconds(seconds));
+    measuring = false;
+    double elapsedS = bench::elapsedNs(start, bench::Clock::now()) / 1e9;
+    done = true;
+    for(auto& t : threads) t.join();
+
+    stopServer(server);
+    upstream.stop();
+    unlink(snapshotPath.c_str());
+
+    vector<double> all;
+    size_t errors = 0;
+    printf("  %-28s %10s %10s\n", "route", "req/s", "KB/resp");
+    for(int r = 0; r < ROUTE_COUNT; r++) {
+        vector<double> samples;
+        size_t bytes = 0;
+        for(const auto& result : results) {
+            samples.insert(samples.end(), result.latencyNs[r].begin(), result.latencyNs[r].end());
+            bytes += result.bytes[r];
+        }
+        printf("  %-28s %10.0f %10.1f\n", ROUTE_NAMES[r], samples.size() / elapsedS,
+               samples.empty() ? 0.0 : bytes / 1024.0 / samples.size());
+        all.insert(all.end(), samples.begin(), samples.end());
+    }
+    for(const auto& result : results) errors += result.errors;
+    printf("  %-28s %10.0f\n", "total", all.size() / elapsedS);
+
+    bench::printLatencyHeader();
+    for(int r = 0; r < ROUTE_COUNT; r++) {
+        vector<double> samples;
+        for(const auto& result : results) {
+            samples.insert(samples.end(), result.latencyNs[r].begin(), result.latencyNs[r].end());
+        }
+        bench::printLatencyRow(ROUTE_NAMES[r], bench::summarize(move(samples)));
+    }
+    bench::printLatencyRow("all", bench::summarize(move(all)));
+    printf("  errors: %zu\n", errors);
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,127 @@
+// Hot paths of one update cycle, timed call by call on recorded (or
+// synthetic, see payloads.h) upstream payloads:
+//
+//   render     coinToJson() of a coin, and the detail body the server renders
+//   resample   fetchHistoricalData(): cutting a decoded market_chart into
+//              each period's time buckets with downsampleLTTB
+//   rolling    updateLiveData(): appending one tick to every hot coin's
+//              history, with the history shared by the published snapshot
+//              (copy on write, the real case) and unshared
+//   parse      the streaming decoders over a whole response
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "payloads.h"
+#include "../coingecko_json.h"
+
+using namespace std;
+
+namespace {
+
+const size_t CHUNK = 16384; // libcurl write callback size
+
+template<typename Fn>
+bench::LatencyStats sample(int iterations, Fn fn) {
+    vector<double> samples;
+    samples.reserve(iterations);
+    for(int i = 0; i < iterations; i++) {
+        auto start = bench::Clock::now();
+        fn();
+        samples.push_back(bench::elapsedNs(start, bench::Clock::now()));
+    }
+    return bench::summarize(move(samples));
+}
+
+bool stream(const string& payload, JsonSink& sink) {
+    sink.reset();
+    for(size_t off = 0; off < payload.size(); off += CHUNK) {
+        if(!sink.write(payload.data() + off, min(CHUNK, payload.size() - off))) return false;
+    }
+    return sink.finish();
+}
+
+// The per-tick loop of updateLiveData() over the hot coins
+void appendTick(vector<CoinData>& coins, int tick, long long now) {
+    for(auto& coin : coins) {
+        for(const auto& spec : PERIODS) {
+            if(tick % spec.tickDivisor == 0 && coin.historicalData.has(spec.period)) {
+                coin.historicalData.mutate().append(spec.period, now, coin.price);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int runMicroBench(const bench::Args& args) {
+    int coinCount = (int)args.getInt("coins", 50);
+    int iterations = (int)args.getInt("iterations", 200);
+    string dir = args.getString("payload-dir", "");
+
+    string markets = bench::marketsPayload(coinCount, dir);
+    string charts[CHART_SOURCE_COUNT];
+    vector<pair<long long, double>> decoded[CHART_SOURCE_COUNT];
+    for(size_t s = 0; s < CHART_SOURCE_COUNT; s++) {
+        charts[s] = bench::marketChartPayload(CHART_SOURCE_DAYS[s], dir);
+        MarketChartSink sink;
+        if(!stream(charts[s], sink)) {
+            printf("  market_chart_%d payload does not decode: %s\n", CHART_SOURCE_DAYS[s], sink.error().c_str());
+            return 1;
+        }
+        decoded[s] = sink.prices();
+    }
+
+    vector<CoinData> coins = bench::makeSyntheticCoins(coinCount);
+    printf("micro: %d coins, %d iterations, payloads %s\n", coinCount, iterations,
+           dir.empty() ? "synthetic" : dir.c_str());
+    bench::printLatencyHeader();
+    size_t sink = 0;
+
+    const CoinData& coin = coins.front();
+    bench::printLatencyRow("render coinToJson", sample(iterations, [&] { sink += coinToJson(coin).dump().size(); }));
+    bench::printLatencyRow("render coinToJson+history",
+                           sample(iterations, [&] { sink += coinToJson(coin, true).dump().size(); }));
+    bench::printLatencyRow("render encodeCoinDetail",
+                           sample(iterations, [&] { sink += encodeCoinDetail(coin, Representation()).size(); }));
+
+    for(const auto& spec : PERIODS) {
+        const auto& points = decoded[spec.source];
+        bench::printLatencyRow(string("resample ") + spec.key + " (" + to_string(points.size()) + " pts)",
+                               sample(iterations, [&] {
+                                   sink += downsampleLTTB(points, periodIntervalMs(spec), spec.capacity).size();
+                               }));
+    }
+
+    // Ticks cycle through the divisors so hourly/daily periods are hit too
+    long long now = 1760000000000LL;
+    int tick = 0;
+    vector<CoinData> published = coins;
+    vector<double> shared;
+    for(int i = 0; i < iterations; i++) {
+        vector<CoinData> next = published; // what updateSnapshot hands the writer, not timed
+        auto start = bench::Clock::now();
+        appendTick(next, ++tick, now += 300000);
+        shared.push_back(bench::elapsedNs(start, bench::Clock::now()));
+        published = move(next);
+    }
+    bench::printLatencyRow("rolling tick (shared)", bench::summarize(move(shared)));
+    vector<CoinData> owned = coins;
+    bench::printLatencyRow("rolling tick (unshared)",
+                           sample(iterations, [&] { appendTick(owned, ++tick, now += 300000); }));
+
+    MarketsSink marketsSink;
+    bench::printLatencyRow("parse markets (" + to_string(markets.size() / 1024) + " KB)",
+                           sample(iterations, [&] { sink += stream(markets, marketsSink); }));
+    for(size_t s = 0; s < CHART_SOURCE_COUNT; s++) {
+        MarketChartSink chartSink;
+        bench::printLatencyRow("parse chart " + to_string(CHART_SOURCE_DAYS[s]) + "d (" +
+                                   to_string(charts[s].size() / 1024) + " KB)",
+                               sample(iterations, [&] { sink += stream(charts[s], chartSink); }));
+    }
+
+    if(sink == 1) printf(" ");
+    return 0;
+}
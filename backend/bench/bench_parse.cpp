@@ -0,0 +1,142 @@
+// Upstream JSON decoding: the DOM approach (buffer the whole body, build a
+// nlohmann::json tree, copy values out) versus the streaming decoders fed
+// chunk by chunk as curl delivers them. Reports time per response and the
+// peak RSS growth of decoding one response.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "bench_util.h"
+#include "payloads.h"
+#include "../coingecko_json.h"
+
+using json = nlohmann::json;
+using namespace std;
+
+namespace {
+
+// libcurl hands the body over in chunks of up to CURL_MAX_WRITE_SIZE
+const size_t CHUNK = 16384;
+
+template<typename Fn>
+double averageUs(int iterations, Fn fn) {
+    auto start = bench::Clock::now();
+    for(int i = 0; i < iterations; i++) fn();
+    return bench::elapsedNs(start, bench::Clock::now()) / iterations / 1e3;
+}
+
+// What the write callback used to do: accumulate the body into a string
+string receive(const string& payload) {
+    string body;
+    for(size_t off = 0; off < payload.size(); off += CHUNK) {
+        body.append(payload, off, CHUNK);
+    }
+    return body;
+}
+
+bool stream(const string& payload, JsonSink& sink) {
+    sink.reset();
+    for(size_t off = 0; off < payload.size(); off += CHUNK) {
+        if(!sink.write(payload.data() + off, min(CHUNK, payload.size() - off))) return false;
+    }
+    return sink.finish();
+}
+
+// The previous fetchTopCoins extraction
+size_t domMarkets(const string& payload) {
+    string body = receive(payload);
+    json data = json::parse(body);
+    vector<MarketQuote> quotes;
+    for(const auto& coin : data) {
+        MarketQuote q;
+        q.id = coin.value("id", "");
+        q.rank = coin.value("market_cap_rank", 0);
+        q.name = coin.value("name", "");
+        q.symbol = coin.value("symbol", "");
+        q.logo = coin.value("image", "");
+        q.price = coin.value("current_price", 0.0);
+        q.change24h = coin.value("price_change_percentage_24h", 0.0);
+        q.marketCap = coin.value("market_cap", 0.0);
+        q.volume24h = coin.value("total_volume", 0.0);
+        q.circulatingSupply = coin.value("circulating_supply", 0.0);
+        q.totalSupply = coin["total_supply"].is_null() ? 0.0 : coin["total_supply"].get<double>();
+        q.maxSupply = coin["max_supply"].is_null() ? 0.0 : coin["max_supply"].get<double>();
+        q.ath = coin.value("ath", 0.0);
+        q.athChangePercentage = coin.value("ath_change_percentage", 0.0);
+        q.athDate = coin.value("ath_date", "");
+        if(coin.contains("sparkline_in_7d") && coin["sparkline_in_7d"].contains("price")) {
+            q.sparkline7d = coin["sparkline_in_7d"]["price"].get<vector<double>>();
+        }
+        quotes.push_back(move(q));
+    }
+    return quotes.size();
+}
+
+// The previous fetchHistoricalData extraction
+size_t domChart(const string& payload) {
+    string body = receive(payload);
+    json data = json::parse(body);
+    vector<pair<long long, double>> priceData;
+    for(const auto& pricePoint : data["prices"]) {
+        priceData.push_back({pricePoint[0].get<long long>(), pricePoint[1].get<double>()});
+    }
+    return priceData.size();
+}
+
+template<typename Sink>
+size_t itemCount(Sink& sink);
+
+template<>
+size_t itemCount(MarketsSink& sink) { return sink.quotes().size(); }
+
+template<>
+size_t itemCount(MarketChartSink& sink) { return sink.prices().size(); }
+
+template<typename Sink>
+void compare(const string& name, const string& payload, int iterations, size_t (*dom)(const string&)) {
+    // Growth measured for a no-op, i.e. the cost of measuring
+    static const long baselineKb = bench::memoryGrowthKb([] {}).peakKb;
+
+    Sink sink;
+    double domUs = averageUs(iterations, [&] { dom(payload); });
+    double streamUs = averageUs(iterations, [&] { stream(payload, sink); });
+
+    // Fresh decoder per measurement so nothing reuses memory a previous run left resident
+    long domKb = bench::memoryGrowthKb([&] { dom(payload); }).peakKb - baselineKb;
+    long streamKb = bench::memoryGrowthKb([&] {
+        Sink fresh;
+        stream(payload, fresh);
+    }).peakKb - baselineKb;
+
+    if(!stream(payload, sink)) {
+        printf("  %-22s stream decode failed: %s\n", name.c_str(), sink.error().c_str());
+        return;
+    }
+    size_t items = itemCount(sink);
+
+    printf("  %-22s %9.1f %8zu %12.1f %12.1f %8.2fx %10ld %10ld\n", name.c_str(), payload.size() / 1024.0,
+           items, domUs, streamUs, domUs / streamUs, domKb, streamKb);
+    if(items != dom(payload)) printf("  !! %s: DOM and stream decoders disagree\n", name.c_str());
+}
+
+} // namespace
+
+int runParseBench(const bench::Args& args) {
+    int coinCount = (int)args.getInt("coins", 50);
+    int iterations = (int)args.getInt("iterations", 50);
+    string dir = args.getString("payload-dir", "");
+
+    printf("parse: %s payloads, %zu-byte chunks\n", dir.empty() ? "synthetic" : dir.c_str(), CHUNK);
+    printf("  %-22s %9s %8s %12s %12s %9s %10s %10s\n",
+           "payload", "size(KB)", "items", "dom(us)", "stream(us)", "speedup", "dom(KB)", "stream(KB)");
+
+    compare<MarketsSink>("markets", bench::marketsPayload(coinCount, dir), iterations, domMarkets);
+    for(int days : {1, 90, 365}) {
+        compare<MarketChartSink>("market_chart days=" + to_string(days), bench::marketChartPayload(days, dir),
+                                 iterations, domChart);
+    }
+    printf("  dom/stream(KB) = peak RSS growth while decoding one response\n");
+    return 0;
+}
@@ -0,0 +1,96 @@
+// Replica follower: what it costs to pick up one leader generation (poll,
+// checksum, decode, publish), and what a since= client of the follower gets.
+// A live tick publishes twice on the leader (prices, then the chart point)
+// while the replica file carries only the newest version, so the follower
+// sees every tick as a jump of two versions. A client holding the follower's
+// previous version must still be sent a delta (X-Delta: changes); the run
+// fails if the follower falls back to the full list.
+//
+//   crypto_bench replica --coins=50 --hot=10 --ticks=5
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+#include "bench_util.h"
+#include "../change_log.h"
+#include "../coin_query.h"
+#include "../replica.h"
+
+using namespace std;
+
+int runReplicaBench(const bench::Args& args) {
+    int coinCount = (int)args.getInt("coins", 50);
+    int hotCount = (int)args.getInt("hot", 10);
+    int ticks = (int)args.getInt("ticks", 5);
+    string path = args.getString("replica-file", "/tmp/crypto_bench_" + to_string(getpid()) + ".replica");
+
+    ReplicaWriter writer(path, 1);
+    ReplicaReader reader(path);
+    if(!writer.ok()) return 1;
+
+    MarketSnapshot leader;
+    leader.coins = bench::makeSyntheticCoins(coinCount);
+    leader.index.rebuild(leader.coins);
+    leader.version = currentSnapshot()->version + 1; // ahead of whatever ran before in this process
+
+    vector<double> followNs;
+    size_t deltaBytes = 0, fullBytes = 0;
+    int fullFallbacks = 0;
+    long long now = 1760000000000LL;
+    for(int tick = 0; tick <= ticks; tick++) {
+        if(tick > 0) {
+            now += TICK_SECONDS * 1000;
+            // New prices for every coin, a chart point for the hot set
+            for(size_t i = 0; i < leader.coins.size(); i++) {
+                CoinData& coin = leader.coins[i];
+                coin.price *= 1.0001;
+                if((int)i < hotCount) coin.historicalData.mutate().append(Period::H24, now, coin.price);
+            }
+            leader.version += 2;
+        }
+        leader.publishedAt = now / 1000;
+        if(!writer.publish(leader, ReplicaClock())) return 1;
+
+        // What replicaFollowerLoop() does with a generation
+        auto start = bench::Clock::now();
+        ReplicaGeneration generation;
+        if(reader.poll(generation) != ReplicaReader::Result::Updated) {
+            printf("replica: generation %d not read back\n", tick);
+            remove(path.c_str());
+            return 1;
+        }
+        SnapshotPtr before = currentSnapshot();
+        SnapshotPtr after = updateSnapshot([&](MarketSnapshot& next) {
+            shareUnchangedHistory(next, generation.snapshot.coins);
+            next.version = generation.snapshot.version;
+            next.publishedAt = generation.snapshot.publishedAt;
+            next.coins = move(generation.snapshot.coins);
+        });
+        if(tick == 0) continue;
+        followNs.push_back(bench::elapsedNs(start, bench::Clock::now()));
+
+        // since=<the follower's previous version>, as its clients hold
+        if(after->changes.covers(before->version, after->version)) {
+            deltaBytes += encodeCoinsDelta(*after, before->version, ALL_COIN_FIELDS, Representation()).size();
+        } else {
+            fullFallbacks++;
+        }
+        fullBytes += after->responses.coinsJson.identity().size();
+    }
+    remove(path.c_str());
+    updateSnapshot([](MarketSnapshot& next) { next.coins.clear(); });
+
+    printf("replica: %d coins, hot set %d, %d ticks (two leader versions each)\n", coinCount, hotCount, ticks);
+    bench::printLatencyHeader();
+    bench::printLatencyRow("follow one generation", bench::summarize(move(followNs)));
+    printf("\n  since=<previous version>: %d/%d deltas, %.1f KB/delta vs %.1f KB full list\n", ticks - fullFallbacks,
+           ticks, ticks > fullFallbacks ? deltaBytes / 1024.0 / (ticks - fullFallbacks) : 0.0,
+           ticks > 0 ? fullBytes / 1024.0 / ticks : 0.0);
+    if(fullFallbacks > 0) {
+        printf("  FAIL: the follower answered %d one-tick-old since= requests with the full list\n", fullFallbacks);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,96 @@
+// Universe scaling: memory and update cost of the published market data at
+// increasing coin counts. Every coin has full history (the steady state once
+// the history tiers are loaded); only the hot set is extended each tick, as
+// in updateLiveData().
+//
+//   resident  RSS held by one published snapshot (data + rendered bodies)
+//   tick      one live update: new prices for every coin, points appended to
+//             the hot set, changed bodies re-rendered
+//   backfill  publishing one coin's refetched history (the history sweep)
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace std;
+
+namespace {
+
+const int SIZES[] = {50, 500, 5000};
+const int MARKETS_PAGE_SIZE = 250;
+
+void priceTick(MarketSnapshot& next, int hotCount, long long now) {
+    for(auto& coin : next.coins) {
+        coin.price *= 1.0001;
+        coin.sparkline7d.back() = coin.price;
+        if(coin.rank > hotCount) continue;
+        coin.historicalData.mutate().append(Period::H24, now, coin.price);
+    }
+}
+
+template<typename Fn>
+double medianMs(int iterations, Fn fn) {
+    vector<double> samples;
+    for(int i = 0; i < iterations; i++) {
+        auto start = bench::Clock::now();
+        fn();
+        samples.push_back(bench::elapsedNs(start, bench::Clock::now()) / 1e6);
+    }
+    sort(samples.begin(), samples.end());
+    return samples[samples.size() / 2];
+}
+
+} // namespace
+
+int runScalingBench(const bench::Args& args) {
+    int maxCoins = (int)args.getInt("max-coins", 5000);
+    int hotCount = (int)args.getInt("hot", 50);
+    int iterations = (int)args.getInt("iterations", 3);
+
+    setFullPrecompressionRanks(hotCount);
+    printf("scaling: hot set %d (full precompression and per-tick history), median of %d\n", hotCount, iterations);
+    printf("  %8s %6s %12s %10s %10s %10s %12s\n",
+           "coins", "pages", "resident(MB)", "KB/coin", "peak(MB)", "tick(ms)", "backfill(ms)");
+
+    for(int count : SIZES) {
+        if(count > maxCoins) break;
+        vector<CoinData> coins = bench::makeSyntheticCoins(count);
+
+        // Measured before anything is published in this process
+        bench::MemoryGrowth memory = bench::memoryGrowthKb([&] {
+            updateSnapshot([&](MarketSnapshot& next) { next.coins = move(coins); });
+            coins.clear();
+            coins.shrink_to_fit();
+        });
+
+        updateSnapshot([&](MarketSnapshot& next) { next.coins = coins; });
+        coins.clear();
+
+        long long now = 1760000000000LL;
+        double tickMs = medianMs(iterations, [&] {
+            now += 300000;
+            updateSnapshot([&](MarketSnapshot& next) { priceTick(next, hotCount, now); });
+        });
+
+        // A coin in the middle of the list, as the sweep works through them
+        size_t slot = count / 2;
+        vector<pair<long long, double>> points;
+        for(size_t k = 0; k < periodSpec(Period::H24).capacity; k++) points.push_back({now + (long long)k, 1.0 + k});
+        double backfillMs = medianMs(iterations, [&] {
+            updateSnapshot([&](MarketSnapshot& next) {
+                next.coins[slot].historicalData.mutate().assign(Period::H24, points);
+            });
+        });
+
+        int pages = (count + MARKETS_PAGE_SIZE - 1) / MARKETS_PAGE_SIZE;
+        printf("  %8d %6d %12.1f %10.1f %10.1f %10.1f %12.2f\n", count, pages, memory.residentKb / 1024.0,
+               (double)memory.residentKb / count, memory.peakKb / 1024.0, tickMs, backfillMs);
+    }
+
+    updateSnapshot([](MarketSnapshot& next) { next.coins.clear(); });
+    printf("  pages = /coins/markets calls per live update\n");
+    return 0;
+}
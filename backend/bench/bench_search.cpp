@@ -0,0 +1,125 @@
+// /api/search index at increasing universe sizes, on made-up coin names
+// (syllable words, so prefixes overlap the way real names do) with a
+// description for the top coins:
+//
+//   build     indexing every coin from scratch (startup, or new notes)
+//   update    re-indexing after one coin joins the list (a publish that
+//             changes the universe), and the check a price-only publish costs
+//   query     SearchIndex::search() per kind of query, p50/p99
+//
+//   crypto_bench search --max-coins=10000
+
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "../search_index.h"
+
+using namespace std;
+
+namespace {
+
+const int SIZES[] = {100, 1000, 10000};
+const int NOTED_COINS = 100; // coin-info.json describes the top few dozen
+
+const char* const SYLLABLES[] = {"bit", "coin", "eth", "er", "sol", "ana", "doge", "lite", "chain", "link",
+                                 "poly", "gon", "ava", "lanche", "car", "dano", "ton", "sui", "apt", "os",
+                                 "near", "arb", "op", "uni", "swap", "pepe", "shib", "inu", "ripple", "stel"};
+
+string makeWord(mt19937_64& rng, int syllables) {
+    string word;
+    for(int i = 0; i < syllables; i++) word += SYLLABLES[rng() % size(SYLLABLES)];
+    return word;
+}
+
+vector<CoinData> makeNamedCoins(size_t count, CoinNotes& notes) {
+    mt19937_64 rng(7);
+    vector<CoinData> coins;
+    coins.reserve(count);
+    for(size_t i = 0; i < count; i++) {
+        CoinData c;
+        string first = makeWord(rng, 1 + rng() % 2);
+        string second = rng() % 3 == 0 ? makeWord(rng, 1) : "";
+        c.id = first + (second.empty() ? "" : "-" + second) + "-" + to_string(i);
+        c.name = first + (second.empty() ? "" : " " + second);
+        c.name[0] = char(toupper(c.name[0]));
+        c.symbol = first.substr(0, 3) + to_string(i % 100);
+        c.rank = (int)i + 1;
+        coins.push_back(move(c));
+
+        if(i < NOTED_COINS) {
+            string text;
+            for(int w = 0; w < 60; w++) text += makeWord(rng, 1 + rng() % 3) + " ";
+            notes[coins.back().id] = text;
+        }
+    }
+    return coins;
+}
+
+template<typename Fn>
+bench::LatencyStats sample(int iterations, Fn fn) {
+    vector<double> samples;
+    samples.reserve(iterations);
+    for(int i = 0; i < iterations; i++) {
+        auto start = bench::Clock::now();
+        fn();
+        samples.push_back(bench::elapsedNs(start, bench::Clock::now()));
+    }
+    return bench::summarize(move(samples));
+}
+
+} // namespace
+
+int runSearchBench(const bench::Args& args) {
+    int maxCoins = (int)args.getInt("max-coins", 10000);
+    int iterations = (int)args.getInt("iterations", 2000);
+
+    struct QueryCase {
+        const char* name;
+        const char* text;
+    };
+    const QueryCase QUERIES[] = {
+        {"1-letter prefix", "b"},
+        {"3-letter prefix", "bit"},
+        {"exact symbol", "eth7"},
+        {"two words", "coin sol"},
+        {"typo", "lanhce"},
+        {"description word", "ripplestel"},
+        {"no match", "zzzz"},
+    };
+
+    bench::printLatencyHeader();
+    for(int count : SIZES) {
+        if(count > maxCoins) break;
+        auto notes = make_shared<CoinNotes>();
+        vector<CoinData> coins = makeNamedCoins(count, *notes);
+        string label = to_string(count) + " ";
+
+        shared_ptr<const SearchIndex> index;
+        bench::printLatencyRow(label + "build", sample(5, [&] {
+            index = SearchIndex::update(nullptr, coins, notes);
+        }));
+
+        vector<CoinData> grown = coins;
+        grown.push_back(coins[count / 2]);
+        grown.back().id = "newly-listed";
+        grown.back().name = "Newly Listed";
+        bench::printLatencyRow(label + "update (+1 coin)", sample(5, [&] {
+            SearchIndex::update(index, grown, notes);
+        }));
+        bench::printLatencyRow(label + "update (unchanged)", sample(50, [&] {
+            SearchIndex::update(index, coins, notes);
+        }));
+
+        size_t found = 0;
+        for(const auto& q : QUERIES) {
+            bench::printLatencyRow(label + q.name, sample(iterations, [&] {
+                found += index->search(q.text, SearchIndex::DEFAULT_LIMIT, coins).size();
+            }));
+        }
+        printf("  %d coins: %zu terms\n", count, index->terms());
+    }
+    return 0;
+}
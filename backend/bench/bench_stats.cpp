@@ -0,0 +1,90 @@
+// Market aggregates (/api/stats): one pass over change24h, volume24h and
+// marketCap, reading the fields out of the CoinData records versus the
+// struct-of-arrays MarketTable, scalar versus AVX2.
+//
+//   records   the same loop over vector<CoinData>, one fat struct per coin
+//   rebuild   filling the MarketTable from the records (once per publish)
+//   stats     computeMarketStats: the sums plus top gainers/losers
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "bench_util.h"
+
+using namespace std;
+
+namespace {
+
+const int SIZES[] = {500, 5000, 50000};
+
+ColumnSums sumRecords(const vector<CoinData>& coins) {
+    ColumnSums s;
+    for(const auto& coin : coins) {
+        double c = coin.change24h;
+        if(!isfinite(c)) continue;
+        s.changeCount += 1;
+        s.changeSum += c;
+        s.changeSquares += c * c;
+        if(coin.volume24h > 0) {
+            s.volume += coin.volume24h;
+            s.volumeChange += coin.volume24h * c;
+        }
+        double growth = 1 + c * 0.01;
+        if(coin.marketCap > 0 && growth > 0) {
+            s.cap += coin.marketCap;
+            s.capChange += coin.marketCap * c;
+            s.capBefore += coin.marketCap / growth;
+        }
+    }
+    return s;
+}
+
+template<typename Fn>
+double averageUs(int iterations, Fn fn) {
+    auto start = bench::Clock::now();
+    for(int i = 0; i < iterations; i++) fn();
+    return bench::elapsedNs(start, bench::Clock::now()) / iterations / 1e3;
+}
+
+double relativeError(double a, double b) {
+    return fabs(a - b) / max(1e-300, fabs(b));
+}
+
+} // namespace
+
+int runStatsBench(const bench::Args& args) {
+    int maxCoins = (int)args.getInt("max-coins", 50000);
+    int iterations = (int)args.getInt("iterations", 200);
+
+    printf("stats: best kernel on this CPU: %s\n", kernelName(bestKernel()));
+    printf("  %8s %12s %12s %12s %12s %12s %10s\n",
+           "coins", "records(us)", "scalar(us)", "avx2(us)", "rebuild(us)", "stats(us)", "avx2 err");
+
+    int failures = 0;
+    for(int count : SIZES) {
+        if(count > maxCoins) break;
+        vector<CoinData> coins = bench::makeSyntheticCoins(count);
+        MarketTable table;
+        table.rebuild(coins);
+
+        double sink = 0;
+        double records = averageUs(iterations, [&] { sink += sumRecords(coins).capBefore; });
+        double scalar = averageUs(iterations, [&] { sink += sumColumns(table, SimdKernel::Scalar).capBefore; });
+        double avx2 = averageUs(iterations, [&] { sink += sumColumns(table, SimdKernel::Avx2).capBefore; });
+        double rebuild = averageUs(iterations, [&] { table.rebuild(coins); });
+        double stats = averageUs(iterations, [&] { sink += computeMarketStats(table).marketCapIndex; });
+
+        // Lane-wise sums add in a different order, so allow rounding differences
+        ColumnSums a = sumColumns(table, SimdKernel::Scalar), b = sumColumns(table, SimdKernel::Avx2);
+        double err = max({relativeError(b.changeSum, a.changeSum), relativeError(b.volumeChange, a.volumeChange),
+                          relativeError(b.capBefore, a.capBefore)});
+        failures += err > 1e-9;
+
+        printf("  %8d %12.2f %12.2f %12.2f %12.2f %12.2f %10.1e\n", count, records, scalar, avx2, rebuild, stats, err);
+        if(sink == 1) printf(" ");
+    }
+    if(bestKernel() != SimdKernel::Avx2) printf("  (no AVX2: the avx2 column runs the scalar kernel)\n");
+    return failures;
+}
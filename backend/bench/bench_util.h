@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../market_snapshot.h"
+
+namespace bench {
+
+using Clock = std::chrono::steady_clock;
+
+inline double elapsedNs(Clock::time_point start, Clock::time_point end) {
+    return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// Command line options of the form --key=value
+class Args {
+public:
+    Args(int argc, char** argv) {
+        for(int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if(arg.rfind("--", 0) != 0) {
+                positional_.push_back(arg);
+                continue;
+            }
+            size_t eq = arg.find('=');
+            if(eq == std::string::npos) {
+                options_[arg.substr(2)] = "1";
+            } else {
+                options_[arg.substr(2, eq - 2)] = arg.substr(eq + 1);
+            }
+        }
+    }
+
+    const std::vector<std::string>& positional() const { return positional_; }
+
+    long getInt(const std::string& key, long fallback) const {
+        auto it = options_.find(key);
+        return it == options_.end() ? fallback : std::strtol(it->second.c_str(), nullptr, 10);
+    }
+
+    std::string getString(const std::string& key, const std::string& fallback) const {
+        auto it = options_.find(key);
+        return it == options_.end() ? fallback : it->second;
+    }
+
+private:
+    std::vector<std::string> positional_;
+    std::map<std::string, std::string> options_;
+};
+
+// Latency percentiles over a set of samples (nanoseconds)
+struct LatencyStats {
+    size_t count = 0;
+    double p50 = 0;
+    double p99 = 0;
+    double p999 = 0;
+    double max = 0;
+};
+
+inline LatencyStats summarize(std::vector<double> samples) {
+    LatencyStats stats;
+    stats.count = samples.size();
+    if(samples.empty()) return stats;
+
+    std::sort(samples.begin(), samples.end());
+    auto at = [&](double q) {
+        size_t index = std::min(samples.size() - 1, (size_t)std::ceil(q * samples.size()) - 1);
+        return samples[index];
+    };
+    stats.p50 = at(0.50);
+    stats.p99 = at(0.99);
+    stats.p999 = at(0.999);
+    stats.max = samples.back();
+    return stats;
+}
+
+inline void printLatencyHeader() {
+    std::printf("  %-28s %10s %10s %10s %10s %12s\n", "case", "samples", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+}
+
+inline void printLatencyRow(const std::string& name, const LatencyStats& s) {
+    std::printf("  %-28s %10zu %10.2f %10.2f %10.2f %12.2f\n",
+                name.c_str(), s.count, s.p50 / 1e3, s.p99 / 1e3, s.p999 / 1e3, s.max / 1e3);
+}
+
+// A field of /proc/self/status in KB ("VmRSS:", "VmHWM:"); -1 if missing
+inline long readStatusKb(const char* field) {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    size_t length = std::strlen(field);
+    while(std::getline(status, line)) {
+        if(line.compare(0, length, field) == 0) return std::strtol(line.c_str() + length + 1, nullptr, 10);
+    }
+    return -1;
+}
+
+struct MemoryGrowth {
+    long residentKb = -1; // RSS left behind by fn
+    long peakKb = -1;     // highest RSS reached while fn ran
+};
+
+// RSS growth of running `fn` once, measured in a forked child so nothing
+// the parent allocated earlier (or frees later) skews it
+template<typename Fn>
+MemoryGrowth memoryGrowthKb(Fn fn) {
+    int fds[2];
+    if(pipe(fds) != 0) return {};
+    pid_t pid = fork();
+    if(pid == 0) {
+        close(fds[0]);
+        malloc_trim(0); // drop free heap pages inherited from the parent
+        std::ofstream("/proc/self/clear_refs") << "5"; // reset VmHWM to the current RSS
+        long before = readStatusKb("VmRSS:");
+        fn();
+        MemoryGrowth growth;
+        growth.residentKb = readStatusKb("VmRSS:") - before;
+        growth.peakKb = readStatusKb("VmHWM:") - before;
+        if(write(fds[1], &growth, sizeof(growth)) != sizeof(growth)) _exit(1);
+        _exit(0);
+    }
+    close(fds[1]);
+    MemoryGrowth growth;
+    if(read(fds[0], &growth, sizeof(growth)) != sizeof(growth)) growth = {};
+    close(fds[0]);
+    waitpid(pid, nullptr, 0);
+    return growth;
+}
+
+// Synthetic market with the same shape as the live data: 168-point
+// sparklines and all seven chart periods filled to capacity.
+inline std::vector<CoinData> makeSyntheticCoins(size_t count, unsigned seed = 42) {
+    std::mt19937_64 rng(seed);
+    std::lognormal_distribution<double> priceDist(2.0, 3.0);
+    std::normal_distribution<double> walk(0.0, 0.01);
+
+    const long long now = 1760000000000LL;
+    std::vector<CoinData> coins;
+    coins.reserve(count);
+
+    for(size_t i = 0; i < count; i++) {
+        CoinData c;
+        c.id = "coin-" + std::to_string(i);
+        c.rank = (int)i + 1;
+        c.name = "Coin " + std::to_string(i);
+        c.symbol = "c" + std::to_string(i);
+        c.logo = "https://assets.coingecko.com/coins/images/" + std::to_string(i) + "/large/coin.png";
+        c.price = priceDist(rng);
+        c.change24h = walk(rng) * 100;
+        c.marketCap = c.price * 1e8 / (i + 1);
+        c.volume24h = c.marketCap * 0.05;
+        c.circulatingSupply = 1e8;
+        c.totalSupply = 2e8;
+        c.maxSupply = 0;
+        c.ath = c.price * 1.8;
+        c.athChangePercentage = -44.4;
+        c.athDate = "2024-03-14T07:10:36.635Z";
+
+        double p = c.price;
+        for(int k = 0; k < 168; k++) {
+            p *= 1 + walk(rng);
+            c.sparkline7d.push_back(p);
+        }
+
+        for(const auto& spec : PERIODS) {
+            std::vector<std::pair<long long, double>> series;
+            series.reserve(spec.capacity);
+            double q = c.price;
+            for(size_t k = 0; k < spec.capacity; k++) {
+                q *= 1 + walk(rng);
+                series.push_back({now - (long long)(spec.capacity - k) * 300000LL, q});
+            }
+            c.historicalData.mutate().assign(spec.period, series);
+        }
+
+        coins.push_back(std::move(c));
+    }
+
+    return coins;
+}
+
+} // namespace bench
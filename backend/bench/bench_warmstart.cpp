@@ -0,0 +1,94 @@
+// Time-to-ready: a cold start refetches every chart from the rate-limited
+// upstream; a warm start maps the previous run's snapshot file and serves at
+// once, then backfills only the periods that went stale while it was down.
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "bench_util.h"
+#include "../snapshot_store.h"
+
+using namespace std;
+
+int runWarmStartBench(const bench::Args& args) {
+    int coinCount = (int)args.getInt("coins", 50);
+    int iterations = (int)args.getInt("iterations", 5);
+    long rateLimitMs = args.getInt("rate-limit-ms", 2000);
+    string path = args.getString("snapshot-file", "/tmp/crypto_bench.snapshot");
+
+    MarketSnapshot snapshot;
+    snapshot.version = 1;
+    snapshot.coins = bench::makeSyntheticCoins(coinCount);
+    snapshot.index.rebuild(snapshot.coins);
+
+    // Cold: top coins + one market_chart call per coin and chart source + trending +
+    // global, paced at the rate limit. The upstream wait dwarfs local work.
+    size_t coldCalls = 1 + (size_t)coinCount * CHART_SOURCE_COUNT + 2;
+    double coldMs = (double)coldCalls * rateLimitMs;
+
+    vector<double> saveNs, loadNs, publishNs;
+    SnapshotFileInfo info;
+    for(int i = 0; i < iterations; i++) {
+        auto start = bench::Clock::now();
+        if(!saveSnapshotFile(snapshot, path)) return 1;
+        saveNs.push_back(bench::elapsedNs(start, bench::Clock::now()));
+
+        MarketSnapshot loaded;
+        start = bench::Clock::now();
+        if(!loadSnapshotFile(path, loaded, &info)) return 1;
+        auto mapped = bench::Clock::now();
+        renderResponses(loaded);
+        auto ready = bench::Clock::now();
+
+        loadNs.push_back(bench::elapsedNs(start, mapped));
+        publishNs.push_back(bench::elapsedNs(mapped, ready));
+    }
+    remove(path.c_str());
+
+    bench::LatencyStats save = bench::summarize(saveNs);
+    bench::LatencyStats load = bench::summarize(loadNs);
+    bench::LatencyStats publish = bench::summarize(publishNs);
+
+    printf("warmstart: %d coins, snapshot file %.1f KB, rate limit %ld ms\n",
+           coinCount, info.fileSize / 1024.0, rateLimitMs);
+    bench::printLatencyHeader();
+    bench::printLatencyRow("save (write+fsync+rename)", save);
+    bench::printLatencyRow("load (mmap+crc+decode)", load);
+    bench::printLatencyRow("render responses", publish);
+
+    printf("\n  %-28s %14s %16s\n", "start", "upstream calls", "time-to-ready");
+    printf("  %-28s %14zu %14.1f s\n", "cold", coldCalls, coldMs / 1e3);
+    printf("  %-28s %14d %14.1f ms\n", "warm", 0, (load.p50 + publish.p50) / 1e6);
+
+    // Backfill after a warm start, by how long the server was down
+    struct Downtime {
+        const char* name;
+        long long seconds;
+    };
+    const Downtime DOWNTIMES[] = {
+        {"5 min", 5 * 60}, {"1 hour", 3600}, {"1 day", 86400}, {"1 week", 7 * 86400}, {"1 month", 30 * 86400},
+    };
+
+    long long newest = 0;
+    for(const auto& spec : PERIODS) {
+        newest = max(newest, snapshot.coins[0].historicalData.back(spec.period).first);
+    }
+
+    printf("\n  %-28s %14s %16s\n", "warm start after downtime", "backfill calls", "backfill time");
+    for(const auto& d : DOWNTIMES) {
+        long long nowMs = newest + d.seconds * 1000;
+        size_t calls = 0;
+        for(const auto& coin : snapshot.coins) {
+            vector<Period> stale;
+            for(const auto& spec : PERIODS) {
+                if(coin.historicalData.isStale(spec.period, nowMs)) stale.push_back(spec.period);
+            }
+            calls += chartCallsFor(stale);
+        }
+        printf("  %-28s %14zu %14.1f s\n", d.name, calls, (double)calls * rateLimitMs / 1e3);
+    }
+    printf("  (data is served from the snapshot while the backfill runs)\n");
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+// crypto_bench - performance harness for the CryptoLizard backend.
+//
+//   crypto_bench                 run every benchmark with default options
+//   crypto_bench contention      run one benchmark
+//   crypto_bench --list          list benchmarks
+//
+// Options are passed as --key=value and read by each benchmark.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#include "bench_util.h"
+
+int runContentionBench(const bench::Args& args);
+int runCompressionBench(const bench::Args& args);
+int runWarmStartBench(const bench::Args& args);
+int runParseBench(const bench::Args& args);
+int runScalingBench(const bench::Args& args);
+int runSearchBench(const bench::Args& args);
+int runFormatsBench(const bench::Args& args);
+int runStatsBench(const bench::Args& args);
+int runMicroBench(const bench::Args& args);
+int runLoadBench(const bench::Args& args);
+int runReplicaBench(const bench::Args& args);
+
+namespace {
+
+struct BenchCase {
+    const char* name;
+    const char* description;
+    int (*run)(const bench::Args&);
+};
+
+const BenchCase BENCHMARKS[] = {
+    {"contention", "read latency under a concurrent live update (mutex vs snapshot)", runContentionBench},
+    {"compression", "response size and CPU per content-coding (precompressed vs on-the-fly)", runCompressionBench},
+    {"warmstart", "time-to-ready of a cold start vs loading the persisted snapshot file", runWarmStartBench},
+    {"parse", "upstream JSON decode time and peak RSS (DOM vs streaming SAX)", runParseBench},
+    {"scaling", "memory and update time of the market data at 50, 500 and 5000 coins", runScalingBench},
+    {"search", "/api/search index build, incremental update and query latency at 100, 1000 and 10000 coins",
+     runSearchBench},
+    {"formats", "body size and encode/decode time per wire format (JSON, msgpack, CBOR; rows vs columns)",
+     runFormatsBench},
+    {"stats", "market aggregates over records vs columns, scalar vs AVX2", runStatsBench},
+    {"micro", "coinToJson, history resampling, rolling update and upstream parse per call", runMicroBench},
+    {"load", "end-to-end: crypto_server against a fake CoinGecko, p50/p99/p999 under concurrent clients",
+     runLoadBench},
+    {"replica", "follower: time to publish one leader generation, and since= deltas across skipped versions",
+     runReplicaBench},
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    bench::Args args(argc, argv);
+
+    if(args.getInt("list", 0)) {
+        for(const auto& b : BENCHMARKS) {
+            std::printf("%-16s %s\n", b.name, b.description);
+        }
+        return 0;
+    }
+
+    int failures = 0;
+    bool ranAny = false;
+    for(const auto& b : BENCHMARKS) {
+        bool selected = args.positional().empty();
+        for(const auto& name : args.positional()) {
+            if(name == b.name) selected = true;
+        }
+        if(!selected) continue;
+
+        ranAny = true;
+        std::printf("\n=== %s ===\n", b.name);
+        failures += b.run(args) != 0;
+    }
+
+    if(!ranAny) {
+        std::fprintf(stderr, "No benchmark matched. Use --list to see the available ones.\n");
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
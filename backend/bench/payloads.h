@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <nlohmann/json.hpp>
+
+#include "bench_util.h"
+
+// Upstream response bodies for the parse/load benchmarks. A recorded
+// response is used when `dir` has it, e.g.
+//   curl "$API/coins/markets?vs_currency=usd&per_page=50&sparkline=true" > markets.json
+//   curl "$API/coins/bitcoin/market_chart?vs_currency=usd&days=365" > market_chart_365.json
+//   curl "$API/global" > global.json
+//   curl "$API/search/trending" > trending.json
+//   curl "$API/exchange_rates" > exchange_rates.json
+// and otherwise a synthetic body of the same shape and size is generated.
+namespace bench {
+
+inline bool readFile(const std::string& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if(!in) return false;
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    out = ss.str();
+    return true;
+}
+
+// /coins/markets with sparkline=true
+inline std::string marketsPayload(size_t coins, const std::string& dir = "") {
+    std::string recorded;
+    if(!dir.empty() && readFile(dir + "/markets.json", recorded)) return recorded;
+
+    nlohmann::json rows = nlohmann::json::array();
+    for(const auto& c : makeSyntheticCoins(coins)) {
+        rows.push_back({
+            {"id", c.id}, {"symbol", c.symbol}, {"name", c.name}, {"image", c.logo},
+            {"current_price", c.price}, {"market_cap", c.marketCap}, {"market_cap_rank", c.rank},
+            {"fully_diluted_valuation", c.marketCap * 1.1}, {"total_volume", c.volume24h},
+            {"high_24h", c.price * 1.02}, {"low_24h", c.price * 0.98},
+            {"price_change_24h", c.price * c.change24h / 100}, {"price_change_percentage_24h", c.change24h},
+            {"market_cap_change_24h", c.marketCap * 0.01}, {"market_cap_change_percentage_24h", 1.0},
+            {"circulating_supply", c.circulatingSupply}, {"total_supply", c.totalSupply}, {"max_supply", nullptr},
+            {"ath", c.ath}, {"ath_change_percentage", c.athChangePercentage}, {"ath_date", c.athDate},
+            {"atl", c.price * 0.01}, {"atl_change_percentage", 9000.0}, {"atl_date", "2013-07-06T00:00:00.000Z"},
+            {"roi", nullptr}, {"last_updated", "2025-10-09T12:00:00.000Z"},
+            {"sparkline_in_7d", {{"price", c.sparkline7d}}},
+            {"price_change_percentage_24h_in_currency", c.change24h},
+        });
+    }
+    return rows.dump();
+}
+
+// /coins/{id}/market_chart?days=N: 5-minute points for 1 day, hourly up to
+// 90 days, daily beyond
+inline std::string marketChartPayload(int days, const std::string& dir = "") {
+    std::string recorded;
+    if(!dir.empty() && readFile(dir + "/market_chart_" + std::to_string(days) + ".json", recorded)) return recorded;
+
+    long long stepMs = days <= 1 ? 300000LL : days <= 90 ? 3600000LL : 86400000LL;
+    long long points = days * 86400000LL / stepMs + 1;
+    long long start = 1760000000000LL - (points - 1) * stepMs;
+
+    std::mt19937_64 rng(days);
+    std::normal_distribution<double> walk(0.0, 0.01);
+    double price = 62000.123456789;
+
+    nlohmann::json prices = nlohmann::json::array();
+    nlohmann::json caps = nlohmann::json::array();
+    nlohmann::json volumes = nlohmann::json::array();
+    for(long long i = 0; i < points; i++) {
+        price *= 1 + walk(rng);
+        long long t = start + i * stepMs;
+        prices.push_back({t, price});
+        caps.push_back({t, price * 19700000.0});
+        volumes.push_back({t, price * 450000.0 * (1 + walk(rng))});
+    }
+    return nlohmann::json{{"prices", prices}, {"market_caps", caps}, {"total_volumes", volumes}}.dump();
+}
+
+// /global
+inline std::string globalPayload(const std::string& dir = "") {
+    std::string recorded;
+    if(!dir.empty() && readFile(dir + "/global.json", recorded)) return recorded;
+
+    return nlohmann::json{{"data", {
+        {"active_cryptocurrencies", 17452}, {"markets", 1310},
+        {"total_market_cap", {{"usd", 4.21e12}, {"eur", 3.62e12}, {"btc", 34512000.0}}},
+        {"total_volume", {{"usd", 1.68e11}, {"eur", 1.44e11}, {"btc", 1378000.0}}},
+        {"market_cap_percentage", {{"btc", 57.3}, {"eth", 13.1}, {"usdt", 4.2}}},
+        {"market_cap_change_percentage_24h_usd", 1.27},
+        {"updated_at", 1760000000},
+    }}}.dump();
+}
+
+// /exchange_rates (every rate against BTC)
+inline std::string exchangeRatesPayload(const std::string& dir = "") {
+    std::string recorded;
+    if(!dir.empty() && readFile(dir + "/exchange_rates.json", recorded)) return recorded;
+
+    nlohmann::json rates = nlohmann::json::object();
+    auto add = [&](const char* code, const char* name, const char* unit, double value, const char* type) {
+        rates[code] = {{"name", name}, {"unit", unit}, {"value", value}, {"type", type}};
+    };
+    add("btc", "Bitcoin", "BTC", 1, "crypto");
+    add("eth", "Ether", "ETH", 26.8, "crypto");
+    add("usd", "US Dollar", "$", 122004.5, "fiat");
+    add("eur", "Euro", "€", 104853.9, "fiat");
+    add("gbp", "British Pound Sterling", "£", 91095.1, "fiat");
+    add("jpy", "Japanese Yen", "¥", 18410280.0, "fiat");
+    add("chf", "Swiss Franc", "Fr.", 97309.3, "fiat");
+    add("inr", "Indian Rupee", "₹", 10751020.0, "fiat");
+    return nlohmann::json{{"rates", rates}}.dump();
+}
+
+// /search/trending
+inline std::string trendingPayload(const std::string& dir = "") {
+    std::string recorded;
+    if(!dir.empty() && readFile(dir + "/trending.json", recorded)) return recorded;
+
+    nlohmann::json coins = nlohmann::json::array();
+    for(const auto& c : makeSyntheticCoins(15, 7)) {
+        coins.push_back({{"item", {
+            {"id", c.id}, {"coin_id", c.rank}, {"name", c.name}, {"symbol", c.symbol},
+            {"market_cap_rank", c.rank}, {"thumb", c.logo}, {"small", c.logo}, {"large", c.logo},
+            {"price_btc", c.price / 62000}, {"score", c.rank - 1},
+            {"data", {{"price", c.price}, {"sparkline", c.logo}}},
+        }}});
+    }
+    nlohmann::json categories = nlohmann::json::array();
+    for(const char* name : {"Meme", "Layer 1 (L1)", "AI Agents", "Real World Assets (RWA)", "Solana Ecosystem"}) {
+        categories.push_back({{"id", categories.size() + 1}, {"name", name}, {"market_cap_1h_change", 0.4}});
+    }
+    return nlohmann::json{{"coins", coins}, {"nfts", nlohmann::json::array()}, {"categories", categories}}.dump();
+}
+
+} // namespace bench
@@ -0,0 +1,329 @@
+#include "change_log.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+
+#include "coin_query.h"
+#include "history_query.h"
+#include "market_snapshot.h"
+
+using namespace std;
+
+namespace {
+
+constexpr uint32_t bit(CoinField field) {
+    return 1u << static_cast<size_t>(field);
+}
+
+// Equal, counting NaN (a field upstream sent as null) as equal to itself
+bool sameNumber(double a, double b) {
+    return a == b || (isnan(a) && isnan(b));
+}
+
+uint32_t changedFields(const CoinData& a, const CoinData& b) {
+    uint32_t mask = 0;
+    if(a.rank != b.rank) mask |= bit(CoinField::Rank);
+    if(a.name != b.name) mask |= bit(CoinField::Name);
+    if(a.symbol != b.symbol) mask |= bit(CoinField::Symbol);
+    if(a.logo != b.logo) mask |= bit(CoinField::Logo);
+    if(!sameNumber(a.price, b.price)) mask |= bit(CoinField::Price);
+    if(!sameNumber(a.change24h, b.change24h)) mask |= bit(CoinField::Change24h);
+    if(!sameNumber(a.marketCap, b.marketCap)) mask |= bit(CoinField::MarketCap);
+    if(!sameNumber(a.volume24h, b.volume24h)) mask |= bit(CoinField::Volume24h);
+    if(!sameNumber(a.circulatingSupply, b.circulatingSupply)) mask |= bit(CoinField::CirculatingSupply);
+    if(!sameNumber(a.totalSupply, b.totalSupply)) mask |= bit(CoinField::TotalSupply);
+    if(!sameNumber(a.maxSupply, b.maxSupply)) mask |= bit(CoinField::MaxSupply);
+    if(!sameNumber(a.ath, b.ath)) mask |= bit(CoinField::Ath);
+    if(!sameNumber(a.athChangePercentage, b.athChangePercentage)) mask |= bit(CoinField::AthChangePercentage);
+    if(a.athDate != b.athDate) mask |= bit(CoinField::AthDate);
+    if(!equal(a.sparkline7d.begin(), a.sparkline7d.end(), b.sparkline7d.begin(), b.sparkline7d.end(), sameNumber)) {
+        mask |= bit(CoinField::Sparkline);
+    }
+    return mask;
+}
+
+// How `after` differs from `before` in one period: the number of points
+// appended (with the oldest dropped past `capacity`), or false when the two
+// don't line up that way and the period has to be sent whole
+bool appendedPoints(const CoinHistory::Spans& before, const CoinHistory::Spans& after, size_t capacity,
+                    size_t& appended) {
+    if(before.size() == 0) {
+        appended = after.size();
+        return true;
+    }
+    long long last = before.time(before.size() - 1);
+    appended = after.size() - after.lowerBound(last + 1);
+    if(after.size() != min(before.size() + appended, capacity)) return false;
+
+    // What is left of the old points must be the old series' newest ones
+    size_t kept = after.size() - appended;
+    size_t offset = before.size() - kept;
+    for(size_t i = 0; i < kept; i++) {
+        if(after.time(i) != before.time(offset + i) || !sameNumber(after.price(i), before.price(offset + i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void diffHistory(const CoinData& before, const CoinData& after, CoinChange& change) {
+    if(after.historicalData.sharesWith(before.historicalData)) return;
+
+    for(const auto& spec : PERIODS) {
+        bool had = before.historicalData.has(spec.period);
+        bool has = after.historicalData.has(spec.period);
+        if(!has) {
+            if(had) change.replaced |= uint8_t(1u << static_cast<size_t>(spec.period));
+            continue;
+        }
+
+        size_t appended = 0;
+        if(had && appendedPoints(before.historicalData.spans(spec.period), after.historicalData.spans(spec.period),
+                                 spec.capacity, appended)) {
+            change.appended[static_cast<size_t>(spec.period)] = (uint16_t)appended;
+        } else {
+            change.replaced |= uint8_t(1u << static_cast<size_t>(spec.period));
+        }
+    }
+}
+
+// Every field and every loaded period, for a coin the client hasn't seen
+CoinChange wholeCoin(const CoinData& coin) {
+    CoinChange change;
+    change.id = coin.id;
+    change.fields = ALL_COIN_FIELDS;
+    for(const auto& spec : PERIODS) {
+        if(coin.historicalData.has(spec.period)) change.replaced |= uint8_t(1u << static_cast<size_t>(spec.period));
+    }
+    return change;
+}
+
+// Fold a later change of the same coin into `into`
+void fold(CoinChange& into, const CoinChange& later) {
+    into.fields |= later.fields;
+    into.replaced |= later.replaced;
+    for(size_t p = 0; p < PERIOD_COUNT; p++) {
+        size_t total = (size_t)into.appended[p] + later.appended[p];
+        // Once a whole window has been appended, the window is simply new
+        if(total >= PERIODS[p].capacity) {
+            into.replaced |= uint8_t(1u << p);
+            total = 0;
+        }
+        into.appended[p] = (uint16_t)total;
+    }
+}
+
+bool byId(const CoinChange& a, const CoinChange& b) {
+    return a.id < b.id;
+}
+
+} // namespace
+
+bool CoinChange::historyChanged() const {
+    if(replaced) return true;
+    for(uint16_t n : appended) {
+        if(n) return true;
+    }
+    return false;
+}
+
+void ChangeLog::record(unsigned long long since, unsigned long long version, const vector<CoinData>& before,
+                       const CoinIndex& beforeIndex, const vector<CoinData>& after) {
+    // A version going backwards (a new leader with its clock behind) has
+    // nothing to be diffed against
+    if(since >= version) {
+        entries_.clear();
+        coinChanges_ = 0;
+        return;
+    }
+
+    auto entry = make_shared<VersionChanges>();
+    entry->since = since;
+    entry->version = version;
+
+    vector<bool> seen(before.size());
+    for(const CoinData& coin : after) {
+        size_t slot = beforeIndex.findById(before, coin.id);
+        if(slot == CoinIndex::npos) {
+            entry->coins.push_back(wholeCoin(coin));
+            continue;
+        }
+        seen[slot] = true;
+
+        CoinChange change;
+        change.fields = changedFields(before[slot], coin);
+        diffHistory(before[slot], coin, change);
+        if(change.fields || change.historyChanged()) {
+            change.id = coin.id;
+            entry->coins.push_back(move(change));
+        }
+    }
+    for(size_t i = 0; i < before.size(); i++) {
+        if(!seen[i]) entry->removed.push_back(before[i].id);
+    }
+    sort(entry->coins.begin(), entry->coins.end(), byId);
+    sort(entry->removed.begin(), entry->removed.end());
+
+    // Entries must follow one another for a fold to be complete
+    if(!entries_.empty() && entries_.back()->version != since) {
+        entries_.clear();
+        coinChanges_ = 0;
+    }
+    coinChanges_ += entry->coins.size();
+    entries_.push_back(move(entry));
+
+    size_t drop = 0;
+    while(entries_.size() - drop > MAX_VERSIONS ||
+          (coinChanges_ > MAX_COIN_CHANGES && entries_.size() - drop > 1)) {
+        coinChanges_ -= entries_[drop]->coins.size();
+        drop++;
+    }
+    entries_.erase(entries_.begin(), entries_.begin() + drop);
+}
+
+bool ChangeLog::covers(unsigned long long since, unsigned long long current) const {
+    if(since == current) return true;
+    if(since > current || entries_.empty() || entries_.back()->version != current) return false;
+    auto it = lower_bound(entries_.begin(), entries_.end(), since,
+                          [](const shared_ptr<const VersionChanges>& e, unsigned long long v) { return e->since < v; });
+    return it != entries_.end() && (*it)->since == since;
+}
+
+ChangeSet ChangeLog::collect(unsigned long long since) const {
+    map<string_view, CoinChange> coins;
+    map<string_view, bool> removed;
+    for(const auto& entry : entries_) {
+        if(entry->version <= since) continue;
+        for(const CoinChange& change : entry->coins) {
+            removed.erase(change.id);
+            auto [it, added] = coins.emplace(change.id, change);
+            if(!added) fold(it->second, change);
+        }
+        for(const string& id : entry->removed) {
+            coins.erase(id);
+            removed[id] = true;
+        }
+    }
+
+    ChangeSet out;
+    out.coins.reserve(coins.size());
+    for(auto& [id, change] : coins) out.coins.push_back(move(change));
+    for(const auto& [id, gone] : removed) out.removed.emplace_back(id);
+    return out;
+}
+
+CoinChange ChangeLog::collect(unsigned long long since, string_view id) const {
+    CoinChange out;
+    out.id = string(id);
+    for(const auto& entry : entries_) {
+        if(entry->version <= since) continue;
+        auto it = lower_bound(entry->coins.begin(), entry->coins.end(), id,
+                              [](const CoinChange& c, string_view key) { return c.id < key; });
+        if(it != entry->coins.end() && it->id == id) {
+            fold(out, *it);
+        } else if(binary_search(entry->removed.begin(), entry->removed.end(), id)) {
+            out = CoinChange();
+            out.id = string(id);
+        }
+    }
+    return out;
+}
+
+bool parseSinceVersion(const char* text, unsigned long long& out) {
+    if(!text || *text < '0' || *text > '9') return false;
+    char* end;
+    errno = 0;
+    out = strtoull(text, &end, 10);
+    return !*end && errno == 0;
+}
+
+string encodeCoinsDelta(const MarketSnapshot& snapshot, unsigned long long since, uint32_t fields,
+                        const Representation& rep) {
+    ChangeSet changes = snapshot.changes.collect(since);
+
+    // Coins with a requested field changed, and which of their fields to send
+    vector<pair<const CoinData*, uint32_t>> sent;
+    for(const CoinChange& change : changes.coins) {
+        uint32_t mask = change.fields & fields;
+        const CoinData* coin = findCoin(snapshot, change.id);
+        if(!mask || !coin) continue;
+        sent.emplace_back(coin, mask | bit(CoinField::Id));
+    }
+
+    WireWriter out(rep.format);
+    out.beginMap(4);
+    out.key("version");
+    out.integer((long long)snapshot.version);
+    out.key("since");
+    out.integer((long long)since);
+    out.key("coins");
+    out.beginArray(sent.size());
+    for(const auto& [coin, mask] : sent) {
+        out.beginMap(coinFieldCount(mask));
+        writeCoinFields(out, *coin, mask, rep.layout);
+        out.endMap();
+    }
+    out.endArray();
+    out.key("removed");
+    out.beginArray(changes.removed.size());
+    for(const string& id : changes.removed) out.string(id);
+    out.endArray();
+    out.endMap();
+    return out.take();
+}
+
+string encodeCoinDelta(const MarketSnapshot& snapshot, const CoinData& coin, unsigned long long since,
+                       const Representation& rep) {
+    CoinChange change = snapshot.changes.collect(since, coin.id);
+    uint32_t mask = change.fields | bit(CoinField::Id);
+
+    size_t periods = 0;
+    for(const auto& spec : PERIODS) {
+        size_t p = static_cast<size_t>(spec.period);
+        bool changed = (change.replaced >> p & 1) || change.appended[p];
+        if(changed && coin.historicalData.has(spec.period)) periods++;
+    }
+
+    WireWriter out(rep.format);
+    out.beginMap(3);
+    out.key("version");
+    out.integer((long long)snapshot.version);
+    out.key("since");
+    out.integer((long long)since);
+    out.key("coin");
+    out.beginMap(coinFieldCount(mask) + (periods > 0));
+    writeCoinFields(out, coin, mask, rep.layout);
+    if(periods > 0) {
+        out.key("historicalData");
+        out.beginMap(periods);
+        for(const auto& spec : PERIODS) {
+            size_t p = static_cast<size_t>(spec.period);
+            bool replace = change.replaced >> p & 1;
+            if((!replace && !change.appended[p]) || !coin.historicalData.has(spec.period)) continue;
+
+            CoinHistory::Spans spans = coin.historicalData.spans(spec.period);
+            out.key(spec.key);
+            out.beginMap(1);
+            if(replace) {
+                out.key("replace");
+                writeSeries(out, spans, rep.layout);
+            } else {
+                // The newest points; every one of them is still in the window
+                vector<size_t> picked;
+                for(size_t i = spans.size() - min<size_t>(change.appended[p], spans.size()); i < spans.size(); i++) {
+                    picked.push_back(i);
+                }
+                out.key("append");
+                writeSeries(out, spans, picked, rep.layout);
+            }
+            out.endMap();
+        }
+        out.endMap();
+    }
+    out.endMap();
+    out.endMap();
+    return out.take();
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "coin_index.h"
+#include "history.h"
+#include "market_data.h"
+#include "wire_format.h"
+
+struct MarketSnapshot;
+
+// What one publish changed about one coin
+struct CoinChange {
+    std::string id;
+    uint32_t fields = 0;    // CoinField mask of changed list fields (all of them for a new coin)
+    uint8_t replaced = 0;   // bit per Period: rebuilt from upstream rather than appended to
+    std::array<uint16_t, PERIOD_COUNT> appended{}; // per Period: points appended
+
+    bool historyChanged() const;
+};
+
+// Everything one published version changed against the version published
+// before it: normally version - 1, but a replica follower skips the versions
+// its leader published between two generations. Coins are sorted by id.
+struct VersionChanges {
+    unsigned long long since = 0;   // the version diffed against
+    unsigned long long version = 0;
+    std::vector<CoinChange> coins;
+    std::vector<std::string> removed;
+};
+
+// Changes of several consecutive versions folded into one
+struct ChangeSet {
+    std::vector<CoinChange> coins;      // sorted by id
+    std::vector<std::string> removed;   // sorted; not re-added since
+};
+
+// The changes of the most recent published versions, so a client holding
+// version N can be sent only what changed after it. Part of every snapshot:
+// entries are immutable and shared between snapshots, and each publish
+// copies the (bounded) list of pointers and appends its own entry.
+class ChangeLog {
+public:
+    // Bounds on what is kept; older versions are dropped first
+    static constexpr size_t MAX_VERSIONS = 1024;
+    static constexpr size_t MAX_COIN_CHANGES = 100000;
+
+    // Diff two consecutively published snapshots' coins, versions `since`
+    // and `version`, and log the result as `version`
+    void record(unsigned long long since, unsigned long long version, const std::vector<CoinData>& before,
+                const CoinIndex& beforeIndex, const std::vector<CoinData>& after);
+
+    // Whether every change after `since` up to `current` is still logged.
+    // `since` must be a version this log saw published: one a follower
+    // skipped has no diff to start from.
+    bool covers(unsigned long long since, unsigned long long current) const;
+
+    // Fold the changes after `since` (requires covers())
+    ChangeSet collect(unsigned long long since) const;
+
+    // Fold the changes after `since` for one coin
+    CoinChange collect(unsigned long long since, std::string_view id) const;
+
+    size_t versions() const { return entries_.size(); }
+
+private:
+    std::vector<std::shared_ptr<const VersionChanges>> entries_; // oldest first
+    size_t coinChanges_ = 0;
+};
+
+// Parse a since= value; false if it isn't a version number
+bool parseSinceVersion(const char* text, unsigned long long& out);
+
+// {"version":V,"since":N,"coins":[{"id":..,<changed fields>},..],"removed":[ids]}
+// for /api/coins?since=N. Only fields in `fields` are sent; id always is.
+std::string encodeCoinsDelta(const MarketSnapshot& snapshot, unsigned long long since, uint32_t fields,
+                             const Representation& rep);
+
+// {"version":V,"since":N,"coin":{"id":..,<changed fields>,"historicalData":{"24h":{"append":<series>}|
+// {"replace":<series>},..}}} for /api/coin/:id?since=N. Appended points go on
+// the end of the client's copy of the period, dropping the oldest past its
+// capacity.
+std::string encodeCoinDelta(const MarketSnapshot& snapshot, const CoinData& coin, unsigned long long since,
+                            const Representation& rep);
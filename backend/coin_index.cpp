@@ -0,0 +1,119 @@
+#include "coin_index.h"
+
+#include <cctype>
+
+using namespace std;
+
+namespace {
+
+// FNV-1a, optionally folding ASCII case
+uint32_t hashKey(string_view key, bool foldCase) {
+    uint64_t h = 14695981039346656037ULL;
+    for(unsigned char ch : key) {
+        h ^= foldCase ? (unsigned char)tolower(ch) : ch;
+        h *= 1099511628211ULL;
+    }
+    return (uint32_t)(h ^ (h >> 32));
+}
+
+bool equalsIgnoreCase(string_view a, string_view b) {
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); i++) {
+        if(tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+    }
+    return true;
+}
+
+// Lower rank number is better; 0 means unranked and loses to any ranked coin
+bool ranksBetter(int candidate, int current) {
+    if(candidate <= 0) return false;
+    return current <= 0 || candidate < current;
+}
+
+} // namespace
+
+void CoinIndex::reserveFor(size_t coinCount) {
+    // Keep the load factor at or below 1/2 so probe sequences stay short
+    size_t capacity = 16;
+    while(capacity < coinCount * 2) capacity <<= 1;
+
+    ids_.assign(capacity, Entry{});
+    symbols_.assign(capacity, Entry{});
+    count_ = 0;
+}
+
+void CoinIndex::rebuild(const vector<CoinData>& coins) {
+    reserveFor(coins.size());
+    for(size_t slot = 0; slot < coins.size(); slot++) {
+        insertId(coins, (uint32_t)slot);
+        insertSymbol(coins, (uint32_t)slot);
+        count_++;
+    }
+}
+
+void CoinIndex::insert(const vector<CoinData>& coins, size_t slot) {
+    if(ids_.empty() || (count_ + 1) * 2 > ids_.size()) {
+        rebuild(coins);
+        return;
+    }
+    insertId(coins, (uint32_t)slot);
+    insertSymbol(coins, (uint32_t)slot);
+    count_++;
+}
+
+void CoinIndex::insertId(const vector<CoinData>& coins, uint32_t slot) {
+    uint32_t h = hashKey(coins[slot].id, false);
+    size_t mask = ids_.size() - 1;
+    for(size_t i = h & mask;; i = (i + 1) & mask) {
+        Entry& e = ids_[i];
+        if(e.slot == EMPTY || (e.hash == h && coins[e.slot].id == coins[slot].id)) {
+            e.hash = h;
+            e.slot = slot;
+            return;
+        }
+    }
+}
+
+void CoinIndex::insertSymbol(const vector<CoinData>& coins, uint32_t slot) {
+    const CoinData& coin = coins[slot];
+    if(coin.symbol.empty()) return;
+
+    uint32_t h = hashKey(coin.symbol, true);
+    size_t mask = symbols_.size() - 1;
+    for(size_t i = h & mask;; i = (i + 1) & mask) {
+        Entry& e = symbols_[i];
+        if(e.slot == EMPTY) {
+            e.hash = h;
+            e.slot = slot;
+            return;
+        }
+        if(e.hash == h && equalsIgnoreCase(coins[e.slot].symbol, coin.symbol)) {
+            if(ranksBetter(coin.rank, coins[e.slot].rank)) e.slot = slot;
+            return;
+        }
+    }
+}
+
+size_t CoinIndex::findById(const vector<CoinData>& coins, string_view id) const {
+    if(ids_.empty()) return npos;
+
+    uint32_t h = hashKey(id, false);
+    size_t mask = ids_.size() - 1;
+    for(size_t i = h & mask;; i = (i + 1) & mask) {
+        const Entry& e = ids_[i];
+        if(e.slot == EMPTY) return npos;
+        if(e.hash == h && e.slot < coins.size() && coins[e.slot].id == id) return e.slot;
+    }
+}
+
+size_t CoinIndex::findBySymbol(const vector<CoinData>& coins, string_view symbol) const {
+    if(symbols_.empty()) return npos;
+
+    uint32_t h = hashKey(symbol, true);
+    size_t mask = symbols_.size() - 1;
+    for(size_t i = h & mask;; i = (i + 1) & mask) {
+        const Entry& e = symbols_[i];
+        if(e.slot == EMPTY) return npos;
+        if(e.hash == h && e.slot < coins.size() && equalsIgnoreCase(coins[e.slot].symbol, symbol)) return e.slot;
+    }
+}
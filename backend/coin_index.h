@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "market_data.h"
+
+// Open-addressing hash index from coin id (and ticker symbol) to the coin's
+// slot in a vector<CoinData>.
+//
+// Entries store only a hash and a slot number; keys are compared against the
+// coin records themselves. The index therefore holds no strings of its own
+// and stays valid when the snapshot that owns both the coins and the index
+// is copied. Any change to the coin list order or membership must be
+// followed by insert() for appended coins or by rebuild().
+class CoinIndex {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    // Re-index every coin in `coins`
+    void rebuild(const std::vector<CoinData>& coins);
+
+    // Index a coin that was just appended at `slot`
+    void insert(const std::vector<CoinData>& coins, size_t slot);
+
+    // Slot of the coin with this exact id, or npos
+    size_t findById(const std::vector<CoinData>& coins, std::string_view id) const;
+
+    // Slot of the best-ranked coin with this symbol (case-insensitive), or npos.
+    // Symbols are not unique upstream, so the highest market cap rank wins.
+    size_t findBySymbol(const std::vector<CoinData>& coins, std::string_view symbol) const;
+
+    size_t size() const { return count_; }
+
+private:
+    static constexpr uint32_t EMPTY = 0xFFFFFFFFu;
+
+    struct Entry {
+        uint32_t hash = 0;
+        uint32_t slot = EMPTY;
+    };
+
+    void reserveFor(size_t coinCount);
+    void insertId(const std::vector<CoinData>& coins, uint32_t slot);
+    void insertSymbol(const std::vector<CoinData>& coins, uint32_t slot);
+
+    std::vector<Entry> ids_;
+    std::vector<Entry> symbols_;
+    size_t count_ = 0;
+};
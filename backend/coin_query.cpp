@@ -0,0 +1,255 @@
+#include "coin_query.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <string_view>
+
+#include "market_snapshot.h"
+
+using json = nlohmann::json;
+using namespace std;
+
+namespace {
+
+struct FieldSpec {
+    CoinField field;
+    const char* name;
+    void (*write)(json& out, const char* name, const CoinData& coin);
+    void (*encode)(WireWriter& out, const CoinData& coin, SeriesLayout layout);
+};
+
+void encodeSparkline(WireWriter& out, const CoinData& coin, SeriesLayout layout) {
+    const vector<double>& values = coin.sparkline7d;
+    if(layout == SeriesLayout::Columns) {
+        out.beginFloat64Column(values.size());
+        out.columnValues(values.data(), values.size());
+        out.endColumn();
+        return;
+    }
+    out.beginArray(values.size());
+    for(double v : values) out.number(v);
+    out.endArray();
+}
+
+// Field table, in CoinField order
+const FieldSpec FIELDS[] = {
+    {CoinField::Id, "id", [](json& j, const char* k, const CoinData& c) { j[k] = c.id; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.string(c.id); }},
+    {CoinField::Rank, "rank", [](json& j, const char* k, const CoinData& c) { j[k] = c.rank; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.integer(c.rank); }},
+    {CoinField::Name, "name", [](json& j, const char* k, const CoinData& c) { j[k] = c.name; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.string(c.name); }},
+    {CoinField::Symbol, "symbol", [](json& j, const char* k, const CoinData& c) { j[k] = c.symbol; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.string(c.symbol); }},
+    {CoinField::Logo, "logo", [](json& j, const char* k, const CoinData& c) { j[k] = c.logo; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.string(c.logo); }},
+    {CoinField::Price, "price", [](json& j, const char* k, const CoinData& c) { j[k] = c.price; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.number(c.price); }},
+    {CoinField::Change24h, "change24h", [](json& j, const char* k, const CoinData& c) { j[k] = c.change24h; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.number(c.change24h); }},
+    {CoinField::MarketCap, "marketCap", [](json& j, const char* k, const CoinData& c) { j[k] = c.marketCap; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.number(c.marketCap); }},
+    {CoinField::Volume24h, "volume24h", [](json& j, const char* k, const CoinData& c) { j[k] = c.volume24h; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.number(c.volume24h); }},
+    {CoinField::CirculatingSupply, "circulatingSupply",
+     [](json& j, const char* k, const CoinData& c) { j[k] = c.circulatingSupply; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.number(c.circulatingSupply); }},
+    {CoinField::TotalSupply, "totalSupply", [](json& j, const char* k, const CoinData& c) { j[k] = c.totalSupply; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.number(c.totalSupply); }},
+    {CoinField::MaxSupply, "maxSupply", [](json& j, const char* k, const CoinData& c) { j[k] = c.maxSupply; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.number(c.maxSupply); }},
+    {CoinField::Ath, "ath", [](json& j, const char* k, const CoinData& c) { j[k] = c.ath; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.number(c.ath); }},
+    {CoinField::AthChangePercentage, "athChangePercentage",
+     [](json& j, const char* k, const CoinData& c) { j[k] = c.athChangePercentage; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.number(c.athChangePercentage); }},
+    {CoinField::AthDate, "athDate", [](json& j, const char* k, const CoinData& c) { j[k] = c.athDate; },
+     [](WireWriter& w, const CoinData& c, SeriesLayout) { w.string(c.athDate); }},
+    {CoinField::Sparkline, "sparklineData", [](json& j, const char* k, const CoinData& c) { j[k] = c.sparkline7d; },
+     encodeSparkline},
+};
+
+static_assert(sizeof(FIELDS) / sizeof(FIELDS[0]) == COIN_FIELD_COUNT, "FIELDS must list every CoinField");
+
+struct SortSpec {
+    CoinSortKey key;
+    const char* name;
+    double (*value)(const CoinData& coin); // NaN = no value
+};
+
+// Sort key table, in CoinSortKey order
+const SortSpec SORT_KEYS[] = {
+    {CoinSortKey::Rank, "rank", [](const CoinData& c) { return c.rank > 0 ? (double)c.rank : NAN; }},
+    {CoinSortKey::Price, "price", [](const CoinData& c) { return c.price; }},
+    {CoinSortKey::Change24h, "change24h", [](const CoinData& c) { return c.change24h; }},
+    {CoinSortKey::MarketCap, "marketCap", [](const CoinData& c) { return c.marketCap; }},
+    {CoinSortKey::Volume24h, "volume24h", [](const CoinData& c) { return c.volume24h; }},
+    {CoinSortKey::AthChangePercentage, "athChangePercentage", [](const CoinData& c) { return c.athChangePercentage; }},
+};
+
+static_assert(sizeof(SORT_KEYS) / sizeof(SORT_KEYS[0]) == COIN_SORT_KEY_COUNT, "SORT_KEYS must list every CoinSortKey");
+
+bool parseCount(const char* text, size_t& out) {
+    if(!*text) return false;
+    errno = 0;
+    char* end;
+    unsigned long long value = strtoull(text, &end, 10);
+    if(*end || errno || text[0] == '-') return false;
+    out = (size_t)value;
+    return true;
+}
+
+} // namespace
+
+const char* coinFieldName(CoinField field) {
+    return FIELDS[static_cast<size_t>(field)].name;
+}
+
+json coinFieldsToJson(const CoinData& coin, uint32_t mask) {
+    json j = json::object();
+    for(const auto& spec : FIELDS) {
+        if(mask & (1u << static_cast<size_t>(spec.field))) spec.write(j, spec.name, coin);
+    }
+    return j;
+}
+
+size_t coinFieldCount(uint32_t mask) {
+    size_t count = 0;
+    for(; mask; mask &= mask - 1) count++;
+    return count;
+}
+
+void writeCoinFields(WireWriter& out, const CoinData& coin, uint32_t mask, SeriesLayout layout) {
+    for(const auto& spec : FIELDS) {
+        if(!(mask & (1u << static_cast<size_t>(spec.field)))) continue;
+        out.key(spec.name);
+        spec.encode(out, coin, layout);
+    }
+}
+
+void CoinOrders::rebuild(const vector<CoinData>& coins) {
+    vector<double> values(coins.size());
+    for(const auto& spec : SORT_KEYS) {
+        Order& order = orders_[static_cast<size_t>(spec.key)];
+        order.slots.resize(coins.size());
+        for(size_t i = 0; i < coins.size(); i++) {
+            order.slots[i] = (uint32_t)i;
+            values[i] = spec.value(coins[i]);
+        }
+
+        auto valueless = stable_partition(order.slots.begin(), order.slots.end(),
+                                          [&](uint32_t slot) { return !isnan(values[slot]); });
+        order.ranked = valueless - order.slots.begin();
+        stable_sort(order.slots.begin(), valueless,
+                    [&](uint32_t a, uint32_t b) { return values[a] < values[b]; });
+    }
+}
+
+bool CoinQuery::isDefault() const {
+    return fields == ALL_COIN_FIELDS && sort == CoinSortKey::Rank && !descending && minMarketCap == 0 &&
+           offset == 0 && limit == SIZE_MAX;
+}
+
+bool parseCoinQuery(const function<const char*(const char*)>& param, CoinQuery& out, string& error) {
+    out = CoinQuery();
+
+    if(const char* fields = param("fields")) {
+        out.fields = 0;
+        string_view rest = fields;
+        while(!rest.empty()) {
+            size_t comma = rest.find(',');
+            string_view name = rest.substr(0, comma);
+            rest.remove_prefix(comma == string_view::npos ? rest.size() : comma + 1);
+            if(name.empty()) continue;
+
+            auto spec = find_if(begin(FIELDS), end(FIELDS), [&](const FieldSpec& f) { return name == f.name; });
+            if(spec == end(FIELDS)) {
+                error = "Unknown field: " + string(name);
+                return false;
+            }
+            out.fields |= 1u << static_cast<size_t>(spec->field);
+        }
+        if(out.fields == 0) {
+            error = "fields= lists no fields";
+            return false;
+        }
+    }
+
+    if(const char* sort = param("sort")) {
+        string_view key = sort;
+        out.descending = !key.empty() && key[0] == '-';
+        if(out.descending) key.remove_prefix(1);
+
+        auto spec = find_if(begin(SORT_KEYS), end(SORT_KEYS), [&](const SortSpec& s) { return key == s.name; });
+        if(spec == end(SORT_KEYS)) {
+            error = "Unknown sort key: " + string(key);
+            return false;
+        }
+        out.sort = spec->key;
+    }
+
+    if(const char* minMcap = param("min_mcap")) {
+        char* end;
+        out.minMarketCap = strtod(minMcap, &end);
+        if(!*minMcap || *end || !isfinite(out.minMarketCap)) {
+            error = "min_mcap must be a number";
+            return false;
+        }
+    }
+
+    if(const char* limit = param("limit")) {
+        if(!parseCount(limit, out.limit)) {
+            error = "limit must be a non-negative integer";
+            return false;
+        }
+    }
+
+    if(const char* offset = param("offset")) {
+        if(!parseCount(offset, out.offset)) {
+            error = "offset must be a non-negative integer";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+string runCoinQuery(const MarketSnapshot& snapshot, const CoinQuery& query, const Representation& rep,
+                    size_t* matched) {
+    const CoinOrders::Order& order = snapshot.orders.get(query.sort);
+    const bool filtered = query.minMarketCap != 0;
+    const size_t count = order.slots.size();
+
+    // The binary formats need the array length up front, so pick the slice first
+    vector<const CoinData*> slice;
+    size_t passed = 0;
+    for(size_t i = 0; i < count; i++) {
+        // Descending walks the valued slots backwards; valueless ones stay last
+        size_t k = (query.descending && i < order.ranked) ? order.ranked - 1 - i : i;
+        const CoinData& coin = snapshot.coins[order.slots[k]];
+        if(filtered && !(coin.marketCap >= query.minMarketCap)) continue;
+
+        if(passed >= query.offset && passed - query.offset < query.limit) {
+            slice.push_back(&coin);
+        } else if(!filtered && passed >= query.offset) {
+            passed = count; // unfiltered: everything matches, stop at the end of the slice
+            break;
+        }
+        passed++;
+    }
+
+    if(matched) *matched = passed;
+
+    WireWriter out(rep.format);
+    const size_t fields = coinFieldCount(query.fields);
+    out.beginArray(slice.size());
+    for(const CoinData* coin : slice) {
+        out.beginMap(fields);
+        writeCoinFields(out, *coin, query.fields, rep.layout);
+        out.endMap();
+    }
+    out.endArray();
+    return out.take();
+}
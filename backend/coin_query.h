@@ -0,0 +1,104 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "market_data.h"
+#include "wire_format.h"
+
+struct MarketSnapshot;
+
+// Fields of a coin in the /api/coins list, selectable with fields=
+enum class CoinField : uint8_t {
+    Id,
+    Rank,
+    Name,
+    Symbol,
+    Logo,
+    Price,
+    Change24h,
+    MarketCap,
+    Volume24h,
+    CirculatingSupply,
+    TotalSupply,
+    MaxSupply,
+    Ath,
+    AthChangePercentage,
+    AthDate,
+    Sparkline,
+};
+
+constexpr size_t COIN_FIELD_COUNT = 16;
+constexpr uint32_t ALL_COIN_FIELDS = (1u << COIN_FIELD_COUNT) - 1;
+
+// API name of a field ("change24h", "sparklineData", ...)
+const char* coinFieldName(CoinField field);
+
+// The fields in `mask` (bit i = CoinField i) of a coin as a JSON object
+nlohmann::json coinFieldsToJson(const CoinData& coin, uint32_t mask);
+
+// Number of fields selected by `mask`
+size_t coinFieldCount(uint32_t mask);
+
+// The same fields as key/value pairs of a map the caller has opened with
+// coinFieldCount(mask) entries. The sparkline follows `layout`.
+void writeCoinFields(WireWriter& out, const CoinData& coin, uint32_t mask, SeriesLayout layout);
+
+// Keys /api/coins can be sorted by (sort=key ascending, sort=-key descending)
+enum class CoinSortKey : uint8_t {
+    Rank,
+    Price,
+    Change24h,
+    MarketCap,
+    Volume24h,
+    AthChangePercentage,
+};
+
+constexpr size_t COIN_SORT_KEY_COUNT = 6;
+
+// Slots of a coin list sorted by every CoinSortKey, rebuilt once per data
+// version so a query only walks the slice it returns. Like CoinIndex it
+// stores slot numbers only and stays valid when its snapshot is copied.
+class CoinOrders {
+public:
+    struct Order {
+        std::vector<uint32_t> slots; // ascending by the key, ties by slot
+        size_t ranked = 0;           // slots[ranked..] have no value (unranked, NaN) and sort last either way
+    };
+
+    void rebuild(const std::vector<CoinData>& coins);
+
+    const Order& get(CoinSortKey key) const { return orders_[static_cast<size_t>(key)]; }
+
+private:
+    std::array<Order, COIN_SORT_KEY_COUNT> orders_;
+};
+
+// Parsed /api/coins query string
+struct CoinQuery {
+    uint32_t fields = ALL_COIN_FIELDS;
+    CoinSortKey sort = CoinSortKey::Rank;
+    bool descending = false;
+    double minMarketCap = 0; // 0 = no filter
+    size_t offset = 0;
+    size_t limit = SIZE_MAX;
+
+    // No parameters given: the pre-rendered full list answers it
+    bool isDefault() const;
+};
+
+// Parse fields=, sort=, min_mcap=, limit= and offset=, reading each with
+// `param` (nullptr when absent). On a bad value returns false with a message
+// in `error`.
+bool parseCoinQuery(const std::function<const char*(const char*)>& param, CoinQuery& out, std::string& error);
+
+// Run a query against a snapshot and serialize the slice as an array in the
+// requested representation. `matched` receives the number of coins passing
+// the filter before offset/limit are applied.
+std::string runCoinQuery(const MarketSnapshot& snapshot, const CoinQuery& query,
+                         const Representation& rep = Representation(), size_t* matched = nullptr);
@@ -0,0 +1,192 @@
+#include "coingecko_json.h"
+
+using namespace std;
+
+namespace {
+
+struct NumericField {
+    const char* key;
+    MarketField field;
+    double MarketQuote::* member;
+};
+
+const NumericField NUMERIC_FIELDS[] = {
+    {"current_price", FIELD_PRICE, &MarketQuote::price},
+    {"price_change_percentage_24h", FIELD_CHANGE_24H, &MarketQuote::change24h},
+    {"market_cap", FIELD_MARKET_CAP, &MarketQuote::marketCap},
+    {"total_volume", FIELD_VOLUME_24H, &MarketQuote::volume24h},
+    {"circulating_supply", FIELD_CIRCULATING_SUPPLY, &MarketQuote::circulatingSupply},
+    {"total_supply", FIELD_TOTAL_SUPPLY, &MarketQuote::totalSupply},
+    {"max_supply", FIELD_MAX_SUPPLY, &MarketQuote::maxSupply},
+    {"ath", FIELD_ATH, &MarketQuote::ath},
+    {"ath_change_percentage", FIELD_ATH_CHANGE, &MarketQuote::athChangePercentage},
+};
+
+struct StringField {
+    const char* key;
+    std::string MarketQuote::* member;
+};
+
+const StringField STRING_FIELDS[] = {
+    {"id", &MarketQuote::id},
+    {"name", &MarketQuote::name},
+    {"symbol", &MarketQuote::symbol},
+    {"image", &MarketQuote::logo},
+    {"ath_date", &MarketQuote::athDate},
+};
+
+} // namespace
+
+void applyQuote(const MarketQuote& quote, CoinData& coin) {
+    coin.id = quote.id;
+    coin.rank = quote.rank;
+    coin.name = quote.name;
+    coin.symbol = quote.symbol;
+    coin.logo = quote.logo;
+    coin.price = quote.price;
+    coin.change24h = quote.change24h;
+    coin.marketCap = quote.marketCap;
+    coin.volume24h = quote.volume24h;
+    coin.circulatingSupply = quote.circulatingSupply;
+    coin.totalSupply = quote.totalSupply;
+    coin.maxSupply = quote.maxSupply;
+    coin.ath = quote.ath;
+    coin.athChangePercentage = quote.athChangePercentage;
+    coin.athDate = quote.athDate;
+    coin.sparkline7d = quote.sparkline7d;
+}
+
+// ----- /coins/markets -----
+
+void MarketsSink::clear() {
+    quotes_.clear();
+    depth_ = 0;
+    key_.clear();
+    innerKey_.clear();
+    inSparkline_ = false;
+}
+
+bool MarketsSink::startObject() {
+    depth_++;
+    if(depth_ == 1) return false; // an error object, not the coin list
+    if(depth_ == 2) quotes_.emplace_back();
+    return true;
+}
+
+bool MarketsSink::endObject() {
+    depth_--;
+    return true;
+}
+
+bool MarketsSink::startArray() {
+    depth_++;
+    if(depth_ == 4 && key_ == "sparkline_in_7d" && innerKey_ == "price") {
+        inSparkline_ = true;
+        quotes_.back().present |= FIELD_SPARKLINE;
+    }
+    return true;
+}
+
+bool MarketsSink::endArray() {
+    if(depth_ == 4) inSparkline_ = false;
+    depth_--;
+    return true;
+}
+
+bool MarketsSink::key(string_view k) {
+    if(depth_ == 2) {
+        key_.assign(k);
+    } else if(depth_ == 3) {
+        innerKey_.assign(k);
+    }
+    return true;
+}
+
+bool MarketsSink::string(string_view s) {
+    if(depth_ != 2) return true;
+    for(const auto& field : STRING_FIELDS) {
+        if(key_ == field.key) {
+            quotes_.back().*field.member = std::string(s);
+            break;
+        }
+    }
+    return true;
+}
+
+bool MarketsSink::number(double v) {
+    if(inSparkline_) {
+        quotes_.back().sparkline7d.push_back(v);
+        return true;
+    }
+    if(depth_ != 2) return true;
+
+    MarketQuote& quote = quotes_.back();
+    if(key_ == "market_cap_rank") {
+        quote.rank = (int)v;
+        quote.present |= FIELD_RANK;
+        return true;
+    }
+    for(const auto& field : NUMERIC_FIELDS) {
+        if(key_ == field.key) {
+            quote.*field.member = v;
+            quote.present |= field.field;
+            break;
+        }
+    }
+    return true;
+}
+
+// ----- /coins/{id}/market_chart -----
+
+void MarketChartSink::clear() {
+    prices_.clear();
+    depth_ = 0;
+    keyIsPrices_ = false;
+    inPrices_ = false;
+    pointIndex_ = 0;
+}
+
+bool MarketChartSink::startObject() {
+    depth_++;
+    return true;
+}
+
+bool MarketChartSink::endObject() {
+    depth_--;
+    return true;
+}
+
+bool MarketChartSink::startArray() {
+    depth_++;
+    if(depth_ == 2 && keyIsPrices_) inPrices_ = true;
+    if(depth_ == 3) pointIndex_ = 0;
+    return true;
+}
+
+bool MarketChartSink::endArray() {
+    if(depth_ == 2) inPrices_ = false;
+    depth_--;
+    return true;
+}
+
+bool MarketChartSink::key(string_view k) {
+    if(depth_ == 1) keyIsPrices_ = k == "prices";
+    return true;
+}
+
+bool MarketChartSink::number(double v) {
+    if(!inPrices_ || depth_ != 3) return true;
+    if(pointIndex_ == 0) {
+        pointTime_ = (long long)v;
+    } else if(pointIndex_ == 1) {
+        prices_.push_back({pointTime_, v});
+    }
+    pointIndex_++;
+    return true;
+}
+
+// [time, null] points are dropped
+bool MarketChartSink::null() {
+    if(inPrices_ && depth_ == 3) pointIndex_++;
+    return true;
+}
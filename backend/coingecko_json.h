@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "fetch_scheduler.h"
+#include "json_stream.h"
+#include "market_data.h"
+
+// Streaming decoders for CoinGecko responses. Each one is a ResponseSink:
+// hand it to FetchScheduler::submit() and the body is parsed straight off
+// the wire into the structures below, without a response string or DOM.
+
+// Base: owns the push parser and routes its events to the subclass
+class JsonSink : public ResponseSink, protected JsonHandler {
+public:
+    JsonSink() : parser_(*this) {}
+    JsonSink(const JsonSink&) = delete;
+    JsonSink& operator=(const JsonSink&) = delete;
+
+    void reset() override {
+        parser_.reset();
+        clear();
+    }
+
+    bool write(const char* data, size_t size) override { return parser_.feed(data, size); }
+
+    // Call once the request succeeded: false if the body was incomplete
+    bool finish() { return parser_.finish(); }
+
+    const std::string& error() const { return parser_.error(); }
+
+protected:
+    virtual void clear() = 0;
+
+private:
+    JsonPushParser parser_;
+};
+
+// Numeric fields of a /coins/markets row, as bits of MarketQuote::present
+enum MarketField : uint32_t {
+    FIELD_RANK = 1u << 0,
+    FIELD_PRICE = 1u << 1,
+    FIELD_CHANGE_24H = 1u << 2,
+    FIELD_MARKET_CAP = 1u << 3,
+    FIELD_VOLUME_24H = 1u << 4,
+    FIELD_CIRCULATING_SUPPLY = 1u << 5,
+    FIELD_TOTAL_SUPPLY = 1u << 6,
+    FIELD_MAX_SUPPLY = 1u << 7,
+    FIELD_ATH = 1u << 8,
+    FIELD_ATH_CHANGE = 1u << 9,
+    FIELD_SPARKLINE = 1u << 10,
+};
+
+// One row of /coins/markets: everything CoinData holds except history.
+// Missing and null fields read as 0 and leave their bit clear in `present`.
+struct MarketQuote {
+    std::string id;
+    int rank = 0;
+    std::string name;
+    std::string symbol;
+    std::string logo;
+    double price = 0;
+    double change24h = 0;
+    double marketCap = 0;
+    double volume24h = 0;
+    double circulatingSupply = 0;
+    double totalSupply = 0;
+    double maxSupply = 0;
+    double ath = 0;
+    double athChangePercentage = 0;
+    std::string athDate;
+    std::vector<double> sparkline7d;
+    uint32_t present = 0;
+
+    bool has(MarketField field) const { return present & field; }
+};
+
+// Copy every market field of `quote` into `coin`, leaving its history alone
+void applyQuote(const MarketQuote& quote, CoinData& coin);
+
+// /coins/markets
+class MarketsSink : public JsonSink {
+public:
+    std::vector<MarketQuote>& quotes() { return quotes_; }
+
+protected:
+    void clear() override;
+
+    bool startObject() override;
+    bool endObject() override;
+    bool startArray() override;
+    bool endArray() override;
+    bool key(std::string_view k) override;
+    bool string(std::string_view s) override;
+    bool number(double v) override;
+
+private:
+    std::vector<MarketQuote> quotes_;
+    int depth_ = 0;             // 1 = top-level array, 2 = coin object
+    std::string key_;           // last key inside the coin object
+    std::string innerKey_;      // last key one level further down
+    bool inSparkline_ = false;  // sparkline_in_7d.price array
+};
+
+// /coins/{id}/market_chart: collects the "prices" series, skipping
+// market_caps and total_volumes
+class MarketChartSink : public JsonSink {
+public:
+    std::vector<std::pair<long long, double>>& prices() { return prices_; }
+
+protected:
+    void clear() override;
+
+    bool startObject() override;
+    bool endObject() override;
+    bool startArray() override;
+    bool endArray() override;
+    bool key(std::string_view k) override;
+    bool number(double v) override;
+    bool null() override;
+
+private:
+    std::vector<std::pair<long long, double>> prices_;
+    int depth_ = 0;             // 1 = root object, 2 = series array, 3 = [time, value]
+    bool keyIsPrices_ = false;
+    bool inPrices_ = false;
+    int pointIndex_ = 0;
+    long long pointTime_ = 0;
+};
@@ -0,0 +1,253 @@
+#include "compression.h"
+
+#include <cctype>
+#include <cstdlib>
+#include <zlib.h>
+
+#ifdef CRYPTOLIZARD_HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#ifdef CRYPTOLIZARD_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Pre-compression levels. These run once per data version per payload, so
+// they trade encoder CPU for ratio. On our payloads brotli 11 costs ~3x
+// brotli 10 for ~4% and zstd 19 costs ~2x zstd 15 for <1%
+// (crypto_bench compression).
+const int GZIP_LEVEL = 9;
+const int BROTLI_LEVEL = 10;
+const int ZSTD_LEVEL = 15;
+
+// Levels for bodies over LARGE_BODY_BYTES and for EncodedBody::encodeFast.
+// On /api/coins at 5000 coins (~17 MB) brotli 10 takes ~30s and brotli 5
+// ~1.3s for ~13% more bytes; gzip 4 is ~3x faster than 9 for ~1% more.
+const size_t LARGE_BODY_BYTES = 1 << 20;
+const int GZIP_FAST_LEVEL = 4;
+const int BROTLI_FAST_LEVEL = 5;
+const int ZSTD_FAST_LEVEL = 3;
+
+// Smaller per-request bodies fit one packet uncompressed
+const size_t REQUEST_GZIP_MIN_BYTES = 1400;
+
+string gzipCompress(string_view body, int level) {
+    z_stream zs = {};
+    // windowBits 15 + 16 selects the gzip wrapper
+    if(deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) return {};
+
+    string out;
+    out.resize(deflateBound(&zs, body.size()) + 32);
+    zs.next_in = (Bytef*)body.data();
+    zs.avail_in = (uInt)body.size();
+    zs.next_out = (Bytef*)out.data();
+    zs.avail_out = (uInt)out.size();
+
+    int rc = deflate(&zs, Z_FINISH);
+    out.resize(zs.total_out);
+    deflateEnd(&zs);
+    return rc == Z_STREAM_END ? out : string();
+}
+
+#ifdef CRYPTOLIZARD_HAVE_BROTLI
+string brotliCompress(string_view body, int level) {
+    string out;
+    size_t size = BrotliEncoderMaxCompressedSize(body.size());
+    out.resize(size ? size : body.size() + 1024);
+    if(!BrotliEncoderCompress(level, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                              body.size(), (const uint8_t*)body.data(), &size, (uint8_t*)out.data())) {
+        return {};
+    }
+    out.resize(size);
+    return out;
+}
+#endif
+
+#ifdef CRYPTOLIZARD_HAVE_ZSTD
+string zstdCompress(string_view body, int level) {
+    string out;
+    out.resize(ZSTD_compressBound(body.size()));
+    size_t size = ZSTD_compress(out.data(), out.size(), body.data(), body.size(), level);
+    if(ZSTD_isError(size)) return {};
+    out.resize(size);
+    return out;
+}
+#endif
+
+bool equalsIgnoreCase(string_view a, string_view b) {
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); i++) {
+        if(tolower((unsigned char)a[i]) != tolower((unsigned char)b[i])) return false;
+    }
+    return true;
+}
+
+string_view trim(string_view s) {
+    while(!s.empty() && isspace((unsigned char)s.front())) s.remove_prefix(1);
+    while(!s.empty() && isspace((unsigned char)s.back())) s.remove_suffix(1);
+    return s;
+}
+
+} // namespace
+
+const char* encodingName(Encoding encoding) {
+    switch(encoding) {
+        case Encoding::Gzip: return "gzip";
+        case Encoding::Brotli: return "br";
+        case Encoding::Zstd: return "zstd";
+        default: return "identity";
+    }
+}
+
+bool encodingAvailable(Encoding encoding) {
+    switch(encoding) {
+        case Encoding::Identity:
+        case Encoding::Gzip:
+            return true;
+#ifdef CRYPTOLIZARD_HAVE_BROTLI
+        case Encoding::Brotli:
+            return true;
+#endif
+#ifdef CRYPTOLIZARD_HAVE_ZSTD
+        case Encoding::Zstd:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+string compressBody(Encoding encoding, string_view body) {
+    bool large = body.size() > LARGE_BODY_BYTES;
+    switch(encoding) {
+        case Encoding::Gzip: return compressBody(encoding, body, large ? GZIP_FAST_LEVEL : GZIP_LEVEL);
+        case Encoding::Brotli: return compressBody(encoding, body, large ? BROTLI_FAST_LEVEL : BROTLI_LEVEL);
+        case Encoding::Zstd: return compressBody(encoding, body, large ? ZSTD_FAST_LEVEL : ZSTD_LEVEL);
+        default: return {};
+    }
+}
+
+string compressBody(Encoding encoding, string_view body, int level) {
+    switch(encoding) {
+        case Encoding::Gzip:
+            return gzipCompress(body, level);
+#ifdef CRYPTOLIZARD_HAVE_BROTLI
+        case Encoding::Brotli:
+            return brotliCompress(body, level);
+#endif
+#ifdef CRYPTOLIZARD_HAVE_ZSTD
+        case Encoding::Zstd:
+            return zstdCompress(body, level);
+#endif
+        default:
+            return {};
+    }
+}
+
+string gunzipBody(string_view body) {
+    z_stream zs = {};
+    if(inflateInit2(&zs, 15 + 16) != Z_OK) return {};
+
+    string out;
+    char buffer[16384];
+    zs.next_in = (Bytef*)body.data();
+    zs.avail_in = (uInt)body.size();
+    int rc;
+    do {
+        zs.next_out = (Bytef*)buffer;
+        zs.avail_out = sizeof(buffer);
+        rc = inflate(&zs, Z_NO_FLUSH);
+        out.append(buffer, sizeof(buffer) - zs.avail_out);
+    } while(rc == Z_OK);
+    inflateEnd(&zs);
+    return rc == Z_STREAM_END ? out : string();
+}
+
+Encoding negotiateEncoding(string_view acceptEncoding) {
+    // Preference order used to break q-value ties
+    static const Encoding preference[] = {Encoding::Brotli, Encoding::Zstd, Encoding::Gzip};
+
+    double q[ENCODING_COUNT] = {-1, -1, -1, -1}; // -1 = not mentioned
+    double wildcard = -1;
+
+    while(!acceptEncoding.empty()) {
+        size_t comma = acceptEncoding.find(',');
+        string_view item = trim(acceptEncoding.substr(0, comma));
+        acceptEncoding.remove_prefix(comma == string_view::npos ? acceptEncoding.size() : comma + 1);
+        if(item.empty()) continue;
+
+        double weight = 1.0;
+        size_t semi = item.find(';');
+        string_view token = trim(item.substr(0, semi));
+        if(semi != string_view::npos) {
+            string_view param = trim(item.substr(semi + 1));
+            if(param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                weight = strtod(string(param.substr(2)).c_str(), nullptr);
+            }
+        }
+
+        if(token == "*") {
+            wildcard = weight;
+            continue;
+        }
+        for(size_t e = 1; e < ENCODING_COUNT; e++) {
+            if(equalsIgnoreCase(token, encodingName((Encoding)e))) q[e] = weight;
+        }
+    }
+
+    Encoding best = Encoding::Identity;
+    double bestQ = 0;
+    for(Encoding e : preference) {
+        if(!encodingAvailable(e)) continue;
+        double weight = q[(size_t)e] >= 0 ? q[(size_t)e] : wildcard;
+        if(weight > bestQ) {
+            best = e;
+            bestQ = weight;
+        }
+    }
+    return best;
+}
+
+EncodedBody EncodedBody::encode(string body) {
+    EncodedBody encoded;
+    for(size_t e = 1; e < ENCODING_COUNT; e++) {
+        if(!encodingAvailable((Encoding)e)) continue;
+        string compressed = compressBody((Encoding)e, body);
+        if(!compressed.empty() && compressed.size() < body.size()) {
+            encoded.variants[e] = move(compressed);
+        }
+    }
+    encoded.variants[0] = move(body);
+    return encoded;
+}
+
+EncodedBody EncodedBody::encodeFast(string body) {
+    EncodedBody encoded;
+    string compressed = compressBody(Encoding::Gzip, body, GZIP_FAST_LEVEL);
+    if(!compressed.empty() && compressed.size() < body.size()) {
+        encoded.variants[(size_t)Encoding::Gzip] = move(compressed);
+    } else {
+        encoded.variants[0] = move(body);
+    }
+    return encoded;
+}
+
+EncodedBody EncodedBody::encodeForRequest(string body) {
+    if(body.size() > REQUEST_GZIP_MIN_BYTES) {
+        return encodeFast(move(body));
+    }
+    EncodedBody encoded;
+    encoded.variants[0] = move(body);
+    return encoded;
+}
+
+string EncodedBody::bytes(Encoding e) const {
+    if(e == Encoding::Identity && !has(Encoding::Identity)) {
+        return gunzipBody(get(Encoding::Gzip));
+    }
+    return get(e);
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Content codings the server can send. Identity is always available; the
+// others depend on which encoder libraries the build found.
+enum class Encoding : uint8_t {
+    Identity,
+    Gzip,
+    Brotli,
+    Zstd,
+};
+
+constexpr size_t ENCODING_COUNT = 4;
+
+// Content-Encoding token ("gzip", "br", "zstd"; "identity" for Identity)
+const char* encodingName(Encoding encoding);
+
+// Whether this build can produce `encoding`
+bool encodingAvailable(Encoding encoding);
+
+// Compress `body` at the level used for pre-compressed responses (slow,
+// high ratio - meant to run once per data version, not per request).
+// Bodies over 1 MB get faster levels so large universes stay cheap to render.
+// Returns an empty string if the encoder is unavailable or fails.
+std::string compressBody(Encoding encoding, std::string_view body);
+
+// Same, at an explicit encoder level (used by the benchmarks)
+std::string compressBody(Encoding encoding, std::string_view body, int level);
+
+// Inverse of gzip compression; empty on malformed input
+std::string gunzipBody(std::string_view body);
+
+// Pick the best available coding allowed by an Accept-Encoding header.
+// Honors q-values and "*"; ties prefer br, then zstd, then gzip. Falls back
+// to Identity.
+Encoding negotiateEncoding(std::string_view acceptEncoding);
+
+// One response body with every available pre-compressed variant.
+// Variants that are unavailable or not smaller than identity stay empty.
+struct EncodedBody {
+    std::array<std::string, ENCODING_COUNT> variants;
+
+    // Empty for an encodeFast() body that kept only its gzip bytes
+    const std::string& identity() const { return variants[0]; }
+    bool has(Encoding e) const { return !variants[static_cast<size_t>(e)].empty(); }
+    const std::string& get(Encoding e) const { return variants[static_cast<size_t>(e)]; }
+
+    // Copy of one variant, which must be stored or be Identity; identity is
+    // inflated from gzip when that is all encodeFast() kept
+    std::string bytes(Encoding e) const;
+
+    // Build all variants of `body`
+    static EncodedBody encode(std::string body);
+
+    // Gzip at a fast level only, for bodies rendered in bulk where full
+    // pre-compression would cost more than it saves. Identity is dropped
+    // when gzip is smaller, roughly halving what the body keeps resident.
+    static EncodedBody encodeFast(std::string body);
+
+    // Body built for one request: kept as is when it fits in about one
+    // packet, otherwise encodeFast()
+    static EncodedBody encodeForRequest(std::string body);
+};
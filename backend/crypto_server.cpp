@@ -2,137 +2,295 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_set>
 #include <thread>
 #include <chrono>
 #include <mutex>
+#include <atomic>
+#include <memory>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <climits>
+#include <cmath>
 #include <curl/curl.h>
 #include <nlohmann/json.hpp>
 #include "crow.h"
+#include "coin_query.h"
+#include "coingecko_json.h"
+#include "fetch_scheduler.h"
+#include "history_query.h"
+#include "http_cache.h"
+#include "job_scheduler.h"
+#include "market_snapshot.h"
+#include "metrics.h"
+#include "price_stream.h"
+#include "replica.h"
+#include "snapshot_store.h"
+#include "upstream_source.h"
+#include "wire_format.h"
 
 using json = nlohmann::json;
 using namespace std;
 
+// Read a positive integer setting from the environment
+int envInt(const char* name, int fallback) {
+    const char* value = getenv(name);
+    int parsed = value ? atoi(value) : 0;
+    return parsed > 0 ? parsed : fallback;
+}
+
 // Configuration
-const string API_KEY = "CG-MPDfjn4G4i6Ru79Lb3oNuiUA";
-const string BASE_URL = "https://api.coingecko.com/api/v3";
-const int RATE_LIMIT_MS = 2000; // 2 seconds between calls (30 per minute)
-const int UPDATE_INTERVAL = 5 * 60; // 5 minutes in seconds
-const int TOP_COINS_COUNT = 50;
-
-// Global data storage
-struct CoinData {
-    string id;
-    int rank;
-    string name;
-    string symbol;
-    string logo;
-    double price;
-    double change24h;
-    double marketCap;
-    double volume24h;
-    double circulatingSupply;
-    double totalSupply;
-    double maxSupply;
-    double ath;
-    double athChangePercentage;
-    string athDate;
-    vector<double> sparkline7d;
-    
-    // Historical data
-    map<string, vector<pair<long long, double>>> historicalData; // period -> [(timestamp, price)]
-};
+// Upstream API: live, record or replay; base URL and API key (see upstream_source.h)
+string upstreamConfigError;
+const UpstreamConfig UPSTREAM_CONFIG = UpstreamConfig::fromEnv(&upstreamConfigError);
+const int RATE_LIMIT_PER_MINUTE = envInt("RATE_LIMIT_PER_MINUTE", 30); // CoinGecko demo plan quota
+const int UPDATE_INTERVAL = TICK_SECONDS; // 5 minutes in seconds
+const int GLOBAL_REFRESH_SECONDS = 10 * 60;
+const int TRENDING_REFRESH_SECONDS = 15 * 60;
+const int MARKETS_PAGE_SIZE = 250; // most rows /coins/markets returns per call
 
-struct GlobalStats {
-    double totalMarketCap;
-    double totalVolume;
-    double btcDominance;
-    int activeCryptocurrencies;
-    double marketCapChange24h;
-    double volumeChange24h;
-};
+// Universe: coins tracked, by market-cap rank (override with TOP_COINS_COUNT)
+const int TOP_COINS_COUNT = envInt("TOP_COINS_COUNT", 50);
 
-struct TrendingCoin {
-    string id;
-    string name;
-    string symbol;
-    string logo;
-    int rank;
-};
+// History tiers by market-cap rank. Hot coins (HOT_COINS_COUNT) are loaded
+// before the server reports ready and then kept current by live ticks. Warm
+// coins (up to WARM_TIER_MAX_RANK) and cold coins (the rest) are loaded after
+// that, in rank order, and rebuilt from upstream once their history is older
+// than the tier's refresh interval. At 5000 coins that averages ~13 chart
+// calls/min, which fits next to the live price pages in the quota.
+enum class HistoryTier { Hot, Warm, Cold };
+const int HOT_COINS_COUNT = min(envInt("HOT_COINS_COUNT", 50), TOP_COINS_COUNT);
+const int WARM_TIER_MAX_RANK = 500;
+const long long WARM_REFRESH_MS = 6 * 3600 * 1000LL;
+const long long COLD_REFRESH_MS = 24 * 3600 * 1000LL;
 
-struct TrendingCategory {
-    string name;
-    string trend;
-};
+// Warm-start snapshot file, rewritten after every update (override with SNAPSHOT_PATH)
+const char* SNAPSHOT_PATH_ENV = getenv("SNAPSHOT_PATH");
+const string SNAPSHOT_PATH = SNAPSHOT_PATH_ENV ? SNAPSHOT_PATH_ENV : "cryptolizard.snapshot";
+
+// Coin descriptions for /api/search to index (override with COIN_INFO_PATH).
+// Without the file, search covers ids, names and symbols.
+const char* COIN_INFO_PATH_ENV = getenv("COIN_INFO_PATH");
+const string COIN_INFO_PATH = COIN_INFO_PATH_ENV ? COIN_INFO_PATH_ENV : "../frontend/coin-info.json";
+
+// Leader/follower replication on one host (see replica.h), from REPLICA_ROLE.
+// A leader fetches as usual and also writes every snapshot to REPLICA_PATH;
+// followers serve what that file holds and never call upstream. Standalone
+// (the default) does neither.
+enum class ReplicaRole { Standalone, Leader, Follower };
+
+ReplicaRole replicaRoleFromEnv(string* error) {
+    const char* value = getenv("REPLICA_ROLE");
+    string role = value ? value : "standalone";
+    if(role == "standalone") return ReplicaRole::Standalone;
+    if(role == "leader") return ReplicaRole::Leader;
+    if(role == "follower") return ReplicaRole::Follower;
+    *error = "Unknown REPLICA_ROLE '" + role + "'";
+    return ReplicaRole::Standalone;
+}
+
+string replicaRoleError;
+const ReplicaRole REPLICA_ROLE = replicaRoleFromEnv(&replicaRoleError);
+const char* REPLICA_PATH_ENV = getenv("REPLICA_PATH");
+const string REPLICA_PATH = REPLICA_PATH_ENV ? REPLICA_PATH_ENV : "/dev/shm/cryptolizard.replica";
+const int REPLICA_PUBLISH_MS = 1000; // leader: newest snapshot written at most this often
+const int REPLICA_POLL_MS = 100;     // follower: how often the file is checked for a new generation
+
+// Server readiness. Market data itself lives in the published MarketSnapshot.
+atomic<bool> dataReady{false};
+
+// Subscribers of the /api/stream websocket
+PriceStream priceStream;
+
+// When the next live update is due (unix seconds); drives Cache-Control max-age
+atomic<long long> nextUpdateAt{0};
+
+// When prices were last fetched and published (unix seconds), for /metrics
+atomic<long long> lastPriceUpdateAt{0};
+
+// Periodic refreshes (live prices, global stats, trending); stopping it also
+// ends the initial load, the history sweep and replication
+JobScheduler refreshJobs;
+
+// Replication state for /health and /metrics: the last generation written
+// (leader) or served (follower), and the leader's last heartbeat (follower)
+atomic<uint64_t> replicaGeneration{0};
+atomic<long long> leaderHeartbeatAt{0};
+
+long long unixNow() {
+    return chrono::duration_cast<chrono::seconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Metrics label of an upstream URL: its path with coin ids dropped
+// ("/coins/bitcoin/market_chart?..." -> "market_chart")
+string upstreamEndpoint(const string& url) {
+    string path = url.substr(0, url.find('?'));
+    const string& base = UPSTREAM_CONFIG.baseUrl;
+    if(path.compare(0, base.size(), base) == 0) path.erase(0, base.size());
+    if(path == "/coins/markets") return "markets";
+    if(path == "/global") return "global";
+    if(path == "/search/trending") return "trending";
+    if(path.size() > 13 && path.compare(path.size() - 13, 13, "/market_chart") == 0) return "market_chart";
+    return "other";
+}
+
+// Upstream requests go through one source. Live (and record) requests share
+// one scheduler: token bucket at the plan's quota, live prices ahead of
+// global/trending ahead of history backfill. Replay has no quota at all.
+// Created by main() before any thread starts (a follower has none) and
+// destroyed by it before curl_global_cleanup().
+unique_ptr<UpstreamSource> upstreamSource;
+
+UpstreamSource& upstream() {
+    return *upstreamSource;
+}
+
+void startUpstream() {
+    FetchSchedulerOptions options;
+    options.requestsPerMinute = RATE_LIMIT_PER_MINUTE;
+    options.endpointOf = upstreamEndpoint;
+    upstreamSource = makeUpstreamSource(UPSTREAM_CONFIG, move(options));
+}
 
-// Global storage with mutex for thread safety
-mutex dataMutex;
-vector<CoinData> topCoins;
-GlobalStats globalStats;
-vector<TrendingCoin> trendingCoins;
-vector<TrendingCategory> trendingCategories;
-bool dataReady = false;
+// Stop the HTTP client: fails whatever is still queued and frees the curl
+// handles while libcurl is still initialized
+void shutdownUpstream() {
+    upstreamSource.reset();
+}
 
-// Utility function for HTTP requests
-size_t WriteCallback(void* contents, size_t size, size_t nmemb, string* userp) {
-    userp->append((char*)contents, size * nmemb);
-    return size * nmemb;
+// Wall-clock length of a span of market time; replays may run it faster
+chrono::milliseconds marketTime(chrono::seconds span) {
+    return chrono::milliseconds((long long)(span.count() * 1000 / upstream().timeCompression()));
 }
 
-string makeAPIRequest(const string& endpoint) {
-    CURL* curl;
-    CURLcode res;
-    string response;
+// Wait for a request; false (already logged) if it failed
+bool awaitResponse(future<FetchResult> pending, string* body = nullptr) {
+    FetchResult result = pending.get();
     
-    curl = curl_easy_init();
-    if(curl) {
-        string url = BASE_URL + endpoint;
-        
-        // Add API key if needed
-        struct curl_slist* headers = NULL;
-        headers = curl_slist_append(headers, ("x-cg-demo-api-key: " + API_KEY).c_str());
-        
-        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
-        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &response);
-        curl_easy_setopt(curl, CURLOPT_TIMEOUT, 30L);
-        
-        res = curl_easy_perform(curl);
-        
-        if(res != CURLE_OK) {
-            cerr << "❌ CURL error: " << curl_easy_strerror(res) << endl;
+    if(!result.ok()) {
+        cerr << "❌ Upstream request failed after " << result.attempts << " attempt(s): "
+             << (result.error.empty() ? "HTTP " + to_string(result.status) : result.error) << endl;
+        return false;
+    }
+    
+    if(body) *body = move(result.body);
+    return true;
+}
+
+// Wait for a request whose body is decoded by `sink` as it arrives
+bool awaitStream(future<FetchResult> pending, JsonSink& sink) {
+    bool ok = awaitResponse(move(pending)) && sink.finish();
+    if(!sink.error().empty()) {
+        cerr << "❌ Malformed upstream response: " << sink.error() << endl;
+    }
+    return ok;
+}
+
+// Response body of a successful request; empty on failure (already logged)
+string makeAPIRequest(const string& endpoint, FetchPriority priority) {
+    string body;
+    awaitResponse(upstream().submit(priority, endpoint), &body);
+    return body;
+}
+
+// Market rows of the top `count` coins. /coins/markets returns at most
+// MARKETS_PAGE_SIZE rows per call, so every page is queued at once and decoded
+// straight off the wire as it arrives (no response string, no DOM). A failed
+// page (already logged) leaves a gap; false only when every page failed.
+// `complete` tells whether every page arrived.
+bool fetchMarkets(int count, vector<MarketQuote>& quotes, bool* complete = nullptr) {
+    int perPage = min(count, MARKETS_PAGE_SIZE);
+    int pages = (count + perPage - 1) / perPage;
+    
+    vector<shared_ptr<MarketsSink>> sinks(pages);
+    vector<future<FetchResult>> pending(pages);
+    for(int page = 0; page < pages; page++) {
+        string endpoint = "/coins/markets?vs_currency=usd&order=market_cap_desc&per_page=" + 
+                          to_string(perPage) + "&page=" + to_string(page + 1) + 
+                          "&sparkline=true&price_change_percentage=24h";
+        sinks[page] = make_shared<MarketsSink>();
+        pending[page] = upstream().submit(FetchPriority::Live, endpoint, sinks[page]);
+    }
+    
+    quotes.clear();
+    quotes.reserve(count);
+    int failed = 0;
+    for(int page = 0; page < pages; page++) {
+        if(!awaitStream(move(pending[page]), *sinks[page])) {
+            cerr << "❌ Failed to fetch markets page " << (page + 1) << "/" << pages << endl;
+            failed++;
+            continue;
+        }
+        for(MarketQuote& quote : sinks[page]->quotes()) {
+            quotes.push_back(move(quote));
         }
-        
-        curl_slist_free_all(headers);
-        curl_easy_cleanup(curl);
     }
     
-    return response;
+    if((int)quotes.size() > count) quotes.resize(count);
+    if(complete) *complete = failed == 0;
+    return failed < pages;
 }
 
-void rateLimitSleep() {
-    this_thread::sleep_for(chrono::milliseconds(RATE_LIMIT_MS));
+// Drop the coins missing from `quotes` - they left the top list, or the
+// universe was made smaller - keeping the others in order with their data and
+// history. Only for a complete list: a failed page would drop its coins too.
+// The index is rebuilt; orders, tables, search and the change log follow the
+// new list when it is published. Returns how many coins were dropped.
+size_t dropCoinsOutside(vector<CoinData>& coins, CoinIndex& index, const vector<MarketQuote>& quotes) {
+    unordered_set<string_view> listed;
+    listed.reserve(quotes.size());
+    for(const MarketQuote& quote : quotes) listed.insert(quote.id);
+    
+    auto kept = stable_partition(coins.begin(), coins.end(),
+                                 [&](const CoinData& coin) { return listed.count(coin.id) > 0; });
+    size_t dropped = coins.end() - kept;
+    if(dropped == 0) return 0;
+    coins.erase(kept, coins.end());
+    index.rebuild(coins);
+    return dropped;
+}
+
+// USD exchange rates behind ?vs=, fetched once per price refresh. False
+// (already logged) on failure; the published rates then stay as they are.
+bool fetchExchangeRates(map<string, double, less<>>& perUsd) {
+    string response = makeAPIRequest("/exchange_rates", FetchPriority::Live);
+    if(response.empty()) {
+        cerr << "❌ Failed to fetch exchange rates" << endl;
+        return false;
+    }
+    
+    string error;
+    if(!parseExchangeRates(response, perUsd, error)) {
+        cerr << "❌ Error parsing " << error << endl;
+        return false;
+    }
+    return true;
+}
+
+// Publish fetched rates into `next`, noting the version when they moved
+void applyExchangeRates(MarketSnapshot& next, map<string, double, less<>>& perUsd) {
+    if(perUsd.empty() || perUsd == next.fx.perUsd) return;
+    next.fx.perUsd = move(perUsd);
+    next.fx.changedAt = next.version;
 }
 
 // Fetch top coins with current data
 void fetchTopCoins() {
     cout << "📊 Fetching top " << TOP_COINS_COUNT << " coins..." << endl;
     
-    string endpoint = "/coins/markets?vs_currency=usd&order=market_cap_desc&per_page=" + 
-                      to_string(TOP_COINS_COUNT) + 
-                      "&page=1&sparkline=true&price_change_percentage=24h";
-    
-    string response = makeAPIRequest(endpoint);
-    
-    if(response.empty()) {
+    vector<MarketQuote> quotes;
+    bool complete = false;
+    if(!fetchMarkets(TOP_COINS_COUNT, quotes, &complete)) {
         cerr << "❌ Failed to fetch top coins" << endl;
         return;
     }
+    map<string, double, less<>> perUsd;
+    fetchExchangeRates(perUsd);
     
-    try {
-        json data = json::parse(response);
-        
-        lock_guard<mutex> lock(dataMutex);
+    updateSnapshot([&](MarketSnapshot& next) {
+        applyExchangeRates(next, perUsd);
+        vector<CoinData>& topCoins = next.coins;
         
         // If this is the first load, clear and populate
         bool isFirstLoad = topCoins.empty();
@@ -142,79 +300,39 @@ void fetchTopCoins() {
         }
         
         int count = 0;
-        for(const auto& coin : data) {
-            try {
-                CoinData c;
-                c.id = coin.value("id", "");
-                c.rank = coin.value("market_cap_rank", 0);
-                c.name = coin.value("name", "");
-                c.symbol = coin.value("symbol", "");
-                c.logo = coin.value("image", "");
-                c.price = coin.value("current_price", 0.0);
-                c.change24h = coin.value("price_change_percentage_24h", 0.0);
-                c.marketCap = coin.value("market_cap", 0.0);
-                c.volume24h = coin.value("total_volume", 0.0);
-                c.circulatingSupply = coin.value("circulating_supply", 0.0);
-                
-                // Handle null values for total_supply and max_supply
-                c.totalSupply = coin["total_supply"].is_null() ? 0.0 : coin["total_supply"].get<double>();
-                c.maxSupply = coin["max_supply"].is_null() ? 0.0 : coin["max_supply"].get<double>();
-                
-                c.ath = coin.value("ath", 0.0);
-                c.athChangePercentage = coin.value("ath_change_percentage", 0.0);
-                c.athDate = coin.value("ath_date", "");
-                
-                // Extract sparkline data (7 days)
-                if(coin.contains("sparkline_in_7d") && coin["sparkline_in_7d"].contains("price")) {
-                    c.sparkline7d = coin["sparkline_in_7d"]["price"].get<vector<double>>();
-                }
-                
-                if(isFirstLoad) {
-                    // First load - just add the coin
-                    topCoins.push_back(c);
-                } else {
-                    // Update - find existing coin and update its current data, preserve historical data
-                    bool found = false;
-                    for(auto& existingCoin : topCoins) {
-                        if(existingCoin.id == c.id) {
-                            // Update current data
-                            existingCoin.rank = c.rank;
-                            existingCoin.price = c.price;
-                            existingCoin.change24h = c.change24h;
-                            existingCoin.marketCap = c.marketCap;
-                            existingCoin.volume24h = c.volume24h;
-                            existingCoin.circulatingSupply = c.circulatingSupply;
-                            existingCoin.totalSupply = c.totalSupply;
-                            existingCoin.maxSupply = c.maxSupply;
-                            existingCoin.ath = c.ath;
-                            existingCoin.athChangePercentage = c.athChangePercentage;
-                            existingCoin.athDate = c.athDate;
-                            existingCoin.sparkline7d = c.sparkline7d;
-                            // Keep historicalData intact!
-                            found = true;
-                            break;
-                        }
-                    }
-                    
-                    // If coin not found (new coin in top 50), add it
-                    if(!found) {
-                        topCoins.push_back(c);
-                    }
-                }
-                
-                count++;
-                
-                if(isFirstLoad) {
-                    cout << "✅ [" << count << "/" << TOP_COINS_COUNT << "] " 
-                         << c.name << " (" << c.symbol << ")" << endl;
-                    cout << "    Price: $" << c.price << " | 24h: " 
-                         << (c.change24h >= 0 ? "+" : "") << c.change24h << "%" 
-                         << " | MCap: $" << (c.marketCap / 1e9) << "B" << endl;
-                }
-            } catch(const exception& e) {
-                cerr << "⚠️  Skipping coin due to error: " << e.what() << endl;
+        for(const MarketQuote& quote : quotes) {
+            if(quote.id.empty()) {
+                cerr << "⚠️  Skipping coin without an id" << endl;
                 continue;
             }
+            
+            size_t slot = next.index.findById(topCoins, quote.id);
+            
+            if(slot == CoinIndex::npos) {
+                // First load or new coin in the top list - just add the coin
+                CoinData c;
+                applyQuote(quote, c);
+                topCoins.push_back(move(c));
+                next.index.insert(topCoins, topCoins.size() - 1);
+            } else {
+                // Update - update the existing coin's current data, preserve historical data
+                applyQuote(quote, topCoins[slot]);
+            }
+            
+            count++;
+            
+            if(isFirstLoad && count <= HOT_COINS_COUNT) {
+                cout << "✅ [" << count << "/" << TOP_COINS_COUNT << "] " 
+                     << quote.name << " (" << quote.symbol << ")" << endl;
+                cout << "    Price: $" << quote.price << " | 24h: " 
+                     << (quote.change24h >= 0 ? "+" : "") << quote.change24h << "%" 
+                     << " | MCap: $" << (quote.marketCap / 1e9) << "B" << endl;
+            }
+        }
+        
+        if(complete) {
+            size_t dropped = dropCoinsOutside(topCoins, next.index, quotes);
+            if(dropped > 0) cout << "➖ Dropped " << dropped << " coin(s) that left the top " << TOP_COINS_COUNT << endl;
         }
         
         if(!isFirstLoad) {
@@ -222,122 +340,62 @@ void fetchTopCoins() {
         } else {
             cout << "✅ Fetched " << topCoins.size() << " coins successfully" << endl;
         }
-
-        
-    } catch(const exception& e) {
-        cerr << "❌ Error parsing coin data: " << e.what() << endl;
-    }
+    });
+    lastPriceUpdateAt = unixNow();
 }
 
-// Fetch historical data for a coin
-void fetchHistoricalData(CoinData& coin) {
+// Fetch historical data for the given periods of a coin. One market_chart
+// call per chart source covers several periods; every period those sources
+// feed is rebuilt, and the rebuilt periods are returned.
+vector<Period> fetchHistoricalData(CoinData& coin, const vector<Period>& periods) {
     cout << "📥 Fetching historical data for " << coin.name << "..." << endl;
     
-    // Map of period to days parameter
-    map<string, int> periods = {
-        {"24h", 1},
-        {"7d", 7},
-        {"2w", 14},
-        {"1m", 30},
-        {"3m", 90},
-        {"6m", 180},
-        {"1y", 365}
-    };
+    bool needed[CHART_SOURCE_COUNT] = {};
+    for(Period p : periods) {
+        needed[periodSpec(p).source] = true;
+    }
     
-    for(const auto& [period, days] : periods) {
-        string endpoint = "/coins/" + coin.id + "/market_chart?vs_currency=usd&days=" + to_string(days);
-        string response = makeAPIRequest(endpoint);
+    // Queue every source at once; the scheduler paces them against the quota.
+    // Each response is decoded by its own sink as it arrives.
+    shared_ptr<MarketChartSink> charts[CHART_SOURCE_COUNT];
+    future<FetchResult> pending[CHART_SOURCE_COUNT];
+    for(size_t s = 0; s < CHART_SOURCE_COUNT; s++) {
+        if(!needed[s]) continue;
+        string endpoint = "/coins/" + coin.id + "/market_chart?vs_currency=usd&days=" + to_string(CHART_SOURCE_DAYS[s]);
+        charts[s] = make_shared<MarketChartSink>();
+        pending[s] = upstream().submit(FetchPriority::Backfill, endpoint, charts[s]);
+    }
+    
+    vector<Period> refreshed;
+    for(size_t s = 0; s < CHART_SOURCE_COUNT; s++) {
+        if(!needed[s]) continue;
         
-        if(response.empty()) {
-            cerr << "❌ Failed to fetch " << period << " data for " << coin.name << endl;
-            rateLimitSleep();
+        if(!awaitStream(move(pending[s]), *charts[s])) {
+            cerr << "❌ Failed to fetch " << CHART_SOURCE_DAYS[s] << "-day chart for " << coin.name << endl;
             continue;
         }
         
-        try {
-            json data = json::parse(response);
+        // Cut every period this source feeds into its own time buckets (see PERIODS)
+        for(const auto& spec : PERIODS) {
+            if(spec.source != s) continue;
             
-            if(data.contains("prices")) {
-                vector<pair<long long, double>> priceData;
-                
-                for(const auto& pricePoint : data["prices"]) {
-                    long long timestamp = pricePoint[0].get<long long>();
-                    double price = pricePoint[1].get<double>();
-                    priceData.push_back({timestamp, price});
-                }
-                
-                // Resample data to match required intervals
-                vector<pair<long long, double>> resampledData;
-                
-                if(period == "24h") {
-                    // 288 points (5-minute intervals)
-                    int step = max(1, (int)(priceData.size() / 288));
-                    for(size_t i = 0; i < priceData.size(); i += step) {
-                        if(resampledData.size() >= 288) break;
-                        resampledData.push_back(priceData[i]);
-                    }
-                } else if(period == "7d") {
-                    // 168 hourly points
-                    int step = max(1, (int)(priceData.size() / 168));
-                    for(size_t i = 0; i < priceData.size(); i += step) {
-                        if(resampledData.size() >= 168) break;
-                        resampledData.push_back(priceData[i]);
-                    }
-                } else if(period == "2w") {
-                    // 84 points (4-hour intervals)
-                    int step = max(1, (int)(priceData.size() / 84));
-                    for(size_t i = 0; i < priceData.size(); i += step) {
-                        if(resampledData.size() >= 84) break;
-                        resampledData.push_back(priceData[i]);
-                    }
-                } else if(period == "1m") {
-                    // 30 daily points
-                    int step = max(1, (int)(priceData.size() / 30));
-                    for(size_t i = 0; i < priceData.size(); i += step) {
-                        if(resampledData.size() >= 30) break;
-                        resampledData.push_back(priceData[i]);
-                    }
-                } else if(period == "3m") {
-                    // 90 daily points
-                    int step = max(1, (int)(priceData.size() / 90));
-                    for(size_t i = 0; i < priceData.size(); i += step) {
-                        if(resampledData.size() >= 90) break;
-                        resampledData.push_back(priceData[i]);
-                    }
-                } else if(period == "6m") {
-                    // 180 daily points
-                    int step = max(1, (int)(priceData.size() / 180));
-                    for(size_t i = 0; i < priceData.size(); i += step) {
-                        if(resampledData.size() >= 180) break;
-                        resampledData.push_back(priceData[i]);
-                    }
-                } else if(period == "1y") {
-                    // 52 weekly points
-                    int step = max(1, (int)(priceData.size() / 52));
-                    for(size_t i = 0; i < priceData.size(); i += step) {
-                        if(resampledData.size() >= 52) break;
-                        resampledData.push_back(priceData[i]);
-                    }
-                }
-                
-                coin.historicalData[period] = resampledData;
-                
-                cout << "    ✅ " << period << ": " << resampledData.size() << " points" << endl;
-            }
+            vector<pair<long long, double>> bucketed =
+                downsampleLTTB(charts[s]->prices(), periodIntervalMs(spec), spec.capacity);
+            coin.historicalData.mutate().assign(spec.period, bucketed);
+            refreshed.push_back(spec.period);
             
-        } catch(const exception& e) {
-            cerr << "❌ Error parsing historical data: " << e.what() << endl;
+            cout << "    ✅ " << spec.key << ": " << bucketed.size() << " points" << endl;
         }
-        
-        rateLimitSleep(); // Rate limiting
     }
+    
+    return refreshed;
 }
 
 // Fetch global market stats
 void fetchGlobalStats() {
     cout << "🌍 Fetching global market stats..." << endl;
     
-    string response = makeAPIRequest("/global");
+    string response = makeAPIRequest("/global", FetchPriority::Market);
     
     if(response.empty()) {
         cerr << "❌ Failed to fetch global stats" << endl;
@@ -350,13 +408,17 @@ void fetchGlobalStats() {
         if(data.contains("data")) {
             json stats = data["data"];
             
-            lock_guard<mutex> lock(dataMutex);
+            GlobalStats globalStats = {};
             globalStats.totalMarketCap = stats["total_market_cap"]["usd"].get<double>();
             globalStats.totalVolume = stats["total_volume"]["usd"].get<double>();
             globalStats.btcDominance = stats.value("market_cap_percentage", json::object()).value("btc", 0.0);
             globalStats.activeCryptocurrencies = stats.value("active_cryptocurrencies", 0);
             globalStats.marketCapChange24h = stats.value("market_cap_change_percentage_24h_usd", 0.0);
             
+            updateSnapshot([&](MarketSnapshot& next) {
+                next.globalStats = globalStats;
+            });
+            
             cout << "✅ Global stats updated" << endl;
             cout << "    Total Market Cap: $" << (globalStats.totalMarketCap / 1e12) << "T" << endl;
             cout << "    24h Volume: $" << (globalStats.totalVolume / 1e9) << "B" << endl;
@@ -372,7 +434,7 @@ void fetchGlobalStats() {
 void fetchTrendingCoins() {
     cout << "🔥 Fetching trending coins..." << endl;
     
-    string response = makeAPIRequest("/search/trending");
+    string response = makeAPIRequest("/search/trending", FetchPriority::Market);
     
     if(response.empty()) {
         cerr << "❌ Failed to fetch trending data" << endl;
@@ -382,9 +444,8 @@ void fetchTrendingCoins() {
     try {
         json data = json::parse(response);
         
-        lock_guard<mutex> lock(dataMutex);
-        trendingCoins.clear();
-        trendingCategories.clear();
+        vector<TrendingCoin> trendingCoins;
+        vector<TrendingCategory> trendingCategories;
         
         // Extract trending coins
         if(data.contains("coins")) {
@@ -411,7 +472,7 @@ void fetchTrendingCoins() {
             for(const auto& cat : data["categories"]) {
                 TrendingCategory tc;
                 tc.name = cat.value("name", "");
-                tc.trend = (i < trends.size()) ? trends[i] : "📊 Trending";
+                tc.trend = (i < (int)trends.size()) ? trends[i] : "📊 Trending";
                 trendingCategories.push_back(tc);
                 i++;
                 if(i >= 5) break; // Top 5 categories
@@ -419,272 +480,737 @@ void fetchTrendingCoins() {
             cout << "✅ Fetched " << trendingCategories.size() << " trending categories" << endl;
         }
         
+        updateSnapshot([&](MarketSnapshot& next) {
+            next.trendingCoins = move(trendingCoins);
+            next.trendingCategories = move(trendingCategories);
+        });
+        
     } catch(const exception& e) {
         cerr << "❌ Error parsing trending data: " << e.what() << endl;
     }
 }
 
+HistoryTier historyTier(const CoinData& coin) {
+    if(coin.rank <= 0) return HistoryTier::Cold;
+    if(coin.rank <= HOT_COINS_COUNT) return HistoryTier::Hot;
+    return coin.rank <= WARM_TIER_MAX_RANK ? HistoryTier::Warm : HistoryTier::Cold;
+}
+
+// Periods of a coin to refetch now. Hot coins refetch periods that are
+// missing or too old to extend with live ticks; warm and cold coins refetch
+// everything once their tier's refresh interval has passed.
+vector<Period> duePeriods(const CoinData& coin, long long nowMs) {
+    const SharedHistory& history = coin.historicalData;
+    HistoryTier tier = historyTier(coin);
+    
+    bool expired = false;
+    if(tier != HistoryTier::Hot) {
+        long long refreshMs = tier == HistoryTier::Warm ? WARM_REFRESH_MS : COLD_REFRESH_MS;
+        expired = history.size(Period::H24) == 0 || nowMs - history.back(Period::H24).first > refreshMs;
+    }
+    
+    vector<Period> due;
+    for(const auto& spec : PERIODS) {
+        bool stale = tier == HistoryTier::Hot ? history.isStale(spec.period, nowMs)
+                                              : expired || !history.has(spec.period);
+        if(stale) due.push_back(spec.period);
+    }
+    return due;
+}
+
+// Refetch `periods` of a coin and publish them
+void backfillHistory(const CoinData& coin, const vector<Period>& periods) {
+    // Fetch historical data into a private copy, off the published snapshot
+    CoinData tempCoin = coin;
+    vector<Period> refreshed = fetchHistoricalData(tempCoin, periods);
+    if(refreshed.empty()) return;
+    
+    // Publish only the rebuilt periods, keeping any live points appended meanwhile
+    updateSnapshot([&](MarketSnapshot& next) {
+        size_t slot = next.index.findById(next.coins, tempCoin.id);
+        if(slot != CoinIndex::npos) {
+            CoinHistory& history = next.coins[slot].historicalData.mutate();
+            for(Period p : refreshed) {
+                history.copyPeriod(tempCoin.historicalData.get(), p);
+            }
+        }
+    });
+}
+
+// Unix seconds of a scheduler time point
+long long unixSeconds(JobScheduler::Clock::time_point t) {
+    return chrono::duration_cast<chrono::seconds>(t.time_since_epoch()).count();
+}
+
+// Data can be served: report ready and start the periodic refreshes (once)
+void markReady() {
+    dataReady = true;
+    refreshJobs.start();
+    nextUpdateAt = unixSeconds(refreshJobs.nextRun("prices"));
+}
+
+// Publish the market data saved by a previous run so requests can be served
+// right away. Returns false when there is no usable snapshot file.
+bool loadWarmStart() {
+    auto start = chrono::steady_clock::now();
+    
+    MarketSnapshot saved;
+    SnapshotFileInfo info;
+    if(!loadSnapshotFile(SNAPSHOT_PATH, saved, &info) || saved.coins.empty()) {
+        return false;
+    }
+    
+    // Saved by a run that tracked more coins: keep the best-ranked
+    // TOP_COINS_COUNT. The first top-list fetch settles the exact set.
+    if(saved.coins.size() > (size_t)TOP_COINS_COUNT) {
+        auto rankKey = [](const CoinData& coin) { return coin.rank > 0 ? coin.rank : INT_MAX; };
+        stable_sort(saved.coins.begin(), saved.coins.end(),
+                    [&](const CoinData& a, const CoinData& b) { return rankKey(a) < rankKey(b); });
+        cout << "➖ Warm start: keeping the top " << TOP_COINS_COUNT << " of " << saved.coins.size()
+             << " saved coins" << endl;
+        saved.coins.resize(TOP_COINS_COUNT);
+    }
+    
+    updateSnapshot([&](MarketSnapshot& next) {
+        next.coins = move(saved.coins);
+        next.globalStats = saved.globalStats;
+        next.trendingCoins = move(saved.trendingCoins);
+        next.trendingCategories = move(saved.trendingCategories);
+        next.fx = move(saved.fx);
+    });
+    markReady();
+    
+    auto elapsed = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+    cout << "⚡ Warm start: loaded " << info.coinCount << " coins from " << SNAPSHOT_PATH
+         << " (" << (info.fileSize / 1024) << " KB, saved " << (unixNow() - info.savedAt) << "s ago) in "
+         << elapsed << "ms" << endl;
+    return true;
+}
+
+// Write the current snapshot for the next warm start. The initial load and
+// the refresh jobs both save, possibly at once; one at a time, each taking the
+// snapshot under the lock, so they never share the temp file and an older
+// snapshot never replaces a newer one.
+void saveWarmStart() {
+    static mutex saveMutex;
+    lock_guard<mutex> lock(saveMutex);
+    if(saveSnapshotFile(*currentSnapshot(), SNAPSHOT_PATH)) {
+        cout << "💾 Snapshot saved to " << SNAPSHOT_PATH << endl;
+    }
+}
+
+// Hand the frontend's coin descriptions to the search index
+void loadCoinNotes() {
+    ifstream in(COIN_INFO_PATH, ios::binary);
+    if(!in) {
+        cout << "🔎 No coin info at " << COIN_INFO_PATH << ", search covers names and symbols only" << endl;
+        return;
+    }
+    stringstream body;
+    body << in.rdbuf();
+    
+    auto notes = make_shared<CoinNotes>();
+    string error;
+    if(!parseCoinNotes(body.str(), *notes, error)) {
+        cerr << "⚠️  " << COIN_INFO_PATH << ": " << error << endl;
+        return;
+    }
+    cout << "🔎 Search indexes the descriptions of " << notes->size() << " coins" << endl;
+    setSearchNotes(move(notes));
+}
+
 // Initial data load on startup
 void initializeData() {
     cout << "\n🦎 CryptoLizard Server Starting..." << endl;
     cout << "═══════════════════════════════════════════════════════════\n" << endl;
     
-    // Phase 1: Fetch top coins list
+    // Phase 0: Serve the previous run's data immediately when it was saved
+    bool warmStart = loadWarmStart();
+    
+    // Phase 1: Fetch top coins list (refreshes prices of a warm snapshot)
     cout << "📊 Phase 1: Fetching top " << TOP_COINS_COUNT << " coins..." << endl;
     fetchTopCoins();
-    rateLimitSleep();
     
-    // Phase 2: Fetch historical data for all coins
-    cout << "\n📈 Phase 2: Loading historical data..." << endl;
-    cout << "This will take approximately 10 minutes (rate limiting to 30 calls/min)...\n" << endl;
+    // Phase 2: Fetch historical data for the hot set. After a warm start only
+    // the chart sources behind periods that went stale while the server was
+    // down are refetched. The other tiers are left to historySweepLoop().
+    SnapshotPtr initial = currentSnapshot();
+    long long nowMs = unixNow() * 1000;
     
-    int count = 0;
-    int totalCoins;
-    {
-        lock_guard<mutex> lock(dataMutex);
-        totalCoins = topCoins.size();
+    vector<vector<Period>> pending(initial->coins.size());
+    size_t totalCalls = 0;
+    for(size_t i = 0; i < initial->coins.size(); i++) {
+        if(historyTier(initial->coins[i]) != HistoryTier::Hot) continue;
+        pending[i] = duePeriods(initial->coins[i], nowMs);
+        totalCalls += chartCallsFor(pending[i]);
     }
     
+    cout << "\n📈 Phase 2: Loading historical data for the top " << HOT_COINS_COUNT << " coins..." << endl;
+    if(upstream().scheduler()) {
+        cout << totalCalls << " chart requests needed, about " << (totalCalls / RATE_LIMIT_PER_MINUTE + 1)
+             << " minute(s) (rate limiting to " << RATE_LIMIT_PER_MINUTE << " calls/min)...\n" << endl;
+    } else {
+        cout << totalCalls << " chart requests needed, replayed from " << UPSTREAM_CONFIG.recordDir
+             << " (no rate limit)...\n" << endl;
+    }
+    
+    int count = 0;
+    int totalCoins = initial->coins.size();
+    
     for(int i = 0; i < totalCoins; i++) {
+        if(refreshJobs.stopping()) return;
         count++;
-        string coinName;
-        {
-            lock_guard<mutex> lock(dataMutex);
-            coinName = topCoins[i].name;
-        }
-        cout << "[" << count << "/" << totalCoins << "] " << coinName << "..." << endl;
-        
-        // Fetch historical data without holding the lock
-        CoinData tempCoin;
-        {
-            lock_guard<mutex> lock(dataMutex);
-            tempCoin = topCoins[i];
-        }
-        
-        fetchHistoricalData(tempCoin);
-        
-        // Update the coin with historical data
-        {
-            lock_guard<mutex> lock(dataMutex);
-            topCoins[i].historicalData = tempCoin.historicalData;
-        }
+        if(pending[i].empty()) continue;
+        cout << "[" << count << "/" << totalCoins << "] " << initial->coins[i].name << "..." << endl;
+        backfillHistory(initial->coins[i], pending[i]);
     }
     
-    cout << "\n✅ Historical data loaded for all " << TOP_COINS_COUNT << " coins" << endl;
+    cout << "\n✅ Historical data loaded for the top " << HOT_COINS_COUNT << " coins" << endl;
     
     // Phase 3: Fetch trending data
     cout << "\n🔥 Phase 3: Fetching trending coins..." << endl;
     fetchTrendingCoins();
-    rateLimitSleep();
     
     // Phase 4: Fetch global stats
     cout << "\n🌍 Phase 4: Fetching global market stats..." << endl;
     fetchGlobalStats();
     
+    saveWarmStart();
+    
     cout << "\n═══════════════════════════════════════════════════════════" << endl;
-    cout << "✅ All data loaded successfully!" << endl;
+    cout << "✅ All data loaded successfully!" << (warmStart ? " (warm start)" : "") << endl;
     cout << "🚀 Server is ready to serve requests" << endl;
     cout << "🔄 Live updates will occur every 5 minutes\n" << endl;
     
-    dataReady = true;
+    markReady();
 }
 
-// Update just the current prices/volumes without touching coin structure
+// Load and refresh the history of every tier, one coin at a time in rank
+// order. Calls go out at backfill priority, so they only use quota left over
+// by live prices and global/trending. Also picks up hot coins whose history
+// went stale, e.g. after climbing into the hot set.
+void historySweepLoop() {
+    while(!refreshJobs.stopping()) {
+        SnapshotPtr snapshot = currentSnapshot();
+        
+        vector<size_t> order(snapshot->coins.size());
+        for(size_t i = 0; i < order.size(); i++) order[i] = i;
+        auto rankKey = [&](size_t i) {
+            int rank = snapshot->coins[i].rank;
+            return rank > 0 ? rank : INT_MAX;
+        };
+        stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return rankKey(a) < rankKey(b); });
+        
+        int refreshed = 0;
+        for(size_t i : order) {
+            const CoinData& coin = snapshot->coins[i];
+            if(refreshJobs.stopping()) return;
+            vector<Period> due = duePeriods(coin, unixNow() * 1000);
+            if(due.empty()) continue;
+            
+            backfillHistory(coin, due);
+            refreshed++;
+        }
+        
+        if(refreshed > 0) {
+            cout << "📚 History sweep refreshed " << refreshed << " coin(s)" << endl;
+        } else {
+            refreshJobs.sleepFor(marketTime(chrono::seconds(60)));
+        }
+    }
+}
+
+// Update the current prices/volumes. Coins entering the top list are added
+// (their history is loaded by historySweepLoop()) and coins leaving it dropped.
 void updateCurrentPrices() {
     cout << "📊 Updating current prices..." << endl;
     
-    string endpoint = "/coins/markets?vs_currency=usd&order=market_cap_desc&per_page=" + 
-                      to_string(TOP_COINS_COUNT) + 
-                      "&page=1&sparkline=true&price_change_percentage=24h";
-    
-    string response = makeAPIRequest(endpoint);
-    
-    if(response.empty()) {
+    vector<MarketQuote> quotes;
+    bool complete = false;
+    if(!fetchMarkets(TOP_COINS_COUNT, quotes, &complete)) {
         cerr << "❌ Failed to fetch price updates" << endl;
         return;
     }
+    map<string, double, less<>> perUsd;
+    fetchExchangeRates(perUsd);
     
-    try {
-        json data = json::parse(response);
-        lock_guard<mutex> lock(dataMutex);
+    updateSnapshot([&](MarketSnapshot& next) {
+        applyExchangeRates(next, perUsd);
+        vector<CoinData>& topCoins = next.coins;
         
         // Update each coin's current data
-        for(const auto& apiCoin : data) {
-            string coinId = apiCoin.value("id", "");
-            
+        for(MarketQuote& quote : quotes) {
             // Find this coin in our topCoins array
-            for(auto& ourCoin : topCoins) {
-                if(ourCoin.id == coinId) {
-                    // Update ONLY current data, leave historicalData untouched
-                    ourCoin.price = apiCoin.value("current_price", ourCoin.price);
-                    ourCoin.change24h = apiCoin.value("price_change_percentage_24h", ourCoin.change24h);
-                    ourCoin.marketCap = apiCoin.value("market_cap", ourCoin.marketCap);
-                    ourCoin.volume24h = apiCoin.value("total_volume", ourCoin.volume24h);
-                    ourCoin.rank = apiCoin.value("market_cap_rank", ourCoin.rank);
-                    
-                    if(apiCoin.contains("sparkline_in_7d") && apiCoin["sparkline_in_7d"].contains("price")) {
-                        ourCoin.sparkline7d = apiCoin["sparkline_in_7d"]["price"].get<vector<double>>();
-                    }
-                    break;
-                }
+            size_t slot = next.index.findById(topCoins, quote.id);
+            if(slot == CoinIndex::npos) {
+                if(quote.id.empty()) continue;
+                CoinData coin;
+                applyQuote(quote, coin);
+                topCoins.push_back(move(coin));
+                next.index.insert(topCoins, topCoins.size() - 1);
+                continue;
             }
+            
+            // Update ONLY current data, leave historicalData untouched.
+            // Fields missing (or null) upstream keep their previous value.
+            CoinData& ourCoin = topCoins[slot];
+            if(quote.has(FIELD_PRICE)) ourCoin.price = quote.price;
+            if(quote.has(FIELD_CHANGE_24H)) ourCoin.change24h = quote.change24h;
+            if(quote.has(FIELD_MARKET_CAP)) ourCoin.marketCap = quote.marketCap;
+            if(quote.has(FIELD_VOLUME_24H)) ourCoin.volume24h = quote.volume24h;
+            if(quote.has(FIELD_RANK)) ourCoin.rank = quote.rank;
+            if(quote.has(FIELD_SPARKLINE)) ourCoin.sparkline7d = move(quote.sparkline7d);
         }
-        
-        cout << "✅ Prices updated" << endl;
-        
-    } catch(const exception& e) {
-        cerr << "❌ Error updating prices: " << e.what() << endl;
-    }
+        if(complete) dropCoinsOutside(topCoins, next.index, quotes);
+    });
+    
+    lastPriceUpdateAt = unixNow();
+    cout << "✅ Prices updated" << endl;
 }
 
-// Update live data every 5 minutes
-void updateLiveData() {
-    // Static counters for different update intervals
-    static int updateCounter = 0;
+// Live update, every 5 minutes on the 5-minute boundary: current prices for
+// every coin, then a chart point for each period whose own boundary this tick
+// crossed (24h every tick, 7d hourly, 2w every 4 hours, 1m/3m/6m daily, 1y
+// weekly). A boundary inside skipped ticks still gets its point, just late.
+void runLiveTick(const JobTick& tick) {
+    cout << "\n🔄 [" << unixSeconds(tick.deadline) << "] 5-minute update starting..." << endl;
+    if(tick.skipped > 0) {
+        cout << "⚠️  " << tick.skipped << " tick(s) skipped, the previous update overran" << endl;
+    }
     
-    while(true) {
-        this_thread::sleep_for(chrono::seconds(UPDATE_INTERVAL));
-        
-        cout << "\n🔄 [" << chrono::system_clock::to_time_t(chrono::system_clock::now()) 
-             << "] 5-minute update starting..." << endl;
-        
-        // Increment update counter
-        updateCounter++;
-        
-        // Get current timestamp
-        long long currentTime = chrono::duration_cast<chrono::milliseconds>(
-            chrono::system_clock::now().time_since_epoch()
-        ).count();
+    // Points go on the boundary, so every coin's series shares timestamps
+    long long currentTime = chrono::duration_cast<chrono::milliseconds>(tick.deadline.time_since_epoch()).count();
+    
+    // Update prices WITHOUT touching the coin structure
+    SnapshotPtr before = currentSnapshot();
+    updateCurrentPrices();
+    
+    // Update historical chart data with new price points (rolling window).
+    // Built on a private copy and published in one swap - readers keep
+    // serving the previous snapshot meanwhile.
+    uint64_t previousTick = tick.index - tick.skipped - 1;
+    SnapshotPtr after = updateSnapshot([&](MarketSnapshot& next) {
+        vector<CoinData>& topCoins = next.coins;
         
-        // Update prices WITHOUT touching the coin structure
-        updateCurrentPrices();
+        int coinsWithData = 0;
+        for(auto& coin : topCoins) {
+            if(coin.historicalData.has(Period::H24)) coinsWithData++;
+        }
+        cout << "📊 Coins with historical data: " << coinsWithData << "/" << topCoins.size() << endl;
         
-        // Update historical chart data with new price points (rolling window)
-        {
-            lock_guard<mutex> lock(dataMutex);
+        for(auto& coin : topCoins) {
+            // Only the hot set is extended tick by tick; the other tiers
+            // are rebuilt on their own schedule by historySweepLoop()
+            if(historyTier(coin) != HistoryTier::Hot) continue;
             
-            int coinsWithData = 0;
-            for(auto& coin : topCoins) {
-                if(coin.historicalData.count("24h") > 0) coinsWithData++;
+            for(const auto& spec : PERIODS) {
+                bool due = tick.index / spec.tickDivisor != previousTick / spec.tickDivisor;
+                if(due && coin.historicalData.has(spec.period)) {
+                    coin.historicalData.mutate().append(spec.period, currentTime, coin.price);
+                }
+            }
+        }
+    });
+    
+    // Push the price/rank/24h deltas to stream subscribers only now: a
+    // client reacting to the frame by refetching a chart gets the new point
+    priceStream.publishTick(*before, *after);
+    
+    saveWarmStart();
+    
+    nextUpdateAt = unixSeconds(tick.deadline + marketTime(chrono::seconds(UPDATE_INTERVAL)));
+    cout << "✅ Live update complete (charts updated with new data points)" << endl;
+}
+
+// Leader: write the newest snapshot to the replica file, at most once per
+// REPLICA_PUBLISH_MS, off the publish path. In between, the heartbeat tells
+// followers the leader is still alive.
+void replicaLeaderLoop(uint64_t leaderId) {
+    ReplicaWriter writer(REPLICA_PATH, leaderId);
+    if(!writer.ok()) {
+        cerr << "❌ Replication disabled, followers will not get data" << endl;
+        return;
+    }
+    cout << "📡 Replica leader: writing snapshots to " << REPLICA_PATH << endl;
+    
+    unsigned long long written = 0;
+    while(!refreshJobs.stopping()) {
+        SnapshotPtr snapshot = currentSnapshot();
+        if(dataReady && snapshot->version != written) {
+            ReplicaClock clock;
+            clock.nextUpdateAt = nextUpdateAt;
+            clock.pricesAt = lastPriceUpdateAt;
+            if(writer.publish(*snapshot, clock)) {
+                written = snapshot->version;
+                replicaGeneration = writer.generation();
+            }
+        } else {
+            writer.beat();
+        }
+        refreshJobs.sleepFor(chrono::milliseconds(REPLICA_PUBLISH_MS));
+    }
+}
+
+// Follower: publish every generation the leader writes, under the leader's
+// version, so ETags and since= tokens are the same on every replica. Coins
+// whose history didn't change keep their rendered bodies. Nothing is fetched;
+// the leader's schedule drives Cache-Control.
+void replicaFollowerLoop() {
+    ReplicaReader reader(REPLICA_PATH);
+    cout << "📡 Replica follower: waiting for a leader at " << REPLICA_PATH << endl;
+    
+    ReplicaGeneration generation;
+    uint64_t leaderId = 0;
+    while(!refreshJobs.stopping()) {
+        if(reader.poll(generation) == ReplicaReader::Result::Updated) {
+            // Tags follow the leader, including one that restarted and
+            // replaced the file; set before its first version is served
+            if(generation.leaderId != leaderId) {
+                setETagOrigin(generation.leaderId);
+                leaderId = generation.leaderId;
             }
-            cout << "📊 Coins with historical data: " << coinsWithData << "/" << topCoins.size() << endl;
             
-            for(auto& coin : topCoins) {
-                // Add new data point to each chart period
-                
-                // 24h chart: 288 points (5-minute intervals) - update every time
-                if(coin.historicalData.count("24h")) {
-                    auto& data24h = coin.historicalData["24h"];
-                    data24h.push_back({currentTime, coin.price});
-                    // Keep only last 288 points (24 hours at 5-min intervals)
-                    if(data24h.size() > 288) {
-                        data24h.erase(data24h.begin());
-                    }
-                }
-                
-                // 7d chart: 168 points (hourly) - update every 12 updates (1 hour)
-                if(updateCounter % 12 == 0) {
-                    if(coin.historicalData.count("7d")) {
-                        auto& data7d = coin.historicalData["7d"];
-                        data7d.push_back({currentTime, coin.price});
-                        if(data7d.size() > 168) {
-                            data7d.erase(data7d.begin());
-                        }
-                    }
-                }
-                
-                // 2w chart: 84 points (4-hour intervals) - update every 48 updates (4 hours)
-                if(updateCounter % 48 == 0) {
-                    if(coin.historicalData.count("2w")) {
-                        auto& data2w = coin.historicalData["2w"];
-                        data2w.push_back({currentTime, coin.price});
-                        if(data2w.size() > 84) {
-                            data2w.erase(data2w.begin());
-                        }
-                    }
-                }
-                
-                // 1m, 3m, 6m charts: daily points - update every 288 updates (1 day)
-                if(updateCounter % 288 == 0) {
-                    if(coin.historicalData.count("1m")) {
-                        auto& data1m = coin.historicalData["1m"];
-                        data1m.push_back({currentTime, coin.price});
-                        if(data1m.size() > 30) {
-                            data1m.erase(data1m.begin());
-                        }
-                    }
-                    
-                    if(coin.historicalData.count("3m")) {
-                        auto& data3m = coin.historicalData["3m"];
-                        data3m.push_back({currentTime, coin.price});
-                        if(data3m.size() > 90) {
-                            data3m.erase(data3m.begin());
-                        }
-                    }
-                    
-                    if(coin.historicalData.count("6m")) {
-                        auto& data6m = coin.historicalData["6m"];
-                        data6m.push_back({currentTime, coin.price});
-                        if(data6m.size() > 180) {
-                            data6m.erase(data6m.begin());
-                        }
-                    }
-                }
-                
-                // 1y chart: 52 points (weekly) - update every 2016 updates (1 week)
-                if(updateCounter % 2016 == 0) {
-                    if(coin.historicalData.count("1y")) {
-                        auto& data1y = coin.historicalData["1y"];
-                        data1y.push_back({currentTime, coin.price});
-                        if(data1y.size() > 52) {
-                            data1y.erase(data1y.begin());
-                        }
-                    }
-                }
+            SnapshotPtr before = currentSnapshot();
+            SnapshotPtr after = updateSnapshot([&](MarketSnapshot& next) {
+                MarketSnapshot& leader = generation.snapshot;
+                shareUnchangedHistory(next, leader.coins); // next still holds the previous generation
+                next.version = leader.version;
+                next.publishedAt = leader.publishedAt;
+                next.coins = move(leader.coins);
+                next.globalStats = leader.globalStats;
+                next.trendingCoins = move(leader.trendingCoins);
+                next.trendingCategories = move(leader.trendingCategories);
+                next.fx = move(leader.fx);
+            });
+            nextUpdateAt = generation.clock.nextUpdateAt;
+            lastPriceUpdateAt = generation.clock.pricesAt;
+            replicaGeneration = generation.generation;
+            
+            if(!dataReady) {
+                dataReady = true;
+                cout << "✅ Serving " << after->coins.size() << " coins from replica generation "
+                     << generation.generation << endl;
+            } else {
+                priceStream.publishTick(*before, *after);
             }
         }
-        
-        cout << "✅ Live update complete (charts updated with new data points)" << endl;
-        cout << "📊 Next update in 5 minutes...\n" << endl;
-    }
-}
-
-// Convert coin data to JSON
-json coinToJson(const CoinData& coin, bool includeHistorical = false) {
-    json j;
-    j["id"] = coin.id;
-    j["rank"] = coin.rank;
-    j["name"] = coin.name;
-    j["symbol"] = coin.symbol;
-    j["logo"] = coin.logo;
-    j["price"] = coin.price;
-    j["change24h"] = coin.change24h;
-    j["marketCap"] = coin.marketCap;
-    j["volume24h"] = coin.volume24h;
-    j["circulatingSupply"] = coin.circulatingSupply;
-    j["totalSupply"] = coin.totalSupply;
-    j["maxSupply"] = coin.maxSupply;
-    j["ath"] = coin.ath;
-    j["athChangePercentage"] = coin.athChangePercentage;
-    j["athDate"] = coin.athDate;
-    j["sparklineData"] = coin.sparkline7d;
-    
-    if(includeHistorical) {
-        json historical;
-        for(const auto& [period, data] : coin.historicalData) {
-            json periodData = json::array();
-            for(const auto& [timestamp, price] : data) {
-                periodData.push_back({
-                    {"time", timestamp},
-                    {"price", price}
-                });
+        leaderHeartbeatAt = reader.heartbeat();
+        refreshJobs.sleepFor(chrono::milliseconds(REPLICA_POLL_MS));
+    }
+}
+
+// Strong tag of one representation of a snapshot: each format, layout and
+// content-coding is distinct, so each combination gets its own tag
+string representationETag(const MarketSnapshot& snapshot, const Representation& rep, Encoding encoding) {
+    string variant = rep.tag();
+    if(encoding != Encoding::Identity) {
+        variant += variant.empty() ? "" : "-";
+        variant += encodingName(encoding);
+    }
+    return makeETag(snapshot.version, variant);
+}
+
+// Whether the client's cached copy is current. If-None-Match takes precedence
+// (`matched` is the tag it matched); If-Modified-Since only applies without it.
+bool clientIsCurrent(const crow::request& req, const MarketSnapshot& snapshot, const vector<string>& etags,
+                     size_t& matched) {
+    matched = 0;
+    const string& ifNoneMatch = req.get_header_value("If-None-Match");
+    if(!ifNoneMatch.empty()) {
+        for(size_t i = 0; i < etags.size(); i++) {
+            if(etagMatches(ifNoneMatch, etags[i])) {
+                matched = i;
+                return true;
             }
-            historical[period] = periodData;
         }
-        j["historicalData"] = historical;
+        return false;
+    }
+    long long since = parseHttpDate(req.get_header_value("If-Modified-Since"));
+    return since >= 0 && snapshot.publishedAt <= since;
+}
+
+// Validators and freshness, on 200 and 304 alike. Clients may cache until
+// the next scheduled update.
+void addCacheHeaders(crow::response& res, const MarketSnapshot& snapshot, const string& etag) {
+    long long maxAge = max(0LL, nextUpdateAt.load() - unixNow());
+    res.add_header("Access-Control-Allow-Origin", "*");
+    res.add_header("Vary", "Accept-Encoding, Accept");
+    res.add_header("ETag", etag);
+    res.add_header("Last-Modified", formatHttpDate(snapshot.publishedAt));
+    res.add_header("Cache-Control", "public, max-age=" + to_string(maxAge));
+}
+
+// Build a response from a pre-rendered body, honoring conditional GETs.
+// The validators come from the snapshot: ETag from its version, Last-Modified
+// from its publish time. Clients may cache until the next scheduled update.
+// The pre-compressed variant matching Accept-Encoding is sent when available.
+// `rep` is what the body was rendered as (JSON rows unless negotiated).
+crow::response cachedResponse(const crow::request& req, const MarketSnapshot& snapshot, const EncodedBody& body,
+                              const Representation& rep = Representation()) {
+    Encoding encoding = negotiateEncoding(req.get_header_value("Accept-Encoding"));
+    if(!body.has(encoding)) {
+        encoding = Encoding::Identity;
+    }
+    
+    string etag = representationETag(snapshot, rep, encoding);
+    size_t matched;
+    crow::response res(clientIsCurrent(req, snapshot, {etag}, matched) ? 304 : 200);
+    if(res.code == 200) {
+        res.body = body.bytes(encoding);
+        res.add_header("Content-Type", rep.contentType());
+        if(encoding != Encoding::Identity) {
+            res.add_header("Content-Encoding", encodingName(encoding));
+        }
+    }
+    addCacheHeaders(res, snapshot, etag);
+    return res;
+}
+
+// cachedResponse() for a body that costs something to build (rendered,
+// compressed, or looked up in the memo): validators are checked first, so a
+// revalidation answered 304 builds nothing. Until the body exists it is not
+// known whether it comes in the negotiated content-coding or as identity, so
+// a tag for either of this version's representations matches.
+crow::response lazyCachedResponse(const crow::request& req, const MarketSnapshot& snapshot,
+                                  const function<ResponseMemo::Body()>& body,
+                                  const Representation& rep = Representation()) {
+    Encoding negotiated = negotiateEncoding(req.get_header_value("Accept-Encoding"));
+    vector<string> etags = {representationETag(snapshot, rep, negotiated)};
+    if(negotiated != Encoding::Identity) etags.push_back(representationETag(snapshot, rep, Encoding::Identity));
+    
+    size_t matched;
+    if(clientIsCurrent(req, snapshot, etags, matched)) {
+        crow::response res(304);
+        addCacheHeaders(res, snapshot, etags[matched]);
+        return res;
+    }
+    return cachedResponse(req, snapshot, *body(), rep);
+}
+
+// Routes as labelled in /metrics
+enum class Route { Coins, Coin, History, Global, Trending, Stats, Search, Stream, Health, Metrics, Other };
+const char* const ROUTE_NAMES[] = {"coins", "coin", "history", "global", "trending", "stats", "search", "stream",
+                                   "health", "metrics", "other"};
+constexpr size_t ROUTE_COUNT = sizeof(ROUTE_NAMES) / sizeof(ROUTE_NAMES[0]);
+
+Route routeOf(const string& path) {
+    if(path == "/api/coins") return Route::Coins;
+    if(path.compare(0, 10, "/api/coin/") == 0) {
+        return path.size() > 18 && path.compare(path.size() - 8, 8, "/history") == 0 ? Route::History : Route::Coin;
+    }
+    if(path == "/api/global") return Route::Global;
+    if(path == "/api/trending") return Route::Trending;
+    if(path == "/api/stats") return Route::Stats;
+    if(path == "/api/search") return Route::Search;
+    if(path == "/api/stream") return Route::Stream;
+    if(path == "/health") return Route::Health;
+    if(path == "/metrics") return Route::Metrics;
+    return Route::Other;
+}
+
+// Per-route counters. Updated with relaxed atomics from the request
+// threads; nothing on the request path takes a lock for them.
+struct RouteMetrics {
+    atomic<uint64_t> responses[5] = {}; // by status class, 1xx..5xx
+    Histogram latencyUs{LATENCY_BUCKETS_US};
+    Histogram bodyBytes{SIZE_BUCKETS_BYTES};
+};
+
+RouteMetrics routeMetrics[ROUTE_COUNT];
+
+// Crow middleware timing every request from routing to the response being
+// ready (socket writes excluded)
+struct RequestMetrics {
+    struct context {
+        chrono::steady_clock::time_point start;
+    };
+    
+    void before_handle(crow::request&, crow::response&, context& ctx) {
+        ctx.start = chrono::steady_clock::now();
+    }
+    
+    void after_handle(crow::request& req, crow::response& res, context& ctx) {
+        RouteMetrics& metrics = routeMetrics[static_cast<size_t>(routeOf(req.url))];
+        long long us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - ctx.start).count();
+        metrics.latencyUs.observe((uint64_t)us);
+        metrics.bodyBytes.observe(res.body.size());
+        int statusClass = min(max(res.code / 100, 1), 5);
+        metrics.responses[statusClass - 1].fetch_add(1, memory_order_relaxed);
+    }
+};
+
+// Prometheus exposition of the request, publish, upstream and data metrics
+string renderMetrics() {
+    MetricsText out;
+    
+    out.family("cryptolizard_http_responses_total", "counter", "HTTP responses by route and status class");
+    for(size_t r = 0; r < ROUTE_COUNT; r++) {
+        for(int c = 0; c < 5; c++) {
+            uint64_t count = routeMetrics[r].responses[c].load(memory_order_relaxed);
+            if(count == 0) continue;
+            out.sample("cryptolizard_http_responses_total",
+                       string("route=\"") + ROUTE_NAMES[r] + "\",code=\"" + to_string(c + 1) + "xx\"", (double)count);
+        }
+    }
+    out.family("cryptolizard_http_request_duration_seconds", "histogram", "Time to build a response, by route");
+    for(size_t r = 0; r < ROUTE_COUNT; r++) {
+        out.histogram("cryptolizard_http_request_duration_seconds", string("route=\"") + ROUTE_NAMES[r] + "\"",
+                      routeMetrics[r].latencyUs.read(), 1e6);
+    }
+    out.family("cryptolizard_http_response_size_bytes", "histogram", "Response body size as sent, by route");
+    for(size_t r = 0; r < ROUTE_COUNT; r++) {
+        out.histogram("cryptolizard_http_response_size_bytes", string("route=\"") + ROUTE_NAMES[r] + "\"",
+                      routeMetrics[r].bodyBytes.read());
+    }
+    
+    const PublishMetrics& publish = publishMetrics();
+    out.family("cryptolizard_publish_lock_wait_seconds", "histogram", "Time a writer waited for the snapshot publish lock");
+    out.histogram("cryptolizard_publish_lock_wait_seconds", "", publish.lockWaitUs.read(), 1e6);
+    out.family("cryptolizard_publish_lock_hold_seconds", "histogram",
+               "Time the publish lock was held (copy, mutate, render, swap)");
+    out.histogram("cryptolizard_publish_lock_hold_seconds", "", publish.lockHoldUs.read(), 1e6);
+    
+    // HTTP client metrics; a replay has no client and no quota, a follower
+    // no upstream at all
+    if(FetchScheduler* scheduler = REPLICA_ROLE == ReplicaRole::Follower ? nullptr : upstream().scheduler()) {
+        map<string, EndpointStats> endpoints = scheduler->endpointStats();
+        out.family("cryptolizard_upstream_attempts_total", "counter", "Upstream HTTP attempts, retries included");
+        for(const auto& [name, stats] : endpoints) {
+            out.sample("cryptolizard_upstream_attempts_total", "endpoint=\"" + name + "\"", (double)stats.attempts);
+        }
+        out.family("cryptolizard_upstream_failures_total", "counter", "Upstream attempts failed by transport error, 429 or 5xx");
+        for(const auto& [name, stats] : endpoints) {
+            out.sample("cryptolizard_upstream_failures_total", "endpoint=\"" + name + "\"", (double)stats.failures);
+        }
+        out.family("cryptolizard_upstream_errors_total", "counter", "Upstream requests that failed after their last attempt");
+        for(const auto& [name, stats] : endpoints) {
+            out.sample("cryptolizard_upstream_errors_total", "endpoint=\"" + name + "\"", (double)stats.errors);
+        }
+        out.family("cryptolizard_upstream_duration_seconds", "histogram", "Upstream attempt latency");
+        for(const auto& [name, stats] : endpoints) {
+            out.histogram("cryptolizard_upstream_duration_seconds", "endpoint=\"" + name + "\"", stats.latencyUs, 1e6);
+        }
+        
+        // Rate limit budget: tokens left in the bucket, and what each class spent
+        FetchStats fetchStats = scheduler->stats();
+        static const char* const PRIORITY_NAMES[FETCH_PRIORITY_COUNT] = {"live", "market", "backfill"};
+        out.family("cryptolizard_upstream_tokens_available", "gauge", "Rate limit tokens available now");
+        out.sample("cryptolizard_upstream_tokens_available", "", scheduler->tokensAvailable());
+        out.family("cryptolizard_upstream_token_capacity", "gauge", "Rate limit bucket size (burst)");
+        out.sample("cryptolizard_upstream_token_capacity", "", scheduler->options().burst);
+        out.family("cryptolizard_upstream_rate_limit_per_minute", "gauge", "Upstream request quota");
+        out.sample("cryptolizard_upstream_rate_limit_per_minute", "", scheduler->options().requestsPerMinute);
+        out.family("cryptolizard_upstream_tokens_spent_total", "counter", "Rate limit tokens spent, by request class");
+        for(size_t p = 0; p < FETCH_PRIORITY_COUNT; p++) {
+            out.sample("cryptolizard_upstream_tokens_spent_total", string("class=\"") + PRIORITY_NAMES[p] + "\"",
+                       (double)fetchStats.attemptsByPriority[p]);
+        }
+        out.family("cryptolizard_upstream_queued_requests", "gauge", "Upstream requests waiting for a token or a retry");
+        out.sample("cryptolizard_upstream_queued_requests", "", (double)scheduler->queued());
+    }
+    
+    // Periodic refreshes: how long each run took, and what was missed
+    vector<JobScheduler::JobStats> jobs = refreshJobs.stats();
+    out.family("cryptolizard_job_runs_total", "counter", "Runs of each periodic job");
+    for(const auto& job : jobs) {
+        out.sample("cryptolizard_job_runs_total", "job=\"" + job.name + "\"", (double)job.runs);
+    }
+    out.family("cryptolizard_job_skipped_ticks_total", "counter", "Job deadlines skipped because a run overran");
+    for(const auto& job : jobs) {
+        out.sample("cryptolizard_job_skipped_ticks_total", "job=\"" + job.name + "\"", (double)job.skipped);
+    }
+    out.family("cryptolizard_job_failures_total", "counter", "Job runs that ended in an exception");
+    for(const auto& job : jobs) {
+        out.sample("cryptolizard_job_failures_total", "job=\"" + job.name + "\"", (double)job.failures);
+    }
+    out.family("cryptolizard_job_duration_seconds", "histogram", "Time each job run took");
+    for(const auto& job : jobs) {
+        out.histogram("cryptolizard_job_duration_seconds", "job=\"" + job.name + "\"", job.durationUs, 1e6);
+    }
+    
+    SnapshotPtr snapshot = currentSnapshot();
+    long long lastUpdate = lastPriceUpdateAt.load();
+    out.family("cryptolizard_seconds_since_last_update", "gauge", "Seconds since prices were last fetched and published");
+    out.sample("cryptolizard_seconds_since_last_update", "", lastUpdate > 0 ? (double)(unixNow() - lastUpdate) : NAN);
+    out.family("cryptolizard_data_version", "gauge", "Version of the published market data");
+    out.sample("cryptolizard_data_version", "", (double)snapshot->version);
+    out.family("cryptolizard_coins", "gauge", "Coins in the published market data");
+    out.sample("cryptolizard_coins", "", (double)snapshot->coins.size());
+    out.family("cryptolizard_stream_subscribers", "gauge", "Connected /api/stream websockets");
+    out.sample("cryptolizard_stream_subscribers", "", (double)priceStream.subscriberCount());
+    
+    if(REPLICA_ROLE != ReplicaRole::Standalone) {
+        out.family("cryptolizard_replica_generation", "gauge", "Replica generation last written (leader) or served (follower)");
+        out.sample("cryptolizard_replica_generation", "", (double)replicaGeneration.load());
+    }
+    if(REPLICA_ROLE == ReplicaRole::Follower) {
+        long long heartbeat = leaderHeartbeatAt.load();
+        out.family("cryptolizard_replica_leader_heartbeat_age_seconds", "gauge", "Seconds since the leader last wrote to the replica file");
+        out.sample("cryptolizard_replica_leader_heartbeat_age_seconds", "", heartbeat > 0 ? (double)(unixNow() - heartbeat) : NAN);
+    }
+    
+    // Share of coins with each chart period loaded
+    out.family("cryptolizard_history_coverage_ratio", "gauge", "Fraction of coins with history for a chart period");
+    for(const auto& spec : PERIODS) {
+        size_t loaded = 0;
+        for(const auto& coin : snapshot->coins) loaded += coin.historicalData.has(spec.period);
+        double ratio = snapshot->coins.empty() ? 0 : (double)loaded / snapshot->coins.size();
+        out.sample("cryptolizard_history_coverage_ratio", string("period=\"") + spec.key + "\"", ratio);
     }
     
-    return j;
+    return out.take();
+}
+
+// Format (Accept) and series layout (?layout=) a request asks for
+bool requestRepresentation(const crow::request& req, Representation& rep, string& error) {
+    return negotiateRepresentation(req.get_header_value("Accept"), req.url_params.get("layout"), rep, error);
+}
+
+// A body rendered for this request only, compressed if it is worth it
+ResponseMemo::Body encodedBody(string rendered) {
+    return make_shared<const EncodedBody>(EncodedBody::encodeForRequest(move(rendered)));
+}
+
+// Body under `key` in the snapshot's memo, rendered by `render` on first use
+ResponseMemo::Body memoizedBody(const MarketSnapshot& snapshot, const string& key, const function<string()>& render) {
+    ResponseMemo::Body body = snapshot.memo.find(key);
+    if(!body) {
+        body = snapshot.memo.insert(key, encodedBody(render()));
+    }
+    return body;
+}
+
+// The snapshot to answer from in the currency asked for with ?vs= (`snapshot`
+// itself for usd, the default). False with a message for a currency without
+// an exchange rate.
+bool requestCurrency(const crow::request& req, const SnapshotPtr& snapshot, SnapshotPtr& quoted, string& error) {
+    const char* vs = req.url_params.get("vs");
+    string currency = vs ? vs : "usd";
+    transform(currency.begin(), currency.end(), currency.begin(), [](unsigned char c) { return tolower(c); });
+    
+    quoted = currencyView(snapshot, currency);
+    if(!quoted) {
+        error = snapshot->fx.perUsd.empty() ? "Exchange rates are not loaded yet" : "Unknown currency: " + currency;
+        return false;
+    }
+    return true;
+}
+
+// Whether a since= request can be answered with a delta: the change log
+// reaches back to `since`, and for another currency the exchange rate hasn't
+// moved since then (a new rate changes every money field at once)
+bool deltaCovers(const MarketSnapshot& snapshot, unsigned long long since) {
+    if(!snapshot.changes.covers(since, snapshot.version)) return false;
+    return snapshot.currency == "usd" || since >= snapshot.fx.changedAt;
+}
+
+// Tell a since= client what it got: X-Delta is "changes" for a delta body and
+// "full" when the change log didn't reach back far enough. X-Data-Version is
+// the version to pass as since= next time.
+void addDeltaHeaders(crow::response& res, const MarketSnapshot& snapshot, bool delta) {
+    res.add_header("X-Delta", delta ? "changes" : "full");
+    res.add_header("X-Data-Version", to_string(snapshot.version));
+    res.add_header("Access-Control-Expose-Headers", "X-Delta, X-Data-Version");
 }
 
 // Main function
@@ -692,129 +1218,348 @@ int main() {
     // Initialize CURL
     curl_global_init(CURL_GLOBAL_DEFAULT);
     
-    // Start data initialization in background
-    thread initThread(initializeData);
-    initThread.detach();
+    if(!replicaRoleError.empty()) {
+        cerr << "⚠️  " << replicaRoleError << ", running standalone" << endl;
+    }
+    bool follower = REPLICA_ROLE == ReplicaRole::Follower;
+    
+    if(!upstreamConfigError.empty()) {
+        cerr << "⚠️  " << upstreamConfigError << ", using live" << endl;
+    }
+    if(follower) {
+        cout << "🔌 Upstream: none, following the leader at " << REPLICA_PATH << endl;
+    } else {
+        startUpstream();
+        cout << "🔌 Upstream: " << upstream().name();
+        if(UPSTREAM_CONFIG.mode != UpstreamConfig::Mode::Live) cout << " (" << UPSTREAM_CONFIG.recordDir << ")";
+        if(upstream().timeCompression() != 1) cout << ", time x" << upstream().timeCompression();
+        cout << endl;
+    }
+    
+    // Coin detail bodies beyond the hot set get fast gzip only
+    setFullPrecompressionRanks(HOT_COINS_COUNT);
     
-    // Wait for initial data to be ready before starting update loop
-    thread updateThread([&]() {
-        while(!dataReady) {
-            this_thread::sleep_for(chrono::seconds(1));
+    // Periodic refreshes, each on its own wall-clock boundaries (global and
+    // trending offset from the price tick). They start once data is ready.
+    if(!follower) {
+        refreshJobs.add("prices", marketTime(chrono::seconds(UPDATE_INTERVAL)), runLiveTick);
+        refreshJobs.add("global", marketTime(chrono::seconds(GLOBAL_REFRESH_SECONDS)),
+                        [](const JobTick&) { fetchGlobalStats(); }, marketTime(chrono::seconds(60)));
+        refreshJobs.add("trending", marketTime(chrono::seconds(TRENDING_REFRESH_SECONDS)),
+                        [](const JobTick&) { fetchTrendingCoins(); }, marketTime(chrono::seconds(120)));
+    }
+    
+    loadCoinNotes();
+    
+    // Start data initialization in background, then keep every history tier
+    // loaded. A follower gets both from the leader instead.
+    thread loader([follower]() {
+        if(follower) {
+            replicaFollowerLoop();
+            return;
         }
-        updateLiveData();
+        initializeData();
+        historySweepLoop();
     });
-    updateThread.detach();
     
-    // Create Crow app
-    crow::SimpleApp app;
+    // A leader's boot time names its replica file and prefixes every
+    // replica's ETags; followers take it from the file
+    thread replicator;
+    if(REPLICA_ROLE == ReplicaRole::Leader) {
+        uint64_t leaderId = chrono::duration_cast<chrono::milliseconds>(
+            chrono::system_clock::now().time_since_epoch()).count();
+        setETagOrigin(leaderId);
+        replicator = thread(replicaLeaderLoop, leaderId);
+    }
+    
+    // Create Crow app; every request is timed for /metrics
+    crow::App<RequestMetrics> app;
     
     // Enable CORS
     app.loglevel(crow::LogLevel::Warning);
     
     // API Routes
     
-    // GET /api/coins - Get all top coins
+    // GET /api/coins - Get all top coins. Optional query parameters:
+    // fields=id,price,...  sort=key|-key  min_mcap=N  limit=N  offset=N  layout=columns
+    // since=<version> (with fields= only) sends just what changed after that version
+    // Accept: application/msgpack or application/cbor selects a binary format
     CROW_ROUTE(app, "/api/coins")
-    ([]{
+    ([](const crow::request& req){
         if(!dataReady) {
             return crow::response(503, "Server is still loading data...");
         }
         
-        lock_guard<mutex> lock(dataMutex);
-        json response = json::array();
+        CoinQuery query;
+        Representation rep;
+        string error;
+        if(!parseCoinQuery([&](const char* key) { return req.url_params.get(key); }, query, error) ||
+           !requestRepresentation(req, rep, error)) {
+            return crow::response(400, error);
+        }
         
-        for(const auto& coin : topCoins) {
-            response.push_back(coinToJson(coin, false));
+        unsigned long long since = 0;
+        const char* sinceParam = req.url_params.get("since");
+        if(sinceParam) {
+            CoinQuery rest = query;
+            rest.fields = ALL_COIN_FIELDS;
+            if(!parseSinceVersion(sinceParam, since)) {
+                return crow::response(400, "since must be a data version");
+            }
+            if(!rest.isDefault()) {
+                return crow::response(400, "since can only be combined with fields");
+            }
         }
         
-        crow::response res(response.dump());
-        res.add_header("Access-Control-Allow-Origin", "*");
-        res.add_header("Content-Type", "application/json");
+        // Lock-free: pin the current snapshot for the duration of this request
+        SnapshotPtr snapshot;
+        if(!requestCurrency(req, currentSnapshot(), snapshot, error)) {
+            return crow::response(400, error);
+        }
+        if(sinceParam && deltaCovers(*snapshot, since)) {
+            string key = rep.tag() + "/coins/since/" + to_string(since) + "/" + to_string(query.fields);
+            crow::response res = lazyCachedResponse(req, *snapshot, [&] {
+                return memoizedBody(*snapshot, key, [&] {
+                    return encodeCoinsDelta(*snapshot, since, query.fields, rep);
+                });
+            }, rep);
+            addDeltaHeaders(res, *snapshot, true);
+            return res;
+        }
+        
+        // A since= too old for the change log gets the whole list
+        crow::response res;
+        if(query.isDefault()) {
+            if(rep.isDefault() && snapshot->currency == "usd") {
+                res = cachedResponse(req, *snapshot, snapshot->responses.coinsJson);
+            } else {
+                res = lazyCachedResponse(req, *snapshot, [&] {
+                    return memoizedBody(*snapshot, rep.tag() + "/coins", [&] {
+                        return encodeCoinList(snapshot->coins, rep);
+                    });
+                }, rep);
+            }
+        } else {
+            // Sort orders are precomputed per version; this costs the slice plus
+            // serialization, paid only when the client's copy is stale
+            size_t matched = 0;
+            res = lazyCachedResponse(req, *snapshot, [&] {
+                return encodedBody(runCoinQuery(*snapshot, query, rep, &matched));
+            }, rep);
+            if(res.code == 200) res.add_header("X-Total-Count", to_string(matched));
+        }
+        if(sinceParam) addDeltaHeaders(res, *snapshot, false);
         return res;
     });
     
-    // GET /api/coin/:id - Get detailed coin data
+    // GET /api/coin/:id - Get detailed coin data (by id, or by symbol such as "btc").
+    // since=<version> sends just the fields and chart points changed after that version.
     CROW_ROUTE(app, "/api/coin/<string>")
-    ([](const string& coinId){
+    ([](const crow::request& req, const string& coinId){
         if(!dataReady) {
             return crow::response(503, "Server is still loading data...");
         }
         
-        lock_guard<mutex> lock(dataMutex);
+        Representation rep;
+        string error;
+        if(!requestRepresentation(req, rep, error)) {
+            return crow::response(400, error);
+        }
+        
+        unsigned long long since = 0;
+        const char* sinceParam = req.url_params.get("since");
+        if(sinceParam && !parseSinceVersion(sinceParam, since)) {
+            return crow::response(400, "since must be a data version");
+        }
         
-        for(const auto& coin : topCoins) {
-            if(coin.id == coinId) {
-                json response = coinToJson(coin, true);
-                
-                crow::response res(response.dump());
-                res.add_header("Access-Control-Allow-Origin", "*");
-                res.add_header("Content-Type", "application/json");
-                return res;
-            }
+        SnapshotPtr base = currentSnapshot();
+        SnapshotPtr snapshot;
+        if(!requestCurrency(req, base, snapshot, error)) {
+            return crow::response(400, error);
         }
+        size_t slot;
         
-        return crow::response(404, "Coin not found");
+        const CoinData* coin = findCoin(*snapshot, coinId, &slot);
+        if(!coin) {
+            return crow::response(404, "Coin not found");
+        }
+        
+        // History is converted only for the coin being rendered
+        if(sinceParam && deltaCovers(*snapshot, since)) {
+            string key = rep.tag() + "/coin/" + coin->id + "/since/" + to_string(since);
+            crow::response res = lazyCachedResponse(req, *snapshot, [&] {
+                return memoizedBody(*snapshot, key, [&] {
+                    return encodeCoinDelta(*snapshot, quotedCoin(*base, *snapshot, slot), since, rep);
+                });
+            }, rep);
+            addDeltaHeaders(res, *snapshot, true);
+            return res;
+        }
+        
+        crow::response res;
+        if(rep.isDefault() && snapshot == base) {
+            res = cachedResponse(req, *snapshot, *snapshot->responses.coinJson[slot]);
+        } else {
+            res = lazyCachedResponse(req, *snapshot, [&] {
+                return memoizedBody(*snapshot, rep.tag() + "/coin/" + coin->id, [&] {
+                    return encodeCoinDetail(quotedCoin(*base, *snapshot, slot), rep);
+                });
+            }, rep);
+        }
+        if(sinceParam) addDeltaHeaders(res, *snapshot, false);
+        return res;
     });
     
-    // GET /api/global - Get global market stats
-    CROW_ROUTE(app, "/api/global")
-    ([]{
+    // GET /api/coin/:id/history - One chart period, optionally narrowed and downsampled:
+    // period=7d  points=200  from=<unix ms>  to=<unix ms>  layout=columns
+    CROW_ROUTE(app, "/api/coin/<string>/history")
+    ([](const crow::request& req, const string& coinId){
         if(!dataReady) {
             return crow::response(503, "Server is still loading data...");
         }
         
-        lock_guard<mutex> lock(dataMutex);
+        HistoryQuery query;
+        Representation rep;
+        string error;
+        if(!parseHistoryQuery([&](const char* key) { return req.url_params.get(key); }, query, error) ||
+           !requestRepresentation(req, rep, error)) {
+            return crow::response(400, error);
+        }
         
-        json response;
-        response["totalMarketCap"] = globalStats.totalMarketCap;
-        response["totalVolume"] = globalStats.totalVolume;
-        response["btcDominance"] = globalStats.btcDominance;
-        response["activeCryptocurrencies"] = globalStats.activeCryptocurrencies;
-        response["marketCapChange24h"] = globalStats.marketCapChange24h;
+        SnapshotPtr base = currentSnapshot();
+        SnapshotPtr snapshot;
+        if(!requestCurrency(req, base, snapshot, error)) {
+            return crow::response(400, error);
+        }
+        size_t slot;
+        const CoinData* coin = findCoin(*snapshot, coinId, &slot);
+        if(!coin) {
+            return crow::response(404, "Coin not found");
+        }
+        auto render = [&] {
+            return snapshot == base ? renderHistory(*coin, query, rep) :
+                                      renderHistory(quotedCoin(*base, *snapshot, slot), query, rep);
+        };
         
-        crow::response res(response.dump());
-        res.add_header("Access-Control-Allow-Origin", "*");
-        res.add_header("Content-Type", "application/json");
-        return res;
+        // Whole-period results are kept for the rest of this data version
+        if(query.ranged()) {
+            return lazyCachedResponse(req, *snapshot, [&] { return encodedBody(render()); }, rep);
+        }
+        string key = rep.tag() + "/history/" + coin->id + "/" + periodSpec(query.period).key + "/" +
+                     to_string(query.points);
+        return lazyCachedResponse(req, *snapshot, [&] { return memoizedBody(*snapshot, key, render); }, rep);
+    });
+    
+    // GET /api/global - Get global market stats
+    CROW_ROUTE(app, "/api/global")
+    ([](const crow::request& req){
+        if(!dataReady) {
+            return crow::response(503, "Server is still loading data...");
+        }
+        
+        // Lock-free: pin the current snapshot for the duration of this request
+        SnapshotPtr snapshot;
+        string error;
+        if(!requestCurrency(req, currentSnapshot(), snapshot, error)) {
+            return crow::response(400, error);
+        }
+        if(snapshot->currency == "usd") {
+            return cachedResponse(req, *snapshot, snapshot->responses.globalJson);
+        }
+        return lazyCachedResponse(req, *snapshot, [&] {
+            return memoizedBody(*snapshot, "/global", [&] {
+                return globalToJson(snapshot->globalStats).dump();
+            });
+        });
     });
     
     // GET /api/trending - Get trending coins and categories
     CROW_ROUTE(app, "/api/trending")
-    ([]{
+    ([](const crow::request& req){
         if(!dataReady) {
             return crow::response(503, "Server is still loading data...");
         }
         
-        lock_guard<mutex> lock(dataMutex);
+        // Lock-free: pin the current snapshot for the duration of this request.
+        // Trending has no prices, so every ?vs= currency gets the same body.
+        SnapshotPtr snapshot = currentSnapshot();
+        SnapshotPtr quoted;
+        string error;
+        if(!requestCurrency(req, snapshot, quoted, error)) {
+            return crow::response(400, error);
+        }
+        return cachedResponse(req, *snapshot, snapshot->responses.trendingJson);
+    });
+    
+    // GET /api/stats - Top movers and market-wide aggregates, computed once per update
+    CROW_ROUTE(app, "/api/stats")
+    ([](const crow::request& req){
+        if(!dataReady) {
+            return crow::response(503, "Server is still loading data...");
+        }
         
-        json response;
+        SnapshotPtr snapshot;
+        string error;
+        if(!requestCurrency(req, currentSnapshot(), snapshot, error)) {
+            return crow::response(400, error);
+        }
+        if(snapshot->currency == "usd") {
+            return cachedResponse(req, *snapshot, snapshot->responses.statsJson);
+        }
+        return lazyCachedResponse(req, *snapshot, [&] {
+            return memoizedBody(*snapshot, "/stats", [&] {
+                return statsToJson(snapshot->stats, snapshot->coins).dump();
+            });
+        });
+    });
+    
+    // GET /api/search - Coins by symbol, name, id or description words, best
+    // first: q=<text> (prefixes and small typos match)  limit=N (default 10, at most 50)
+    CROW_ROUTE(app, "/api/search")
+    ([](const crow::request& req){
+        if(!dataReady) {
+            return crow::response(503, "Server is still loading data...");
+        }
         
-        // Trending coins
-        json coins = json::array();
-        for(const auto& tc : trendingCoins) {
-            json coin;
-            coin["id"] = tc.id;
-            coin["name"] = tc.name;
-            coin["symbol"] = tc.symbol;
-            coin["logo"] = tc.logo;
-            coin["rank"] = tc.rank;
-            coins.push_back(coin);
-        }
-        response["coins"] = coins;
-        
-        // Trending categories
-        json categories = json::array();
-        for(const auto& cat : trendingCategories) {
-            json c;
-            c["name"] = cat.name;
-            c["trend"] = cat.trend;
-            categories.push_back(c);
-        }
-        response["categories"] = categories;
+        SearchQuery query;
+        Representation rep;
+        string error;
+        if(!parseSearchQuery([&](const char* key) { return req.url_params.get(key); }, query, error) ||
+           !requestRepresentation(req, rep, error)) {
+            return crow::response(400, error);
+        }
         
-        crow::response res(response.dump());
-        res.add_header("Access-Control-Allow-Origin", "*");
-        res.add_header("Content-Type", "application/json");
+        // The index belongs to the snapshot, so hits are slots of its coins
+        SnapshotPtr snapshot = currentSnapshot();
+        return lazyCachedResponse(req, *snapshot, [&] {
+            vector<SearchHit> hits;
+            if(snapshot->search) hits = snapshot->search->search(query.text, query.limit, snapshot->coins);
+            return encodedBody(encodeSearchResults(*snapshot, query.text, hits, rep));
+        }, rep);
+    });
+    
+    // WS /api/stream - Live price ticks (see price_stream.h for the protocol)
+    CROW_WEBSOCKET_ROUTE(app, "/api/stream")
+    .onopen([](crow::websocket::connection& conn) {
+        PriceStream::SubscriberId id = priceStream.connect(
+            [&conn](const string& frame) { conn.send_text(frame); },
+            [&conn](const string& reason) { conn.close(reason); });
+        conn.userdata(reinterpret_cast<void*>(static_cast<uintptr_t>(id)));
+    })
+    .onclose([](crow::websocket::connection& conn, const string&) {
+        priceStream.disconnect(static_cast<PriceStream::SubscriberId>(reinterpret_cast<uintptr_t>(conn.userdata())));
+    })
+    .onmessage([](crow::websocket::connection& conn, const string& data, bool isBinary) {
+        if(isBinary) return;
+        priceStream.onMessage(static_cast<PriceStream::SubscriberId>(reinterpret_cast<uintptr_t>(conn.userdata())),
+                              data, *currentSnapshot());
+    });
+    
+    // Prometheus metrics
+    CROW_ROUTE(app, "/metrics")
+    ([]{
+        crow::response res(renderMetrics());
+        res.add_header("Content-Type", "text/plain; version=0.0.4; charset=utf-8");
         return res;
     });
     
@@ -822,8 +1567,58 @@ int main() {
     CROW_ROUTE(app, "/health")
     ([]{
         json response;
+        SnapshotPtr snapshot = currentSnapshot();
         response["status"] = dataReady ? "ready" : "loading";
-        response["coins_loaded"] = topCoins.size();
+        response["coins_loaded"] = snapshot->coins.size();
+        response["stats_kernel"] = kernelName(bestKernel());
+        response["data_version"] = snapshot->version;
+        response["stream_subscribers"] = priceStream.subscriberCount();
+        
+        // Periodic refreshes: when each last ran and runs next (unix seconds)
+        json jobs = json::object();
+        for(const auto& job : refreshJobs.stats()) {
+            jobs[job.name] = {
+                {"runs", job.runs},
+                {"skipped", job.skipped},
+                {"last_run", job.runs ? unixSeconds(job.lastRun) : 0},
+                {"next_run", unixSeconds(job.nextRun)}
+            };
+        }
+        response["jobs"] = jobs;
+        
+        // Replication: the generation written or served, and how long ago the
+        // leader was last heard from
+        bool follower = REPLICA_ROLE == ReplicaRole::Follower;
+        if(REPLICA_ROLE != ReplicaRole::Standalone) {
+            response["replica"] = {
+                {"role", follower ? "follower" : "leader"},
+                {"path", REPLICA_PATH},
+                {"generation", replicaGeneration.load()}
+            };
+            long long heartbeat = leaderHeartbeatAt.load();
+            if(follower && heartbeat > 0) response["replica"]["leader_heartbeat_age"] = unixNow() - heartbeat;
+        }
+        
+        // Upstream client: where the time of an average call goes
+        response["upstream"] = {{"mode", follower ? "none" : upstream().name()}};
+        if(FetchScheduler* scheduler = follower ? nullptr : upstream().scheduler()) {
+            FetchStats upstreamStats = scheduler->stats();
+            double calls = max<double>(1, upstreamStats.attempts);
+            response["upstream"].update({
+                {"requests", upstreamStats.attempts},
+                {"failures", upstreamStats.failures},
+                {"reused_connections", upstreamStats.reusedConnections},
+                {"queued", scheduler->queued()},
+                {"avg_ms", {
+                    {"dns", upstreamStats.total.dnsUs / calls / 1000},
+                    {"connect", upstreamStats.total.connectUs / calls / 1000},
+                    {"tls", upstreamStats.total.tlsUs / calls / 1000},
+                    {"ttfb", upstreamStats.total.ttfbUs / calls / 1000},
+                    {"transfer", upstreamStats.total.transferUs / calls / 1000},
+                    {"total", upstreamStats.total.totalUs / calls / 1000}
+                }}
+            });
+        }
         
         crow::response res(response.dump());
         res.add_header("Access-Control-Allow-Origin", "*");
@@ -839,6 +1634,14 @@ int main() {
     cout << "\n🌐 Starting HTTP server on port " << port << "..." << endl;
     app.port(port).multithreaded().run();
     
+    // run() returns on SIGINT/SIGTERM. Let the running job and the coin being
+    // loaded finish, then stop.
+    cout << "\n🛑 Shutting down..." << endl;
+    refreshJobs.stop();
+    loader.join();
+    if(replicator.joinable()) replicator.join();
+    shutdownUpstream();
+    
     // Cleanup
     curl_global_cleanup();
     
@@ -0,0 +1,48 @@
+#include "currency.h"
+
+#include <cmath>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+using namespace std;
+
+bool FxRates::rate(string_view code, double& out) const {
+    if(code == "usd") {
+        out = 1;
+        return true;
+    }
+    auto it = perUsd.find(code);
+    if(it == perUsd.end()) return false;
+    out = it->second;
+    return true;
+}
+
+bool parseExchangeRates(string_view body, map<string, double, less<>>& perUsd, string& error) {
+    json data = json::parse(body.begin(), body.end(), nullptr, false);
+    if(data.is_discarded() || !data.is_object() || !data.contains("rates") || !data["rates"].is_object()) {
+        error = "exchange rates: expected {\"rates\": {...}}";
+        return false;
+    }
+
+    const json& rates = data["rates"];
+    auto valueOf = [](const json& entry) {
+        return entry.is_object() && entry.contains("value") && entry["value"].is_number() ?
+               entry["value"].get<double>() : NAN;
+    };
+    double usd = rates.contains("usd") ? valueOf(rates["usd"]) : NAN;
+    if(!(usd > 0)) {
+        error = "exchange rates: no usd rate";
+        return false;
+    }
+
+    perUsd.clear();
+    for(const auto& [code, entry] : rates.items()) {
+        double value = valueOf(entry);
+        if(value > 0 && isfinite(value)) perUsd[code] = value / usd;
+    }
+    return true;
+}
+
+void scaleValues(double* values, size_t count, double rate) {
+    for(size_t i = 0; i < count; i++) values[i] *= rate;
+}
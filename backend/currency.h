@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+#include <string_view>
+
+// Exchange rates out of USD. Every upstream price is fetched in USD; other
+// quote currencies (?vs=eur) are derived from one /exchange_rates call per
+// live tick, which covers every fiat and crypto unit CoinGecko quotes in.
+struct FxRates {
+    std::map<std::string, double, std::less<>> perUsd; // "eur" -> 0.92: units of the currency per dollar
+    unsigned long long changedAt = 0;                   // data version that last changed them
+
+    // Rate for a lower-case currency code; usd is always 1. False if unknown.
+    bool rate(std::string_view code, double& out) const;
+};
+
+// Parse an /exchange_rates body ({"rates":{"btc":{"value":1,..},"usd":{"value":67012.5,..},..}},
+// rates against BTC) into per-USD rates. On a malformed body returns false
+// with a message in `error`.
+bool parseExchangeRates(std::string_view body, std::map<std::string, double, std::less<>>& perUsd,
+                        std::string& error);
+
+// Multiply `count` values in place by `rate`
+void scaleValues(double* values, size_t count, double rate);
@@ -0,0 +1,441 @@
+#include "fetch_scheduler.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+using namespace std;
+
+TokenBucket::TokenBucket(double ratePerSecond, double capacity, Clock::time_point now)
+    : rate_(ratePerSecond), capacity_(capacity), tokens_(capacity), updated_(now) {}
+
+double TokenBucket::available(Clock::time_point now) const {
+    double elapsed = chrono::duration<double>(now - updated_).count();
+    return min(capacity_, tokens_ + max(0.0, elapsed) * rate_);
+}
+
+bool TokenBucket::tryTake(Clock::time_point now, double reserve) {
+    tokens_ = available(now);
+    updated_ = now;
+    if(tokens_ < 1 + reserve) return false;
+    tokens_ -= 1;
+    return true;
+}
+
+TokenBucket::Clock::duration TokenBucket::waitTime(Clock::time_point now, double reserve) const {
+    double missing = 1 + reserve - available(now);
+    if(missing <= 0) return Clock::duration::zero();
+    return chrono::duration_cast<Clock::duration>(chrono::duration<double>(missing / rate_));
+}
+
+struct FetchScheduler::Job {
+    FetchPriority priority;
+    string url;
+    shared_ptr<ResponseSink> sink;
+    FetchCallback onDone;
+    promise<FetchResult> result;
+    int attempts = 0;
+};
+
+// A pooled easy handle. Options that never change are set once at creation.
+struct FetchScheduler::Handle {
+    CURL* easy = nullptr;
+    size_t lastBodySize = 0; // to pre-size the next response buffer
+
+    ~Handle() { curl_easy_cleanup(easy); }
+};
+
+struct FetchScheduler::Transfer {
+    unique_ptr<Job> job;
+    unique_ptr<Handle> handle;
+    string body;
+    long retryAfter = 0; // seconds, from a Retry-After header
+    int streaming = -1;  // decided on the first chunk: 1 = 2xx body goes to the sink
+    bool sinkRejected = false;
+};
+
+struct FetchScheduler::EndpointMetrics {
+    uint64_t attempts = 0;
+    uint64_t failures = 0;
+    uint64_t errors = 0;
+    Histogram latencyUs{LATENCY_BUCKETS_US};
+};
+
+namespace {
+
+size_t readHeader(char* buffer, size_t size, size_t nitems, void* userp) {
+    size_t length = size * nitems;
+    static const char NAME[] = "retry-after:";
+    const size_t nameLength = sizeof(NAME) - 1;
+    if(length > nameLength) {
+        bool match = true;
+        for(size_t i = 0; i < nameLength && match; i++) {
+            match = tolower((unsigned char)buffer[i]) == NAME[i];
+        }
+        if(match) {
+            // Only the delta-seconds form; an HTTP-date falls back to our own backoff
+            *static_cast<long*>(userp) = strtol(string(buffer + nameLength, length - nameLength).c_str(), nullptr, 10);
+        }
+    }
+    return length;
+}
+
+bool isRetryable(CURLcode code, long status) {
+    return code != CURLE_OK || status == 429 || status >= 500;
+}
+
+long long infoUs(CURL* easy, CURLINFO info) {
+    curl_off_t value = 0;
+    curl_easy_getinfo(easy, info, &value);
+    return (long long)value;
+}
+
+// Split curl's cumulative timestamps into phases
+FetchTiming readTiming(CURL* easy) {
+    long long dns = infoUs(easy, CURLINFO_NAMELOOKUP_TIME_T);
+    long long connect = infoUs(easy, CURLINFO_CONNECT_TIME_T);
+    long long tls = infoUs(easy, CURLINFO_APPCONNECT_TIME_T);
+    long long firstByte = infoUs(easy, CURLINFO_STARTTRANSFER_TIME_T);
+    long long total = infoUs(easy, CURLINFO_TOTAL_TIME_T);
+
+    long newConnections = 0;
+    curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &newConnections);
+
+    FetchTiming t;
+    t.reusedConnection = newConnections == 0;
+    t.dnsUs = dns;
+    t.connectUs = max(0LL, connect - dns);
+    t.tlsUs = tls > 0 ? max(0LL, tls - connect) : 0;
+    long long requestSent = max({dns, connect, tls});
+    t.ttfbUs = firstByte > 0 ? max(0LL, firstByte - requestSent) : 0;
+    t.transferUs = firstByte > 0 ? max(0LL, total - firstByte) : 0;
+    t.totalUs = total;
+    return t;
+}
+
+void addTiming(FetchTiming& sum, const FetchTiming& t) {
+    sum.dnsUs += t.dnsUs;
+    sum.connectUs += t.connectUs;
+    sum.tlsUs += t.tlsUs;
+    sum.ttfbUs += t.ttfbUs;
+    sum.transferUs += t.transferUs;
+    sum.totalUs += t.totalUs;
+}
+
+} // namespace
+
+FetchScheduler::FetchScheduler(FetchSchedulerOptions options)
+    : options_(move(options)),
+      multi_(curl_multi_init()),
+      share_(curl_share_init()),
+      bucket_(options_.requestsPerMinute / 60.0, options_.burst),
+      random_((uint64_t)Clock::now().time_since_epoch().count() | 1) {
+    for(const auto& header : options_.headers) {
+        headerList_ = curl_slist_append(headerList_, header.c_str());
+    }
+
+    // Handles are only ever driven from the worker thread, so the share
+    // needs no lock callbacks
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(share_, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+
+    curl_multi_setopt(multi_, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+    curl_multi_setopt(multi_, CURLMOPT_MAX_HOST_CONNECTIONS, (long)options_.maxInFlight);
+
+    worker_ = thread(&FetchScheduler::run, this);
+}
+
+FetchScheduler::~FetchScheduler() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    curl_multi_wakeup(multi_);
+    worker_.join();
+
+    // Fail whatever was still queued or in flight
+    auto abandon = [](Job& job) {
+        FetchResult result;
+        result.error = "fetch scheduler stopped";
+        result.attempts = job.attempts;
+        if(job.onDone) job.onDone(result);
+        job.result.set_value(move(result));
+    };
+    for(auto& queue : queues_) {
+        for(auto& job : queue) abandon(*job);
+    }
+    for(auto& entry : delayed_) abandon(*entry.second);
+    for(auto& transfer : inFlight_) {
+        curl_multi_remove_handle(multi_, transfer->handle->easy);
+        abandon(*transfer->job);
+    }
+    inFlight_.clear();
+    idleHandles_.clear();
+
+    curl_share_cleanup(share_);
+    curl_slist_free_all(headerList_);
+    curl_multi_cleanup(multi_);
+}
+
+future<FetchResult> FetchScheduler::submit(FetchPriority priority, string url, shared_ptr<ResponseSink> sink,
+                                           FetchCallback onDone) {
+    auto job = make_unique<Job>();
+    job->priority = priority;
+    job->url = move(url);
+    job->sink = move(sink);
+    job->onDone = move(onDone);
+    future<FetchResult> result = job->result.get_future();
+    {
+        lock_guard<mutex> lock(mutex_);
+        queues_[static_cast<size_t>(priority)].push_back(move(job));
+    }
+    curl_multi_wakeup(multi_);
+    return result;
+}
+
+FetchStats FetchScheduler::stats() const {
+    lock_guard<mutex> lock(mutex_);
+    return stats_;
+}
+
+map<string, EndpointStats> FetchScheduler::endpointStats() const {
+    lock_guard<mutex> lock(mutex_);
+    map<string, EndpointStats> out;
+    for(const auto& [name, metrics] : endpoints_) {
+        EndpointStats& stats = out[name];
+        stats.attempts = metrics->attempts;
+        stats.failures = metrics->failures;
+        stats.errors = metrics->errors;
+        stats.latencyUs = metrics->latencyUs.read();
+    }
+    return out;
+}
+
+double FetchScheduler::tokensAvailable() const {
+    lock_guard<mutex> lock(mutex_);
+    return bucket_.available(Clock::now());
+}
+
+size_t FetchScheduler::queued() const {
+    lock_guard<mutex> lock(mutex_);
+    size_t count = delayed_.size();
+    for(const auto& queue : queues_) count += queue.size();
+    return count;
+}
+
+size_t FetchScheduler::writeBody(char* data, size_t size, size_t nmemb, void* userp) {
+    Transfer* transfer = static_cast<Transfer*>(userp);
+    size_t length = size * nmemb;
+
+    if(transfer->streaming < 0) {
+        long status = 0;
+        curl_easy_getinfo(transfer->handle->easy, CURLINFO_RESPONSE_CODE, &status);
+        transfer->streaming = transfer->job->sink && status >= 200 && status < 300;
+    }
+
+    if(!transfer->streaming) {
+        transfer->body.append(data, length);
+        return length;
+    }
+    if(!transfer->job->sink->write(data, length)) {
+        transfer->sinkRejected = true;
+        return 0; // aborts the transfer
+    }
+    return length;
+}
+
+void FetchScheduler::run() {
+    while(true) {
+        long timeoutMs;
+        {
+            lock_guard<mutex> lock(mutex_);
+            if(stopping_) return;
+            Clock::time_point now = Clock::now();
+            dispatchReady(now);
+            timeoutMs = pollTimeoutMs(now);
+        }
+
+        curl_multi_poll(multi_, nullptr, 0, (int)timeoutMs, nullptr);
+
+        int running = 0;
+        curl_multi_perform(multi_, &running);
+
+        int remaining = 0;
+        while(CURLMsg* msg = curl_multi_info_read(multi_, &remaining)) {
+            if(msg->msg != CURLMSG_DONE) continue;
+            Transfer* transfer = nullptr;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &transfer);
+            finishTransfer(transfer, msg->data.result);
+        }
+    }
+}
+
+// Called with mutex_ held
+void FetchScheduler::dispatchReady(Clock::time_point now) {
+    // Retries that are due go to the front of their class
+    while(!delayed_.empty() && delayed_.begin()->first <= now) {
+        unique_ptr<Job> job = move(delayed_.begin()->second);
+        delayed_.erase(delayed_.begin());
+        queues_[static_cast<size_t>(job->priority)].push_front(move(job));
+    }
+
+    while((int)inFlight_.size() < options_.maxInFlight) {
+        size_t p = 0;
+        while(p < FETCH_PRIORITY_COUNT && queues_[p].empty()) p++;
+        if(p == FETCH_PRIORITY_COUNT) return;
+
+        bool backfill = static_cast<FetchPriority>(p) == FetchPriority::Backfill;
+        if(backfill && !backfillSlotFree()) return;
+        if(!bucket_.tryTake(now, backfill ? options_.backfillReserve : 0)) return;
+
+        unique_ptr<Job> job = move(queues_[p].front());
+        queues_[p].pop_front();
+        startTransfer(move(job));
+    }
+}
+
+// Called with mutex_ held. Backfill may hold all but one slot, which stays
+// free for live and market requests.
+bool FetchScheduler::backfillSlotFree() const {
+    int backfilling = (int)count_if(inFlight_.begin(), inFlight_.end(), [](const unique_ptr<Transfer>& t) {
+        return t->job->priority == FetchPriority::Backfill;
+    });
+    return backfilling < max(1, options_.maxInFlight - 1);
+}
+
+// Called with mutex_ held
+long FetchScheduler::pollTimeoutMs(Clock::time_point now) const {
+    Clock::duration wait = chrono::seconds(1);
+    if(!delayed_.empty()) {
+        wait = min(wait, delayed_.begin()->first - now);
+    }
+    if((int)inFlight_.size() < options_.maxInFlight) {
+        for(size_t p = 0; p < FETCH_PRIORITY_COUNT; p++) {
+            if(queues_[p].empty()) continue;
+            bool backfill = static_cast<FetchPriority>(p) == FetchPriority::Backfill;
+            // A backfill without a slot waits for a transfer to finish, not a token
+            if(backfill && !backfillSlotFree()) break;
+            wait = min(wait, bucket_.waitTime(now, backfill ? options_.backfillReserve : 0));
+            break;
+        }
+    }
+    return max<long>(0, (long)chrono::duration_cast<chrono::milliseconds>(wait).count() + 1);
+}
+
+void FetchScheduler::startTransfer(unique_ptr<Job> job) {
+    auto transfer = make_unique<Transfer>();
+    transfer->job = move(job);
+    transfer->job->attempts++;
+
+    if(idleHandles_.empty()) {
+        auto handle = make_unique<Handle>();
+        CURL* easy = curl_easy_init();
+        handle->easy = easy;
+        curl_easy_setopt(easy, CURLOPT_SHARE, share_);
+        curl_easy_setopt(easy, CURLOPT_HTTPHEADER, headerList_);
+        curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, ""); // any coding libcurl can decode
+        curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, writeBody);
+        curl_easy_setopt(easy, CURLOPT_HEADERFUNCTION, readHeader);
+        curl_easy_setopt(easy, CURLOPT_TIMEOUT, options_.timeoutSeconds);
+        curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPIDLE, 60L);
+        curl_easy_setopt(easy, CURLOPT_TCP_KEEPINTVL, 30L);
+        curl_easy_setopt(easy, CURLOPT_DNS_CACHE_TIMEOUT, 600L);
+        if(options_.http2) {
+            curl_easy_setopt(easy, CURLOPT_HTTP_VERSION, (long)CURL_HTTP_VERSION_2TLS);
+            curl_easy_setopt(easy, CURLOPT_PIPEWAIT, 1L);
+        }
+        idleHandles_.push_back(move(handle));
+    }
+    transfer->handle = move(idleHandles_.back());
+    idleHandles_.pop_back();
+
+    // Responses to the same endpoints are similar in size; avoid regrowing
+    if(transfer->job->sink) {
+        transfer->job->sink->reset();
+    } else {
+        transfer->body.reserve(transfer->handle->lastBodySize);
+    }
+
+    CURL* easy = transfer->handle->easy;
+    curl_easy_setopt(easy, CURLOPT_URL, transfer->job->url.c_str());
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, transfer.get());
+    curl_easy_setopt(easy, CURLOPT_HEADERDATA, &transfer->retryAfter);
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer.get());
+
+    curl_multi_add_handle(multi_, easy);
+    inFlight_.push_back(move(transfer));
+}
+
+void FetchScheduler::finishTransfer(Transfer* transfer, CURLcode code) {
+    CURL* easy = transfer->handle->easy;
+    long status = 0;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+    FetchTiming timing = readTiming(easy);
+    timing.reusedConnection = timing.reusedConnection && code == CURLE_OK;
+    curl_multi_remove_handle(multi_, easy);
+
+    unique_lock<mutex> lock(mutex_);
+
+    auto it = find_if(inFlight_.begin(), inFlight_.end(),
+                      [&](const unique_ptr<Transfer>& t) { return t.get() == transfer; });
+    unique_ptr<Transfer> done = move(*it);
+    inFlight_.erase(it);
+    Job& job = *done->job;
+
+    if(!done->job->sink) done->handle->lastBodySize = done->body.size();
+    idleHandles_.push_back(move(done->handle));
+
+    // A body the sink could not parse will not parse any better next time
+    bool retryable = isRetryable(code, status) && !done->sinkRejected;
+    bool failed = isRetryable(code, status);
+    stats_.attempts++;
+    stats_.failures += failed;
+    stats_.reusedConnections += timing.reusedConnection;
+    stats_.attemptsByPriority[static_cast<size_t>(job.priority)]++;
+    addTiming(stats_.total, timing);
+
+    auto& endpoint = endpoints_[options_.endpointOf ? options_.endpointOf(job.url) : "all"];
+    if(!endpoint) endpoint = make_unique<EndpointMetrics>();
+    endpoint->attempts++;
+    endpoint->failures += failed;
+    endpoint->latencyUs.observe((uint64_t)max(0LL, timing.totalUs));
+
+    if(retryable && job.attempts < options_.maxAttempts && !stopping_) {
+        Clock::duration delay = backoff(job, done->retryAfter);
+        cerr << "⚠️  Upstream " << (code != CURLE_OK ? curl_easy_strerror(code) : "HTTP " + to_string(status))
+             << " for " << job.url << ", retry " << job.attempts << "/" << (options_.maxAttempts - 1) << " in "
+             << chrono::duration_cast<chrono::milliseconds>(delay).count() << "ms" << endl;
+        delayed_.emplace(Clock::now() + delay, move(done->job));
+        return;
+    }
+
+    FetchResult result;
+    result.status = code == CURLE_OK ? status : 0;
+    endpoint->errors += code != CURLE_OK || status < 200 || status >= 300;
+    result.body = move(done->body);
+    result.attempts = job.attempts;
+    result.timing = timing;
+    if(code != CURLE_OK) result.error = done->sinkRejected ? "malformed response body" : curl_easy_strerror(code);
+
+    // The job is ours now; the callback may be slow (a file write)
+    lock.unlock();
+    if(job.onDone) job.onDone(result);
+    job.result.set_value(move(result));
+}
+
+// Exponential backoff with equal jitter, never shorter than Retry-After
+FetchScheduler::Clock::duration FetchScheduler::backoff(const Job& job, long retryAfterSeconds) {
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 7;
+    random_ ^= random_ << 17;
+
+    double ceiling = min<double>((double)options_.maxBackoff.count(),
+                                 (double)options_.baseBackoff.count() * (1 << min(job.attempts - 1, 16)));
+    double jitter = (double)(random_ >> 11) / (double)(1ULL << 53);
+    double delayMs = ceiling / 2 + jitter * ceiling / 2;
+    delayMs = max(delayMs, retryAfterSeconds * 1000.0);
+    return chrono::duration_cast<Clock::duration>(chrono::duration<double, milli>(delayMs));
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <curl/curl.h>
+
+#include "metrics.h"
+
+// Upstream request classes, highest priority first. A free token always goes
+// to the highest class with work queued.
+enum class FetchPriority : uint8_t {
+    Live,       // current prices for the live tick
+    Market,     // global stats, trending
+    Backfill,   // market_chart history
+};
+
+constexpr size_t FETCH_PRIORITY_COUNT = 3;
+
+// Token bucket sized to the provider's quota: `ratePerSecond` tokens are
+// added continuously, up to `capacity`.
+class TokenBucket {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    TokenBucket(double ratePerSecond, double capacity, Clock::time_point now = Clock::now());
+
+    // Take one token if at least `reserve` tokens remain afterwards
+    bool tryTake(Clock::time_point now, double reserve = 0);
+
+    // How long until tryTake(now, reserve) would succeed
+    Clock::duration waitTime(Clock::time_point now, double reserve = 0) const;
+
+    double available(Clock::time_point now) const;
+
+private:
+    double rate_;
+    double capacity_;
+    double tokens_;
+    Clock::time_point updated_;
+};
+
+// Receives a successful (2xx) response body chunk by chunk as it arrives,
+// instead of it being buffered into FetchResult::body. reset() is called
+// before every attempt, so a retried request starts from a clean state.
+class ResponseSink {
+public:
+    virtual ~ResponseSink() = default;
+
+    virtual void reset() = 0;
+
+    // False rejects the body and fails the request (without retrying it)
+    virtual bool write(const char* data, size_t size) = 0;
+};
+
+// Where the time of one attempt went (microseconds). Phases that did not
+// happen - DNS and handshakes on a reused connection - are zero.
+struct FetchTiming {
+    long long dnsUs = 0;
+    long long connectUs = 0;
+    long long tlsUs = 0;
+    long long ttfbUs = 0;       // request sent -> first response byte
+    long long transferUs = 0;   // first byte -> last byte
+    long long totalUs = 0;
+    bool reusedConnection = false;
+};
+
+struct FetchResult {
+    long status = 0;        // HTTP status; 0 when the transfer itself failed
+    std::string body;       // empty when the body went to a ResponseSink
+    std::string error;      // transport error, if any
+    int attempts = 0;
+    FetchTiming timing;     // of the final attempt
+
+    bool ok() const { return status >= 200 && status < 300; }
+};
+
+// Called once with a request's final result, before its future becomes ready
+using FetchCallback = std::function<void(const FetchResult&)>;
+
+struct FetchSchedulerOptions {
+    double requestsPerMinute = 30;
+    double burst = 5;                   // bucket capacity
+    double backfillReserve = 2;         // tokens backfill leaves for live/market requests
+    int maxInFlight = 4;                // backfill gets at most maxInFlight - 1 (at least 1)
+    int maxAttempts = 4;                // retries of 429, 5xx and transport errors
+    std::chrono::milliseconds baseBackoff{2000};
+    std::chrono::milliseconds maxBackoff{60000};
+    long timeoutSeconds = 30;
+    bool http2 = true;                  // offer HTTP/2 via ALPN, falling back to 1.1
+    std::vector<std::string> headers;   // sent with every request
+
+    // Groups requests for EndpointStats (e.g. "markets" for any page of
+    // /coins/markets). Unset = everything under "all".
+    std::function<std::string(const std::string& url)> endpointOf;
+};
+
+// Totals over all finished attempts, for /health
+struct FetchStats {
+    uint64_t attempts = 0;
+    uint64_t failures = 0;              // transport errors, 429s and 5xx
+    uint64_t reusedConnections = 0;
+    uint64_t attemptsByPriority[FETCH_PRIORITY_COUNT] = {}; // tokens spent per class
+    FetchTiming total;                  // summed phases
+};
+
+// Attempts of one endpoint, for /metrics
+struct EndpointStats {
+    uint64_t attempts = 0;
+    uint64_t failures = 0;              // attempts that failed (retried or not)
+    uint64_t errors = 0;                // requests that failed after their last attempt
+    Histogram::Counts latencyUs;        // per attempt, total time
+};
+
+// Runs upstream GETs on one curl multi handle from a background thread.
+// Requests are dispatched by priority as the token bucket allows, up to
+// maxInFlight at a time; every attempt (including retries) costs one token.
+// Backfill only dispatches while more than backfillReserve tokens are left,
+// and into at most maxInFlight - 1 slots, so a live request never waits
+// behind queued history: neither for a token nor for a slot held by slow
+// market_chart transfers.
+//
+// Easy handles are pooled and kept for the scheduler's lifetime. They share
+// a DNS cache, TLS sessions and the connection pool, so calls after the first
+// skip the lookup and handshakes and go out on a kept-alive connection.
+class FetchScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit FetchScheduler(FetchSchedulerOptions options = {});
+    ~FetchScheduler();
+
+    FetchScheduler(const FetchScheduler&) = delete;
+    FetchScheduler& operator=(const FetchScheduler&) = delete;
+
+    // Queue a GET. A 2xx body is streamed into `sink` when given. The request
+    // holds the sink until it finishes, so the future may be dropped early.
+    // `onDone` runs on the worker thread (or in the destructor, for a request
+    // the scheduler abandons), whether or not anyone waits on the future.
+    std::future<FetchResult> submit(FetchPriority priority, std::string url,
+                                    std::shared_ptr<ResponseSink> sink = nullptr, FetchCallback onDone = nullptr);
+
+    // Blocking convenience wrapper around submit()
+    FetchResult fetch(FetchPriority priority, std::string url, std::shared_ptr<ResponseSink> sink = nullptr) {
+        return submit(priority, std::move(url), std::move(sink)).get();
+    }
+
+    // Requests waiting for a token (including ones backing off before a retry)
+    size_t queued() const;
+
+    FetchStats stats() const;
+    std::map<std::string, EndpointStats> endpointStats() const;
+
+    // Rate limit budget: tokens left now, out of options().burst
+    double tokensAvailable() const;
+    const FetchSchedulerOptions& options() const { return options_; }
+
+private:
+    struct Job;
+    struct Transfer;
+    struct Handle;
+
+    static size_t writeBody(char* data, size_t size, size_t nmemb, void* userp);
+
+    void run();
+    void dispatchReady(Clock::time_point now);
+    bool backfillSlotFree() const;
+    void startTransfer(std::unique_ptr<Job> job);
+    void finishTransfer(Transfer* transfer, CURLcode code);
+    Clock::duration backoff(const Job& job, long retryAfterSeconds);
+    long pollTimeoutMs(Clock::time_point now) const;
+
+    FetchSchedulerOptions options_;
+    CURLM* multi_;
+    CURLSH* share_;
+    curl_slist* headerList_ = nullptr;
+    std::vector<std::unique_ptr<Handle>> idleHandles_;  // worker thread only
+
+    mutable std::mutex mutex_;
+    TokenBucket bucket_;
+    std::deque<std::unique_ptr<Job>> queues_[FETCH_PRIORITY_COUNT];
+    std::multimap<Clock::time_point, std::unique_ptr<Job>> delayed_;   // retries, by due time
+    std::vector<std::unique_ptr<Transfer>> inFlight_;
+    FetchStats stats_;
+    struct EndpointMetrics;
+    std::map<std::string, std::unique_ptr<EndpointMetrics>> endpoints_;
+    uint64_t random_;
+    bool stopping_ = false;
+
+    std::thread worker_;
+};
@@ -0,0 +1,259 @@
+#include "history.h"
+
+#include <cmath>
+
+using namespace std;
+
+bool parsePeriod(string_view key, Period& out) {
+    for(const auto& spec : PERIODS) {
+        if(key == spec.key) {
+            out = spec.period;
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t chartCallsFor(const vector<Period>& periods) {
+    bool needed[CHART_SOURCE_COUNT] = {};
+    size_t calls = 0;
+    for(Period p : periods) {
+        size_t source = periodSpec(p).source;
+        calls += !needed[source];
+        needed[source] = true;
+    }
+    return calls;
+}
+
+void CoinHistory::assign(Period p, const vector<pair<long long, double>>& points) {
+    const size_t i = index(p);
+    const size_t cap = periodSpec(p).capacity;
+    const size_t base = OFFSETS[i];
+    const size_t count = min(points.size(), cap);
+    const size_t skip = points.size() - count;
+
+    for(size_t k = 0; k < count; k++) {
+        times_[base + k] = points[skip + k].first;
+        prices_[base + k] = points[skip + k].second;
+    }
+    head_[i] = 0;
+    size_[i] = (uint16_t)count;
+    loaded_ |= bit(p);
+}
+
+void CoinHistory::copyPeriod(const CoinHistory& other, Period p) {
+    const size_t i = index(p);
+    const size_t base = OFFSETS[i];
+    const size_t cap = periodSpec(p).capacity;
+
+    copy_n(&other.times_[base], cap, &times_[base]);
+    copy_n(&other.prices_[base], cap, &prices_[base]);
+    head_[i] = other.head_[i];
+    size_[i] = other.size_[i];
+    loaded_ = uint8_t((loaded_ & ~bit(p)) | (other.loaded_ & bit(p)));
+}
+
+bool CoinHistory::samePoints(const CoinHistory& other) const {
+    if(loaded_ != other.loaded_) return false;
+    for(const auto& spec : PERIODS) {
+        Spans a = spans(spec.period);
+        Spans b = other.spans(spec.period);
+        if(a.size() != b.size()) return false;
+        for(size_t k = 0; k < a.size(); k++) {
+            if(a.time(k) != b.time(k) || a.price(k) != b.price(k)) return false;
+        }
+    }
+    return true;
+}
+
+void CoinHistory::scalePrices(double rate) {
+    // Each period is at most two contiguous runs (see spans())
+    for(size_t i = 0; i < PERIOD_COUNT; i++) {
+        const size_t cap = PERIODS[i].capacity;
+        const size_t first = min<size_t>(size_[i], cap - head_[i]);
+        double* run = &prices_[OFFSETS[i] + head_[i]];
+        for(size_t k = 0; k < first; k++) run[k] *= rate;
+        run = &prices_[OFFSETS[i]];
+        for(size_t k = 0; k < size_[i] - first; k++) run[k] *= rate;
+    }
+}
+
+bool CoinHistory::isStale(Period p, long long nowMs) const {
+    if(!has(p) || size(p) == 0) return true;
+    return nowMs - back(p).first > 2 * periodIntervalMs(periodSpec(p));
+}
+
+size_t CoinHistory::Spans::lowerBound(long long t) const {
+    size_t lo = 0, hi = size();
+    while(lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if(time(mid) < t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+const CoinHistory& SharedHistory::empty() {
+    static const CoinHistory none{};
+    return none;
+}
+
+CoinHistory& SharedHistory::mutate() {
+    if(!ptr_) {
+        ptr_ = make_shared<CoinHistory>();
+    } else if(ptr_.use_count() > 1) {
+        ptr_ = make_shared<CoinHistory>(*ptr_);
+    }
+    return *ptr_;
+}
+
+SharedHistory SharedHistory::scaled(double rate) const {
+    SharedHistory out;
+    if(ptr_) {
+        out.ptr_ = make_shared<CoinHistory>(*ptr_);
+        out.ptr_->scalePrices(rate);
+    }
+    return out;
+}
+
+namespace {
+
+long long bucketOf(long long time, long long intervalMs) {
+    long long q = time / intervalMs;
+    return (time % intervalMs < 0) ? q - 1 : q;
+}
+
+} // namespace
+
+vector<pair<long long, double>> downsampleLTTB(const vector<pair<long long, double>>& points, long long intervalMs,
+                                               size_t capacity) {
+    vector<pair<long long, double>> out;
+    if(points.empty() || capacity == 0 || intervalMs <= 0) return out;
+
+    // Only the newest `capacity` buckets are kept
+    const long long lastBucket = bucketOf(points.back().first, intervalMs);
+    const long long firstBucket = lastBucket - (long long)capacity + 1;
+    auto first = lower_bound(points.begin(), points.end(), firstBucket * intervalMs,
+                             [](const pair<long long, double>& p, long long t) { return p.first < t; });
+
+    // Non-empty buckets as [begin, end) index ranges
+    vector<pair<size_t, size_t>> buckets;
+    buckets.reserve(capacity);
+    for(size_t i = first - points.begin(); i < points.size(); i++) {
+        long long b = bucketOf(points[i].first, intervalMs);
+        if(buckets.empty() || bucketOf(points[buckets.back().first].first, intervalMs) != b) {
+            buckets.push_back({i, i + 1});
+        } else {
+            buckets.back().second = i + 1;
+        }
+    }
+
+    if(buckets.size() == 1) {
+        out.push_back(points.back());
+        return out;
+    }
+
+    // Areas are computed relative to the first timestamp to keep precision
+    const double origin = (double)points[buckets.front().first].first;
+    auto x = [&](size_t i) { return (double)points[i].first - origin; };
+    auto y = [&](size_t i) { return points[i].second; };
+
+    out.reserve(buckets.size());
+    size_t previous = buckets.front().first; // first bucket keeps its first point
+    out.push_back(points[previous]);
+
+    for(size_t b = 1; b < buckets.size(); b++) {
+        auto [begin, end] = buckets[b];
+        if(b + 1 == buckets.size()) {
+            out.push_back(points[end - 1]); // the newest point
+            break;
+        }
+
+        // Third vertex: the average of the next bucket
+        auto [nextBegin, nextEnd] = buckets[b + 1];
+        double avgX = 0, avgY = 0;
+        for(size_t i = nextBegin; i < nextEnd; i++) {
+            avgX += x(i);
+            avgY += y(i);
+        }
+        avgX /= (double)(nextEnd - nextBegin);
+        avgY /= (double)(nextEnd - nextBegin);
+
+        size_t best = begin;
+        double bestArea = -1;
+        for(size_t i = begin; i < end; i++) {
+            double area = fabs((x(previous) - avgX) * (y(i) - y(previous)) -
+                               (x(previous) - x(i)) * (avgY - y(previous)));
+            if(area > bestArea) {
+                bestArea = area;
+                best = i;
+            }
+        }
+        out.push_back(points[best]);
+        previous = best;
+    }
+    return out;
+}
+
+vector<size_t> selectLTTB(const CoinHistory::Spans& spans, size_t begin, size_t end, size_t points) {
+    vector<size_t> out;
+    if(end <= begin || points == 0) return out;
+
+    const size_t n = end - begin;
+    if(points >= n) {
+        for(size_t i = begin; i < end; i++) out.push_back(i);
+        return out;
+    }
+    if(points == 1) {
+        out.push_back(end - 1);
+        return out;
+    }
+
+    out.reserve(points);
+    out.push_back(begin);
+
+    // Interior points fall into points - 2 buckets of equal size
+    const double bucket = double(n - 2) / double(points - 2);
+    const double origin = (double)spans.time(begin);
+    auto x = [&](size_t i) { return (double)spans.time(i) - origin; };
+    auto y = [&](size_t i) { return spans.price(i); };
+    auto bucketStart = [&](size_t b) { return begin + 1 + min(n - 2, (size_t)(b * bucket)); };
+
+    size_t previous = begin;
+    for(size_t b = 0; b + 2 < points; b++) {
+        const size_t first = bucketStart(b), last = bucketStart(b + 1);
+
+        // Third vertex: the average of the next bucket (the final point for the last one)
+        size_t nextFirst = last, nextLast = b + 3 < points ? bucketStart(b + 2) : end;
+        if(nextFirst >= nextLast) {
+            nextFirst = end - 1;
+            nextLast = end;
+        }
+        double avgX = 0, avgY = 0;
+        for(size_t i = nextFirst; i < nextLast; i++) {
+            avgX += x(i);
+            avgY += y(i);
+        }
+        avgX /= (double)(nextLast - nextFirst);
+        avgY /= (double)(nextLast - nextFirst);
+
+        size_t best = first;
+        double bestArea = -1;
+        for(size_t i = first; i < last; i++) {
+            double area = fabs((x(previous) - avgX) * (y(i) - y(previous)) -
+                               (x(previous) - x(i)) * (avgY - y(previous)));
+            if(area > bestArea) {
+                bestArea = area;
+                best = i;
+            }
+        }
+        out.push_back(best);
+        previous = best;
+    }
+
+    out.push_back(end - 1);
+    return out;
+}
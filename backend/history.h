@@ -0,0 +1,240 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Chart periods served for every coin
+enum class Period : uint8_t {
+    H24,
+    D7,
+    W2,
+    M1,
+    M3,
+    M6,
+    Y1,
+};
+
+// Length of one live update tick; tickDivisor counts in these
+constexpr long long TICK_SECONDS = 5 * 60;
+
+// Upstream market_chart calls (days= parameter) every period is derived from.
+// CoinGecko answers days=1 with 5-minute points, up to 90 days with hourly
+// points and beyond that with daily points.
+constexpr int CHART_SOURCE_DAYS[] = {1, 90, 365};
+constexpr size_t CHART_SOURCE_COUNT = sizeof(CHART_SOURCE_DAYS) / sizeof(CHART_SOURCE_DAYS[0]);
+
+struct PeriodSpec {
+    Period period;
+    const char* key;     // name used in the API ("24h", "7d", ...)
+    size_t source;       // index into CHART_SOURCE_DAYS the period is built from
+    size_t capacity;     // points kept in the rolling window
+    int tickDivisor;     // one point every N five-minute ticks
+};
+
+// Period table. Everything period-specific (upstream fetch, downsampling,
+// rolling-window updates, serialization) is driven from here. Each window
+// spans capacity x tickDivisor ticks.
+constexpr PeriodSpec PERIODS[] = {
+    {Period::H24, "24h", 0, 288, 1},      // 5-minute points, from days=1
+    {Period::D7, "7d", 1, 168, 12},       // hourly, from days=90
+    {Period::W2, "2w", 1, 84, 48},        // 4-hourly, from days=90
+    {Period::M1, "1m", 1, 30, 288},       // daily, from days=90
+    {Period::M3, "3m", 1, 90, 288},       // daily, from days=90
+    {Period::M6, "6m", 2, 180, 288},      // daily, from days=365
+    {Period::Y1, "1y", 2, 52, 2016},      // weekly, from days=365
+};
+
+constexpr size_t PERIOD_COUNT = sizeof(PERIODS) / sizeof(PERIODS[0]);
+
+// Spacing of a period's points (ms)
+constexpr long long periodIntervalMs(const PeriodSpec& spec) {
+    return spec.tickDivisor * TICK_SECONDS * 1000;
+}
+
+constexpr bool periodTableValid() {
+    for(size_t i = 0; i < PERIOD_COUNT; i++) {
+        if(static_cast<size_t>(PERIODS[i].period) != i) return false;
+        if(PERIODS[i].capacity == 0 || PERIODS[i].capacity > 0xFFFF) return false;
+        if(PERIODS[i].source >= CHART_SOURCE_COUNT) return false;
+        // The window must fit inside the upstream series it is cut from
+        long long windowMs = (long long)PERIODS[i].capacity * periodIntervalMs(PERIODS[i]);
+        if(windowMs > CHART_SOURCE_DAYS[PERIODS[i].source] * 86400000LL) return false;
+    }
+    return PERIOD_COUNT <= 8;
+}
+
+static_assert(periodTableValid(), "PERIODS must follow Period enum order, with 16-bit capacities and windows "
+                                  "that fit their chart source");
+
+constexpr const PeriodSpec& periodSpec(Period p) {
+    return PERIODS[static_cast<size_t>(p)];
+}
+
+// Start of each period's window in a buffer holding all periods back to back
+constexpr std::array<size_t, PERIOD_COUNT + 1> periodOffsets() {
+    std::array<size_t, PERIOD_COUNT + 1> offsets{};
+    for(size_t i = 0; i < PERIOD_COUNT; i++) {
+        offsets[i + 1] = offsets[i] + PERIODS[i].capacity;
+    }
+    return offsets;
+}
+
+// Number of distinct chart sources (market_chart calls) behind `periods`
+size_t chartCallsFor(const std::vector<Period>& periods);
+
+// Map an API period key ("7d") to its Period; false if unknown
+bool parsePeriod(std::string_view key, Period& out);
+
+// Rolling price history of one coin: a fixed-capacity ring buffer per period,
+// stored as struct-of-arrays inside one inline block (no heap allocation).
+// Appends are O(1) and overwrite the oldest point once a period is full.
+class CoinHistory {
+public:
+    // The points of one period, oldest first, as up to two contiguous runs
+    struct Spans {
+        const long long* times[2];
+        const double* prices[2];
+        size_t lengths[2];
+
+        size_t size() const { return lengths[0] + lengths[1]; }
+
+        // Point i, counting from the oldest across both runs
+        long long time(size_t i) const { return i < lengths[0] ? times[0][i] : times[1][i - lengths[0]]; }
+        double price(size_t i) const { return i < lengths[0] ? prices[0][i] : prices[1][i - lengths[0]]; }
+
+        // First point at or after `t` (size() if none)
+        size_t lowerBound(long long t) const;
+    };
+
+    // Whether the period has been loaded from upstream
+    bool has(Period p) const { return loaded_ & bit(p); }
+
+    size_t size(Period p) const { return size_[index(p)]; }
+
+    // Replace a period with `points` (oldest first), keeping the newest
+    // `capacity` of them, and mark it loaded
+    void assign(Period p, const std::vector<std::pair<long long, double>>& points);
+
+    // Replace a period with the same period of `other`
+    void copyPeriod(const CoinHistory& other, Period p);
+
+    // Whether both hold the same loaded periods with the same points
+    bool samePoints(const CoinHistory& other) const;
+
+    // Multiply every price by `rate` (a quote in another currency), one
+    // contiguous run at a time so the loops vectorize
+    void scalePrices(double rate);
+
+    // Whether a period needs refetching: never loaded, empty, or its newest
+    // point is more than two sampling intervals older than `nowMs`
+    bool isStale(Period p, long long nowMs) const;
+
+    // Append a point, dropping the oldest when the period is full
+    void append(Period p, long long time, double price) {
+        const size_t i = index(p);
+        const size_t cap = periodSpec(p).capacity;
+        const size_t base = OFFSETS[i];
+        size_t tail = head_[i] + size_[i];
+        if(tail >= cap) tail -= cap;
+
+        times_[base + tail] = time;
+        prices_[base + tail] = price;
+
+        if(size_[i] < cap) {
+            size_[i]++;
+        } else {
+            head_[i] = (size_t(head_[i]) + 1 == cap) ? 0 : head_[i] + 1;
+        }
+    }
+
+    Spans spans(Period p) const {
+        const size_t i = index(p);
+        const size_t cap = periodSpec(p).capacity;
+        const size_t base = OFFSETS[i];
+        const size_t first = std::min<size_t>(size_[i], cap - head_[i]);
+
+        Spans s;
+        s.times[0] = &times_[base + head_[i]];
+        s.prices[0] = &prices_[base + head_[i]];
+        s.lengths[0] = first;
+        s.times[1] = &times_[base];
+        s.prices[1] = &prices_[base];
+        s.lengths[1] = size_[i] - first;
+        return s;
+    }
+
+    // Most recent point of a period (the period must not be empty)
+    std::pair<long long, double> back(Period p) const {
+        const size_t i = index(p);
+        const size_t cap = periodSpec(p).capacity;
+        size_t last = head_[i] + size_[i] - 1;
+        if(last >= cap) last -= cap;
+        return {times_[OFFSETS[i] + last], prices_[OFFSETS[i] + last]};
+    }
+
+private:
+    static constexpr size_t index(Period p) { return static_cast<size_t>(p); }
+    static constexpr uint8_t bit(Period p) { return uint8_t(1u << index(p)); }
+
+    static constexpr std::array<size_t, PERIOD_COUNT + 1> OFFSETS = periodOffsets();
+    static constexpr size_t TOTAL_CAPACITY = OFFSETS[PERIOD_COUNT];
+
+    std::array<long long, TOTAL_CAPACITY> times_;
+    std::array<double, TOTAL_CAPACITY> prices_;
+    std::array<uint16_t, PERIOD_COUNT> head_{};
+    std::array<uint16_t, PERIOD_COUNT> size_{};
+    uint8_t loaded_ = 0;
+};
+
+// Copy-on-write handle to a coin's CoinHistory. Every published snapshot
+// holds its own copy of the coin list, and those copies share one history
+// until a writer changes it, so publishing doesn't copy ~14 KB per coin.
+// A coin whose history was never loaded holds no buffer at all.
+class SharedHistory {
+public:
+    const CoinHistory& get() const { return ptr_ ? *ptr_ : empty(); }
+
+    bool has(Period p) const { return ptr_ && ptr_->has(p); }
+    size_t size(Period p) const { return ptr_ ? ptr_->size(p) : 0; }
+    bool isStale(Period p, long long nowMs) const { return get().isStale(p, nowMs); }
+    CoinHistory::Spans spans(Period p) const { return get().spans(p); }
+    std::pair<long long, double> back(Period p) const { return get().back(p); }
+
+    // Whether no buffer has been allocated (nothing loaded)
+    bool null() const { return !ptr_; }
+
+    // Whether both handles point at the same buffer
+    bool sharesWith(const SharedHistory& other) const { return ptr_ == other.ptr_; }
+
+    // History for writing, cloned first when another copy still shares it.
+    // Only the snapshot writer calls this, on a snapshot not yet published.
+    CoinHistory& mutate();
+
+    // A separate copy with every price multiplied by `rate`
+    SharedHistory scaled(double rate) const;
+
+private:
+    static const CoinHistory& empty();
+
+    std::shared_ptr<CoinHistory> ptr_;
+};
+
+// Pick at most `points` of the points [begin, end) of `spans` without
+// copying them: the range is split into equal-count buckets and LTTB keeps
+// one point per bucket, always including the first and last. Returns the
+// chosen indices, oldest first (all of them when the range is short enough).
+std::vector<size_t> selectLTTB(const CoinHistory::Spans& spans, size_t begin, size_t end, size_t points);
+
+// Downsample `points` (oldest first) to one point per time bucket of
+// `intervalMs`, aligned to multiples of intervalMs, keeping the newest
+// `capacity` buckets. The point kept in each bucket is chosen by
+// largest-triangle-three-buckets (LTTB), so spikes survive; the newest point
+// is always kept. Empty buckets produce no point.
+std::vector<std::pair<long long, double>> downsampleLTTB(const std::vector<std::pair<long long, double>>& points,
+                                                         long long intervalMs, size_t capacity);
@@ -0,0 +1,140 @@
+#include "history_query.h"
+
+#include <cerrno>
+#include <cstdlib>
+using namespace std;
+
+namespace {
+
+bool parseInteger(const char* text, long long& out) {
+    if(!*text) return false;
+    errno = 0;
+    char* end;
+    out = strtoll(text, &end, 10);
+    return !*end && !errno;
+}
+
+void writePoint(WireWriter& out, long long time, double price) {
+    out.beginMap(2);
+    out.key("time");
+    out.integer(time);
+    out.key("price");
+    out.number(price);
+    out.endMap();
+}
+
+} // namespace
+
+bool parseHistoryQuery(const function<const char*(const char*)>& param, HistoryQuery& out, string& error) {
+    out = HistoryQuery();
+
+    if(const char* period = param("period")) {
+        if(!parsePeriod(period, out.period)) {
+            error = "Unknown period: " + string(period);
+            return false;
+        }
+    }
+
+    if(const char* points = param("points")) {
+        long long value;
+        if(!parseInteger(points, value) || value < 0) {
+            error = "points must be a non-negative integer";
+            return false;
+        }
+        out.points = (size_t)value;
+    }
+
+    if(const char* from = param("from")) {
+        if(!parseInteger(from, out.from)) {
+            error = "from must be a unix time in milliseconds";
+            return false;
+        }
+    }
+
+    if(const char* to = param("to")) {
+        if(!parseInteger(to, out.to)) {
+            error = "to must be a unix time in milliseconds";
+            return false;
+        }
+    }
+
+    if(out.from > out.to) {
+        error = "from is after to";
+        return false;
+    }
+    return true;
+}
+
+void writeSeries(WireWriter& out, const CoinHistory::Spans& spans, SeriesLayout layout) {
+    const size_t count = spans.size();
+    if(layout == SeriesLayout::Columns) {
+        // Each ring run goes out as one block of raw values
+        out.beginMap(2);
+        out.key("t");
+        out.beginInt64Column(count);
+        for(int run = 0; run < 2; run++) out.columnValues(spans.times[run], spans.lengths[run]);
+        out.endColumn();
+        out.key("p");
+        out.beginFloat64Column(count);
+        for(int run = 0; run < 2; run++) out.columnValues(spans.prices[run], spans.lengths[run]);
+        out.endColumn();
+        out.endMap();
+        return;
+    }
+
+    out.beginArray(count);
+    for(int run = 0; run < 2; run++) {
+        for(size_t k = 0; k < spans.lengths[run]; k++) writePoint(out, spans.times[run][k], spans.prices[run][k]);
+    }
+    out.endArray();
+}
+
+void writeSeries(WireWriter& out, const CoinHistory::Spans& spans, const vector<size_t>& picked, SeriesLayout layout) {
+    if(layout == SeriesLayout::Columns) {
+        out.beginMap(2);
+        out.key("t");
+        out.beginInt64Column(picked.size());
+        for(size_t i : picked) {
+            long long time = spans.time(i);
+            out.columnValues(&time, 1);
+        }
+        out.endColumn();
+        out.key("p");
+        out.beginFloat64Column(picked.size());
+        for(size_t i : picked) {
+            double price = spans.price(i);
+            out.columnValues(&price, 1);
+        }
+        out.endColumn();
+        out.endMap();
+        return;
+    }
+
+    out.beginArray(picked.size());
+    for(size_t i : picked) writePoint(out, spans.time(i), spans.price(i));
+    out.endArray();
+}
+
+string renderHistory(const CoinData& coin, const HistoryQuery& query, const Representation& rep) {
+    WireWriter out(rep.format);
+    out.beginMap(3);
+    out.key("id");
+    out.string(coin.id);
+    out.key("period");
+    out.string(periodSpec(query.period).key);
+    out.key("data");
+
+    if(coin.historicalData.has(query.period)) {
+        CoinHistory::Spans spans = coin.historicalData.spans(query.period);
+        size_t begin = spans.lowerBound(query.from);
+        size_t end = query.to == LLONG_MAX ? spans.size() : spans.lowerBound(query.to + 1);
+
+        size_t points = query.points ? query.points : spans.size();
+        writeSeries(out, spans, selectLTTB(spans, begin, end, points), rep.layout);
+    } else {
+        writeSeries(out, CoinHistory::Spans{}, vector<size_t>(), rep.layout);
+    }
+
+    out.endMap();
+    return out.take();
+}
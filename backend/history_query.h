@@ -0,0 +1,37 @@
+#pragma once
+
+#include <climits>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "market_data.h"
+#include "wire_format.h"
+
+// Parsed /api/coin/<id>/history query string
+struct HistoryQuery {
+    Period period = Period::H24;
+    size_t points = 0;          // at most this many points; 0 = every point in the window
+    long long from = LLONG_MIN; // window start, unix ms (inclusive)
+    long long to = LLONG_MAX;   // window end, unix ms (inclusive)
+
+    // Whether from= or to= narrowed the window (such results aren't memoized)
+    bool ranged() const { return from != LLONG_MIN || to != LLONG_MAX; }
+};
+
+// Parse period=, points=, from= and to=, reading each with `param` (nullptr
+// when absent). On a bad value returns false with a message in `error`.
+bool parseHistoryQuery(const std::function<const char*(const char*)>& param, HistoryQuery& out, std::string& error);
+
+// A series as [{"time":..,"price":..},..] (Rows) or {"t":[..],"p":[..]}
+// (Columns), written straight from the ring buffer: every point, or the
+// indices in `picked` (oldest first)
+void writeSeries(WireWriter& out, const CoinHistory::Spans& spans, SeriesLayout layout);
+void writeSeries(WireWriter& out, const CoinHistory::Spans& spans, const std::vector<size_t>& picked,
+                 SeriesLayout layout);
+
+// {"id":..,"period":"7d","data":<series>} for the window, downsampled with
+// selectLTTB straight from the coin's ring buffer
+std::string renderHistory(const CoinData& coin, const HistoryQuery& query,
+                          const Representation& rep = Representation());
@@ -0,0 +1,82 @@
+#include "http_cache.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+
+using namespace std;
+
+namespace {
+
+string hexId(unsigned long long id) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%llx", id);
+    return string(buf);
+}
+
+// Boot time (ms) unless setETagOrigin() replaced it. Request threads read it
+// while a replica follower may be switching it to a new leader's.
+atomic<unsigned long long>& etagOrigin() {
+    static atomic<unsigned long long> origin{(unsigned long long)chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count()};
+    return origin;
+}
+
+string_view trim(string_view s) {
+    while(!s.empty() && (s.front() == ' ' || s.front() == '\t')) s.remove_prefix(1);
+    while(!s.empty() && (s.back() == ' ' || s.back() == '\t')) s.remove_suffix(1);
+    return s;
+}
+
+string_view stripWeak(string_view tag) {
+    if(tag.size() >= 2 && tag[0] == 'W' && tag[1] == '/') tag.remove_prefix(2);
+    return tag;
+}
+
+} // namespace
+
+string makeETag(unsigned long long version, string_view variant) {
+    string tag = "\"" + hexId(etagOrigin().load(memory_order_relaxed)) + "-" + to_string(version);
+    if(!variant.empty()) {
+        tag += "-";
+        tag += variant;
+    }
+    tag += "\"";
+    return tag;
+}
+
+void setETagOrigin(unsigned long long origin) {
+    etagOrigin().store(origin, memory_order_relaxed);
+}
+
+bool etagMatches(string_view ifNoneMatch, string_view etag) {
+    ifNoneMatch = trim(ifNoneMatch);
+    if(ifNoneMatch == "*") return true;
+
+    etag = stripWeak(etag);
+    while(!ifNoneMatch.empty()) {
+        size_t comma = ifNoneMatch.find(',');
+        string_view candidate = trim(ifNoneMatch.substr(0, comma));
+        if(stripWeak(candidate) == etag) return true;
+        if(comma == string_view::npos) break;
+        ifNoneMatch.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+string formatHttpDate(long long unixSeconds) {
+    time_t t = (time_t)unixSeconds;
+    tm utc;
+    gmtime_r(&t, &utc);
+    char buf[64];
+    strftime(buf, sizeof(buf), "%a, %d %b %Y %H:%M:%S GMT", &utc);
+    return buf;
+}
+
+long long parseHttpDate(const string& value) {
+    tm utc = {};
+    const char* end = strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &utc);
+    if(!end || *end != '\0') return -1;
+    return (long long)timegm(&utc);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// HTTP caching helpers (RFC 9110/9111): validators and freshness for the
+// pre-rendered responses. Nothing here depends on the web framework.
+
+// Strong entity tag for a data version, e.g. "\"19a2c3d4e5f-1760000000123\"".
+// Versions count on from a process's boot time, so they name the same data
+// only among processes that share one line of publishes. The prefix is that
+// line's origin: this process's boot time, or its replication leader's (see
+// setETagOrigin()). A tag from another standalone process behind the same
+// load balancer, or from before a restart with the clock set back, never
+// matches a version that merely has the same number.
+std::string makeETag(unsigned long long version, std::string_view variant = {});
+
+// Replace the boot time with `origin` (e.g. a replication leader's boot time) so
+// every process serving the same data versions hands out the same tags. Safe
+// to call while serving, as a follower does when a new leader takes over.
+void setETagOrigin(unsigned long long origin);
+
+// Whether an If-None-Match header value matches `etag` (weak comparison,
+// handles lists and "*")
+bool etagMatches(std::string_view ifNoneMatch, std::string_view etag);
+
+// IMF-fixdate, e.g. "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string formatHttpDate(long long unixSeconds);
+
+// Parse an IMF-fixdate; returns -1 when malformed
+long long parseHttpDate(const std::string& value);
@@ -0,0 +1,148 @@
+#include "job_scheduler.h"
+
+#include <exception>
+#include <iostream>
+
+using namespace std;
+
+struct JobScheduler::Job {
+    string name;
+    Clock::duration interval;
+    Clock::duration phase;
+    Task task;
+
+    Clock::time_point due;
+    Clock::time_point lastRun;
+    uint64_t runs = 0;
+    uint64_t skipped = 0;
+    uint64_t failures = 0;
+    Histogram durationUs{LATENCY_BUCKETS_US};
+
+    // Boundaries since the epoch up to and including `t`
+    uint64_t boundaryIndex(Clock::time_point t) const {
+        return (uint64_t)((t.time_since_epoch() - phase) / interval);
+    }
+
+    // First boundary strictly after `t`
+    Clock::time_point boundaryAfter(Clock::time_point t) const {
+        return Clock::time_point(phase + interval * (boundaryIndex(t) + 1));
+    }
+};
+
+JobScheduler::JobScheduler() = default;
+
+JobScheduler::~JobScheduler() {
+    stop();
+}
+
+void JobScheduler::add(string name, Clock::duration interval, Task task, Clock::duration phase) {
+    auto job = make_unique<Job>();
+    job->name = move(name);
+    job->interval = interval;
+    job->phase = phase % interval;
+    job->task = move(task);
+
+    lock_guard<mutex> lock(mutex_);
+    jobs_.push_back(move(job));
+}
+
+void JobScheduler::start() {
+    lock_guard<mutex> lock(mutex_);
+    if(worker_.joinable() || stopping_) return;
+
+    Clock::time_point now = Clock::now();
+    for(size_t i = 0; i < jobs_.size(); i++) {
+        jobs_[i]->due = jobs_[i]->boundaryAfter(now);
+        queue_.push({jobs_[i]->due, i});
+    }
+    worker_ = thread(&JobScheduler::run, this);
+}
+
+void JobScheduler::stop() {
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    if(worker_.joinable() && worker_.get_id() != this_thread::get_id()) worker_.join();
+}
+
+bool JobScheduler::stopping() const {
+    lock_guard<mutex> lock(mutex_);
+    return stopping_;
+}
+
+bool JobScheduler::sleepFor(Clock::duration span) const {
+    unique_lock<mutex> lock(mutex_);
+    return !wake_.wait_for(lock, span, [this] { return stopping_; });
+}
+
+JobScheduler::Clock::time_point JobScheduler::nextRun(const string& name) const {
+    lock_guard<mutex> lock(mutex_);
+    for(const auto& job : jobs_) {
+        if(job->name == name) return job->due;
+    }
+    return Clock::time_point();
+}
+
+vector<JobScheduler::JobStats> JobScheduler::stats() const {
+    lock_guard<mutex> lock(mutex_);
+    vector<JobStats> out;
+    for(const auto& job : jobs_) {
+        JobStats s;
+        s.name = job->name;
+        s.interval = job->interval;
+        s.runs = job->runs;
+        s.skipped = job->skipped;
+        s.failures = job->failures;
+        s.durationUs = job->durationUs.read();
+        s.lastRun = job->lastRun;
+        s.nextRun = job->due;
+        out.push_back(move(s));
+    }
+    return out;
+}
+
+void JobScheduler::run() {
+    unique_lock<mutex> lock(mutex_);
+    while(!stopping_) {
+        if(queue_.empty()) {
+            wake_.wait(lock);
+            continue;
+        }
+        Due next = queue_.top();
+        if(Clock::now() < next.first) {
+            wake_.wait_until(lock, next.first);
+            continue;
+        }
+        queue_.pop();
+
+        Job& job = *jobs_[next.second];
+        JobTick tick;
+        tick.deadline = job.due;
+        tick.index = job.boundaryIndex(job.due);
+        tick.skipped = job.lastRun == Clock::time_point() ? 0 : tick.index - job.boundaryIndex(job.lastRun) - 1;
+
+        lock.unlock();
+        auto start = chrono::steady_clock::now();
+        bool failed = false;
+        try {
+            job.task(tick);
+        } catch(const exception& e) {
+            cerr << "❌ Job " << job.name << " failed: " << e.what() << endl;
+            failed = true;
+        }
+        auto elapsed = chrono::steady_clock::now() - start;
+        lock.lock();
+
+        job.runs++;
+        job.failures += failed;
+        job.durationUs.observe(chrono::duration_cast<chrono::microseconds>(elapsed).count());
+        job.lastRun = tick.deadline;
+
+        // The next boundary still ahead; any that passed during the run are skipped
+        job.due = job.boundaryAfter(max(Clock::now(), tick.deadline));
+        job.skipped += job.boundaryIndex(job.due) - tick.index - 1;
+        queue_.push({job.due, next.second});
+    }
+}
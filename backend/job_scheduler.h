@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "metrics.h"
+
+// One run of a periodic job
+struct JobTick {
+    std::chrono::system_clock::time_point deadline; // the boundary this run is for
+    uint64_t index = 0;     // boundaries since the epoch: deadline = index * interval + phase
+    uint64_t skipped = 0;   // boundaries missed since the previous run
+};
+
+// Runs periodic jobs on one thread, each at its own cadence. Deadlines sit on
+// wall-clock boundaries (a 5-minute job runs at :00, :05, ... plus its phase),
+// computed from the clock rather than by sleeping an interval after each run,
+// so they don't drift by the time the jobs take. A job that overruns skips the
+// boundaries that passed meanwhile instead of running late to catch up.
+// Jobs never overlap: a due job waits for the one running.
+class JobScheduler {
+public:
+    using Clock = std::chrono::system_clock;
+    using Task = std::function<void(const JobTick&)>;
+
+    // Per job, for /metrics and /health
+    struct JobStats {
+        std::string name;
+        Clock::duration interval;
+        uint64_t runs = 0;
+        uint64_t skipped = 0;       // boundaries missed because a job overran
+        uint64_t failures = 0;      // runs that threw
+        Histogram::Counts durationUs;
+        Clock::time_point lastRun;  // deadline of the last run (epoch if none)
+        Clock::time_point nextRun;
+    };
+
+    JobScheduler();
+    ~JobScheduler();
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    // Register a job before start(). It first runs at the first boundary after start().
+    void add(std::string name, Clock::duration interval, Task task, Clock::duration phase = Clock::duration::zero());
+
+    void start();
+
+    // Stop dispatching, wait for a running job to return, and wake every
+    // sleepFor(). Idempotent.
+    void stop();
+
+    bool stopping() const;
+
+    // Sleep that stop() cuts short, for loops outside the scheduler that
+    // should end with it. False if stopped.
+    bool sleepFor(Clock::duration span) const;
+
+    // Next deadline of a job (epoch before start() or if there is no such job)
+    Clock::time_point nextRun(const std::string& name) const;
+
+    std::vector<JobStats> stats() const;
+
+private:
+    struct Job;
+    using Due = std::pair<Clock::time_point, size_t>; // deadline, job
+
+    void run();
+
+    mutable std::mutex mutex_;
+    mutable std::condition_variable wake_;
+    std::vector<std::unique_ptr<Job>> jobs_;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> queue_;
+    bool stopping_ = false;
+    std::thread worker_;
+};
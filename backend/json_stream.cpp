@@ -0,0 +1,277 @@
+#include "json_stream.h"
+
+#include <charconv>
+
+using namespace std;
+
+namespace {
+
+int hexValue(char c) {
+    if(c >= '0' && c <= '9') return c - '0';
+    if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void appendUtf8(string& out, uint32_t cp) {
+    if(cp < 0x80) {
+        out += char(cp);
+    } else if(cp < 0x800) {
+        out += char(0xC0 | (cp >> 6));
+        out += char(0x80 | (cp & 0x3F));
+    } else if(cp < 0x10000) {
+        out += char(0xE0 | (cp >> 12));
+        out += char(0x80 | ((cp >> 6) & 0x3F));
+        out += char(0x80 | (cp & 0x3F));
+    } else {
+        out += char(0xF0 | (cp >> 18));
+        out += char(0x80 | ((cp >> 12) & 0x3F));
+        out += char(0x80 | ((cp >> 6) & 0x3F));
+        out += char(0x80 | (cp & 0x3F));
+    }
+}
+
+bool isNumberChar(char c) {
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+}
+
+} // namespace
+
+void JsonPushParser::reset() {
+    objects_.clear();
+    expect_ = Expect::Value;
+    token_ = Token::None;
+    buf_.clear();
+    escape_ = 0;
+    codepoint_ = 0;
+    highSurrogate_ = 0;
+    error_.clear();
+}
+
+bool JsonPushParser::fail(const char* message) {
+    if(error_.empty()) error_ = message;
+    return false;
+}
+
+bool JsonPushParser::feed(const char* data, size_t size) {
+    if(!error_.empty()) return false;
+
+    size_t i = 0;
+    while(i < size) {
+        if(token_ == Token::String || token_ == Token::Key) {
+            i += stringChars(data + i, size - i);
+            if(!error_.empty()) return false;
+            continue;
+        }
+        if(token_ == Token::Number) {
+            if(isNumberChar(data[i])) {
+                buf_ += data[i++];
+                continue;
+            }
+            if(!endNumber()) return false;
+        } else if(token_ == Token::Literal) {
+            if(data[i] >= 'a' && data[i] <= 'z' && buf_.size() < 5) {
+                buf_ += data[i++];
+                continue;
+            }
+            if(!endLiteral()) return false;
+        }
+
+        char c = data[i++];
+        if(c == ' ' || c == '\n' || c == '\r' || c == '\t') continue;
+        if(!structural(c)) return false;
+    }
+    return true;
+}
+
+bool JsonPushParser::finish() {
+    if(!error_.empty()) return false;
+    if(token_ == Token::Number && !endNumber()) return false;
+    if(token_ == Token::Literal && !endLiteral()) return false;
+    if(token_ != Token::None || expect_ != Expect::Done) return fail("unexpected end of input");
+    return true;
+}
+
+bool JsonPushParser::structural(char c) {
+    switch(expect_) {
+        case Expect::Done:
+            return fail("trailing characters after document");
+
+        case Expect::Colon:
+            if(c != ':') return fail("expected ':'");
+            expect_ = Expect::Value;
+            return true;
+
+        case Expect::CommaOrEnd:
+            if(c == ',') {
+                expect_ = objects_.back() ? Expect::Key : Expect::Value;
+                return true;
+            }
+            if(c == '}' && objects_.back()) {
+                objects_.pop_back();
+                return (handler_.endObject() || fail("aborted by handler")) && afterValue();
+            }
+            if(c == ']' && !objects_.back()) {
+                objects_.pop_back();
+                return (handler_.endArray() || fail("aborted by handler")) && afterValue();
+            }
+            return fail("expected ',' or end of container");
+
+        case Expect::KeyOrEnd:
+            if(c == '}') {
+                objects_.pop_back();
+                return (handler_.endObject() || fail("aborted by handler")) && afterValue();
+            }
+            [[fallthrough]];
+        case Expect::Key:
+            if(c != '"') return fail("expected object key");
+            token_ = Token::Key;
+            buf_.clear();
+            return true;
+
+        case Expect::ValueOrEnd:
+            if(c == ']') {
+                objects_.pop_back();
+                return (handler_.endArray() || fail("aborted by handler")) && afterValue();
+            }
+            [[fallthrough]];
+        case Expect::Value:
+            return beginValue(c);
+    }
+    return fail("invalid parser state");
+}
+
+bool JsonPushParser::beginValue(char c) {
+    switch(c) {
+        case '{':
+        case '[':
+            if(objects_.size() >= MAX_DEPTH) return fail("document nested too deeply");
+            objects_.push_back(c == '{');
+            expect_ = c == '{' ? Expect::KeyOrEnd : Expect::ValueOrEnd;
+            return (c == '{' ? handler_.startObject() : handler_.startArray()) || fail("aborted by handler");
+        case '"':
+            token_ = Token::String;
+            buf_.clear();
+            return true;
+        case 't':
+        case 'f':
+        case 'n':
+            token_ = Token::Literal;
+            buf_.assign(1, c);
+            return true;
+        default:
+            if(c == '-' || (c >= '0' && c <= '9')) {
+                token_ = Token::Number;
+                buf_.assign(1, c);
+                return true;
+            }
+            return fail("unexpected character");
+    }
+}
+
+bool JsonPushParser::afterValue() {
+    expect_ = objects_.empty() ? Expect::Done : Expect::CommaOrEnd;
+    return true;
+}
+
+bool JsonPushParser::endNumber() {
+    token_ = Token::None;
+    double value = 0;
+    const char* end = buf_.data() + buf_.size();
+    auto parsed = from_chars(buf_.data(), end, value);
+    if(parsed.ec != errc() || parsed.ptr != end) return fail("malformed number");
+    return (handler_.number(value) || fail("aborted by handler")) && afterValue();
+}
+
+bool JsonPushParser::endLiteral() {
+    token_ = Token::None;
+    bool ok;
+    if(buf_ == "true" || buf_ == "false") {
+        ok = handler_.boolean(buf_ == "true");
+    } else if(buf_ == "null") {
+        ok = handler_.null();
+    } else {
+        return fail("invalid literal");
+    }
+    return (ok || fail("aborted by handler")) && afterValue();
+}
+
+// Consume string characters up to and including the closing quote.
+// Returns the number of bytes used.
+size_t JsonPushParser::stringChars(const char* data, size_t size) {
+    size_t i = 0;
+    while(i < size) {
+        if(escape_ == 0) {
+            size_t start = i;
+            while(i < size && data[i] != '"' && data[i] != '\\' && (unsigned char)data[i] >= 0x20) i++;
+            buf_.append(data + start, i - start);
+            if(i == size) return i;
+
+            char c = data[i++];
+            if(c == '\\') {
+                escape_ = 1;
+                continue;
+            }
+            if(c != '"') {
+                fail("control character in string");
+                return i;
+            }
+
+            // Closing quote
+            Token finished = token_;
+            token_ = Token::None;
+            if(finished == Token::Key) {
+                if(!handler_.key(buf_)) fail("aborted by handler");
+                expect_ = Expect::Colon;
+            } else {
+                if(!handler_.string(buf_)) fail("aborted by handler");
+                else afterValue();
+            }
+            return i;
+        }
+
+        char c = data[i++];
+        if(escape_ == 1) {
+            escape_ = 0;
+            switch(c) {
+                case '"': buf_ += '"'; break;
+                case '\\': buf_ += '\\'; break;
+                case '/': buf_ += '/'; break;
+                case 'b': buf_ += '\b'; break;
+                case 'f': buf_ += '\f'; break;
+                case 'n': buf_ += '\n'; break;
+                case 'r': buf_ += '\r'; break;
+                case 't': buf_ += '\t'; break;
+                case 'u':
+                    escape_ = 2;
+                    codepoint_ = 0;
+                    break;
+                default:
+                    fail("invalid escape sequence");
+                    return i;
+            }
+            continue;
+        }
+
+        // \uXXXX
+        int digit = hexValue(c);
+        if(digit < 0) {
+            fail("invalid \\u escape");
+            return i;
+        }
+        codepoint_ = codepoint_ * 16 + digit;
+        if(++escape_ < 6) continue;
+
+        escape_ = 0;
+        if(codepoint_ >= 0xD800 && codepoint_ <= 0xDBFF) {
+            highSurrogate_ = codepoint_; // wait for the low half
+        } else if(codepoint_ >= 0xDC00 && codepoint_ <= 0xDFFF && highSurrogate_) {
+            appendUtf8(buf_, 0x10000 + ((highSurrogate_ - 0xD800) << 10) + (codepoint_ - 0xDC00));
+            highSurrogate_ = 0;
+        } else {
+            appendUtf8(buf_, codepoint_);
+            highSurrogate_ = 0;
+        }
+    }
+    return i;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// SAX events. Returning false from any of them stops the parse.
+class JsonHandler {
+public:
+    virtual ~JsonHandler() = default;
+
+    virtual bool startObject() { return true; }
+    virtual bool endObject() { return true; }
+    virtual bool startArray() { return true; }
+    virtual bool endArray() { return true; }
+    virtual bool key(std::string_view) { return true; }
+    virtual bool string(std::string_view) { return true; }
+    virtual bool number(double) { return true; }
+    virtual bool boolean(bool) { return true; }
+    virtual bool null() { return true; }
+};
+
+// Incremental JSON parser: the document can be fed in arbitrary chunks (as
+// they come off the network) and events are emitted as soon as each token is
+// complete. Only the token being parsed is buffered, never the document.
+// Numbers are reported as double, which is exact for CoinGecko's
+// millisecond timestamps.
+class JsonPushParser {
+public:
+    static constexpr size_t MAX_DEPTH = 64;
+
+    explicit JsonPushParser(JsonHandler& handler) : handler_(handler) {}
+
+    // Parse the next chunk. False on a syntax error or a handler abort.
+    bool feed(const char* data, size_t size);
+
+    // End of input: true if exactly one complete document was parsed
+    bool finish();
+
+    void reset();
+
+    const std::string& error() const { return error_; }
+
+private:
+    enum class Expect : uint8_t {
+        Value,          // document start, after ':' or after ',' in an array
+        ValueOrEnd,     // after '['
+        KeyOrEnd,       // after '{'
+        Key,            // after ',' in an object
+        Colon,
+        CommaOrEnd,
+        Done,
+    };
+
+    enum class Token : uint8_t { None, String, Key, Number, Literal };
+
+    bool fail(const char* message);
+    bool structural(char c);
+    bool beginValue(char c);
+    bool afterValue();
+    bool endNumber();
+    bool endLiteral();
+    size_t stringChars(const char* data, size_t size);
+
+    JsonHandler& handler_;
+    std::vector<bool> objects_;     // container stack: true = object, false = array
+    Expect expect_ = Expect::Value;
+    Token token_ = Token::None;
+    std::string buf_;               // current string/number/literal
+    uint8_t escape_ = 0;            // 0, 1 after '\', 2..5 while reading \u hex digits
+    uint32_t codepoint_ = 0;
+    uint32_t highSurrogate_ = 0;
+    std::string error_;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "history.h"
+
+// Market data model
+struct CoinData {
+    std::string id;
+    int rank;
+    std::string name;
+    std::string symbol;
+    std::string logo;
+    double price;
+    double change24h;
+    double marketCap;
+    double volume24h;
+    double circulatingSupply;
+    double totalSupply;
+    double maxSupply;
+    double ath;
+    double athChangePercentage;
+    std::string athDate;
+    std::vector<double> sparkline7d;
+
+    // Historical data: rolling (timestamp, price) window per chart period,
+    // shared with the previous snapshot's copy of this coin until written
+    SharedHistory historicalData;
+};
+
+struct GlobalStats {
+    double totalMarketCap;
+    double totalVolume;
+    double btcDominance;
+    int activeCryptocurrencies;
+    double marketCapChange24h;
+    double volumeChange24h;
+};
+
+struct TrendingCoin {
+    std::string id;
+    std::string name;
+    std::string symbol;
+    std::string logo;
+    int rank;
+};
+
+struct TrendingCategory {
+    std::string name;
+    std::string trend;
+};
@@ -0,0 +1,397 @@
+#include "market_snapshot.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+
+#include "history_query.h"
+
+using json = nlohmann::json;
+using namespace std;
+
+namespace {
+
+// Published snapshot. Only ever accessed through atomic_load/atomic_store.
+shared_ptr<const MarketSnapshot> publishedSnapshot = make_shared<const MarketSnapshot>();
+
+// Serializes writers so concurrent read-modify-publish cycles don't lose updates
+mutex writerMutex;
+
+PublishMetrics publishMetricsData;
+
+// See setFullPrecompressionRanks()
+atomic<int> fullPrecompressionRanks{0};
+
+// See setSearchNotes(); read by writers only, under writerMutex
+shared_ptr<const CoinNotes> searchNotes;
+
+// Changed coin bodies per render thread before another thread is worth starting
+const size_t RENDER_BATCH = 64;
+
+// Versions count on from the boot time in milliseconds rather than from 1.
+// Publishes are far rarer than one per millisecond, so a version (in an ETag
+// or a since= token) never names different data after a restart.
+unsigned long long firstVersion() {
+    return chrono::duration_cast<chrono::milliseconds>(chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+SnapshotPtr currentSnapshot() {
+    return atomic_load(&publishedSnapshot);
+}
+
+SnapshotPtr updateSnapshot(const function<void(MarketSnapshot&)>& mutate) {
+    auto waitStart = chrono::steady_clock::now();
+    lock_guard<mutex> lock(writerMutex);
+    auto holdStart = chrono::steady_clock::now();
+    publishMetricsData.lockWaitUs.observe(chrono::duration_cast<chrono::microseconds>(holdStart - waitStart).count());
+
+    SnapshotPtr previous = atomic_load(&publishedSnapshot);
+
+    // Copy the data but not the rendered responses - they are rebuilt below
+    auto next = make_shared<MarketSnapshot>();
+    next->version = previous->version ? previous->version + 1 : firstVersion();
+    next->publishedAt = chrono::duration_cast<chrono::seconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    next->coins = previous->coins;
+    next->index = previous->index;
+    next->globalStats = previous->globalStats;
+    next->trendingCoins = previous->trendingCoins;
+    next->trendingCategories = previous->trendingCategories;
+    next->changes = previous->changes;
+    next->fx = previous->fx;
+
+    mutate(*next);
+    next->index.rebuild(next->coins); // writers may have added, removed or reordered coins
+    next->search = SearchIndex::update(previous->search, next->coins, searchNotes);
+    next->changes.record(previous->version, next->version, previous->coins, previous->index, next->coins);
+    next->orders.rebuild(next->coins);
+    next->table.rebuild(next->coins);
+    next->stats = computeMarketStats(next->table);
+    renderResponses(*next, previous.get());
+
+    SnapshotPtr frozen = move(next);
+    atomic_store(&publishedSnapshot, frozen);
+    publishMetricsData.lockHoldUs.observe(
+        chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - holdStart).count());
+    return frozen;
+}
+
+const PublishMetrics& publishMetrics() {
+    return publishMetricsData;
+}
+
+ResponseMemo::Body ResponseMemo::find(const string& key) const {
+    lock_guard<mutex> lock(mutex_);
+    auto it = entries_.find(key);
+    return it == entries_.end() ? nullptr : it->second;
+}
+
+ResponseMemo::Body ResponseMemo::insert(const string& key, Body body) {
+    lock_guard<mutex> lock(mutex_);
+    if(entries_.size() >= MAX_ENTRIES) return body;
+    return entries_.emplace(key, move(body)).first->second;
+}
+
+CurrencyViews::View CurrencyViews::find(string_view currency) const {
+    lock_guard<mutex> lock(mutex_);
+    auto it = views_.find(currency);
+    return it == views_.end() ? nullptr : it->second;
+}
+
+CurrencyViews::View CurrencyViews::insert(const string& currency, View view) {
+    lock_guard<mutex> lock(mutex_);
+    return views_.emplace(currency, move(view)).first->second;
+}
+
+SnapshotPtr currencyView(const SnapshotPtr& snapshot, string_view currency) {
+    if(currency == snapshot->currency) return snapshot;
+    if(SnapshotPtr view = snapshot->views.find(currency)) return view;
+
+    double rate;
+    if(!snapshot->fx.rate(currency, rate)) return nullptr;
+
+    auto view = make_shared<MarketSnapshot>();
+    view->version = snapshot->version;
+    view->publishedAt = snapshot->publishedAt;
+    view->currency = string(currency);
+    view->quoteRate = rate;
+    view->coins = snapshot->coins;
+    view->index = snapshot->index;
+    view->search = snapshot->search;
+    view->orders = snapshot->orders; // a positive rate keeps every order
+    view->changes = snapshot->changes;
+    view->fx = snapshot->fx;
+    view->trendingCoins = snapshot->trendingCoins;
+    view->trendingCategories = snapshot->trendingCategories;
+
+    // The money columns convert column by column, one vectorized loop each
+    MarketTable& table = view->table;
+    table = snapshot->table;
+    scaleValues(table.price.data(), table.size(), rate);
+    scaleValues(table.marketCap.data(), table.size(), rate);
+    scaleValues(table.volume24h.data(), table.size(), rate);
+    for(size_t i = 0; i < view->coins.size(); i++) {
+        CoinData& coin = view->coins[i];
+        coin.price = table.price[i];
+        coin.marketCap = table.marketCap[i];
+        coin.volume24h = table.volume24h[i];
+        coin.ath *= rate;
+        scaleValues(coin.sparkline7d.data(), coin.sparkline7d.size(), rate);
+        coin.historicalData = SharedHistory();
+    }
+    view->stats = snapshot->stats; // changes and cap weights only, which a rate leaves as they are
+
+    view->globalStats = snapshot->globalStats;
+    view->globalStats.totalMarketCap *= rate;
+    view->globalStats.totalVolume *= rate;
+
+    return snapshot->views.insert(string(currency), move(view));
+}
+
+CoinData quotedCoin(const MarketSnapshot& base, const MarketSnapshot& view, size_t slot) {
+    CoinData coin = view.coins[slot];
+    coin.historicalData = &view == &base ? base.coins[slot].historicalData :
+                                           base.coins[slot].historicalData.scaled(view.quoteRate);
+    return coin;
+}
+
+const CoinData* findCoin(const MarketSnapshot& snapshot, string_view idOrSymbol, size_t* slot) {
+    size_t found = snapshot.index.findById(snapshot.coins, idOrSymbol);
+    if(found == CoinIndex::npos) {
+        found = snapshot.index.findBySymbol(snapshot.coins, idOrSymbol);
+    }
+    if(found == CoinIndex::npos) return nullptr;
+
+    if(slot) *slot = found;
+    return &snapshot.coins[found];
+}
+
+void setFullPrecompressionRanks(int rank) {
+    fullPrecompressionRanks = rank;
+}
+
+void setSearchNotes(shared_ptr<const CoinNotes> notes) {
+    lock_guard<mutex> lock(writerMutex);
+    searchNotes = move(notes);
+}
+
+namespace {
+
+// Compress `body`, or reuse `prior` when it already holds the same bytes
+EncodedBody encodeOrReuse(string body, const EncodedBody* prior) {
+    if(prior && prior->identity() == body) {
+        return *prior;
+    }
+    return EncodedBody::encode(move(body));
+}
+
+// Whether every field shown in /api/coins is equal
+bool sameMarketData(const CoinData& a, const CoinData& b) {
+    return a.id == b.id && a.rank == b.rank && a.name == b.name && a.symbol == b.symbol && a.logo == b.logo &&
+           a.price == b.price && a.change24h == b.change24h && a.marketCap == b.marketCap &&
+           a.volume24h == b.volume24h && a.circulatingSupply == b.circulatingSupply &&
+           a.totalSupply == b.totalSupply && a.maxSupply == b.maxSupply && a.ath == b.ath &&
+           a.athChangePercentage == b.athChangePercentage && a.athDate == b.athDate &&
+           a.sparkline7d == b.sparkline7d;
+}
+
+bool sameCoinList(const vector<CoinData>& a, const vector<CoinData>& b) {
+    if(a.size() != b.size()) return false;
+    for(size_t i = 0; i < a.size(); i++) {
+        if(!sameMarketData(a[i], b[i])) return false;
+    }
+    return true;
+}
+
+shared_ptr<const EncodedBody> renderCoinDetail(const CoinData& coin) {
+    string body = encodeCoinDetail(coin, Representation());
+    int fullRanks = fullPrecompressionRanks.load();
+    bool full = fullRanks <= 0 || (coin.rank > 0 && coin.rank <= fullRanks);
+    return make_shared<const EncodedBody>(full ? EncodedBody::encode(move(body)) : EncodedBody::encodeFast(move(body)));
+}
+
+} // namespace
+
+void renderResponses(MarketSnapshot& snapshot, const MarketSnapshot* previous) {
+    ResponseCache& out = snapshot.responses;
+    const ResponseCache* prior = previous ? &previous->responses : nullptr;
+    out.coinJson.clear();
+    out.coinJson.reserve(snapshot.coins.size());
+
+    // Comparing fields is far cheaper than rendering, so unchanged coins (most
+    // of them while history is being backfilled one coin at a time) cost a
+    // lookup and a comparison instead of a JSON dump
+    vector<size_t> changed;
+    for(size_t i = 0; i < snapshot.coins.size(); i++) {
+        const CoinData& coin = snapshot.coins[i];
+        shared_ptr<const EncodedBody> detail;
+        if(prior) {
+            size_t slot = previous->index.findById(previous->coins, coin.id);
+            if(slot != CoinIndex::npos && slot < prior->coinJson.size()) {
+                const CoinData& before = previous->coins[slot];
+                if(coin.historicalData.sharesWith(before.historicalData) && sameMarketData(coin, before)) {
+                    detail = prior->coinJson[slot];
+                }
+            }
+        }
+        if(!detail) changed.push_back(i);
+        out.coinJson.push_back(move(detail));
+    }
+
+    // Changed coins render independently, so a live tick over a large universe
+    // is spread across cores
+    size_t workers = min<size_t>(max(1u, thread::hardware_concurrency()), changed.size() / RENDER_BATCH + 1);
+    auto renderShare = [&](size_t worker) {
+        for(size_t k = worker; k < changed.size(); k += workers) {
+            out.coinJson[changed[k]] = renderCoinDetail(snapshot.coins[changed[k]]);
+        }
+    };
+    vector<thread> pool;
+    for(size_t w = 1; w < workers; w++) pool.emplace_back(renderShare, w);
+    renderShare(0);
+    for(auto& t : pool) t.join();
+
+    if(prior && sameCoinList(snapshot.coins, previous->coins)) {
+        out.coinsJson = prior->coinsJson;
+    } else {
+        out.coinsJson = encodeOrReuse(encodeCoinList(snapshot.coins, Representation()),
+                                      prior ? &prior->coinsJson : nullptr);
+    }
+    out.globalJson = encodeOrReuse(globalToJson(snapshot.globalStats).dump(), prior ? &prior->globalJson : nullptr);
+    out.trendingJson = encodeOrReuse(trendingToJson(snapshot.trendingCoins, snapshot.trendingCategories).dump(),
+                                     prior ? &prior->trendingJson : nullptr);
+    out.statsJson = encodeOrReuse(statsToJson(snapshot.stats, snapshot.coins).dump(), prior ? &prior->statsJson : nullptr);
+}
+
+string encodeCoinList(const vector<CoinData>& coins, const Representation& rep) {
+    WireWriter out(rep.format);
+    out.beginArray(coins.size());
+    for(const auto& coin : coins) {
+        out.beginMap(COIN_FIELD_COUNT);
+        writeCoinFields(out, coin, ALL_COIN_FIELDS, rep.layout);
+        out.endMap();
+    }
+    out.endArray();
+    return out.take();
+}
+
+string encodeCoinDetail(const CoinData& coin, const Representation& rep) {
+    size_t periods = 0;
+    for(const auto& spec : PERIODS) {
+        if(coin.historicalData.has(spec.period)) periods++;
+    }
+
+    WireWriter out(rep.format);
+    out.beginMap(COIN_FIELD_COUNT + 1);
+    writeCoinFields(out, coin, ALL_COIN_FIELDS, rep.layout);
+    out.key("historicalData");
+    out.beginMap(periods);
+    for(const auto& spec : PERIODS) {
+        if(!coin.historicalData.has(spec.period)) continue;
+        out.key(spec.key);
+        writeSeries(out, coin.historicalData.spans(spec.period), rep.layout);
+    }
+    out.endMap();
+    out.endMap();
+    return out.take();
+}
+
+// Convert coin data to JSON
+json coinToJson(const CoinData& coin, bool includeHistorical) {
+    json j = coinFieldsToJson(coin, ALL_COIN_FIELDS);
+
+    if(includeHistorical) {
+        json historical = json::object();
+        for(const auto& spec : PERIODS) {
+            if(!coin.historicalData.has(spec.period)) continue;
+
+            // The ring is read as (at most) two contiguous runs, oldest first
+            CoinHistory::Spans spans = coin.historicalData.spans(spec.period);
+            json periodData = json::array();
+            for(int run = 0; run < 2; run++) {
+                for(size_t k = 0; k < spans.lengths[run]; k++) {
+                    periodData.push_back({
+                        {"time", spans.times[run][k]},
+                        {"price", spans.prices[run][k]}
+                    });
+                }
+            }
+            historical[spec.key] = periodData;
+        }
+        j["historicalData"] = historical;
+    }
+
+    return j;
+}
+
+// Convert global stats to JSON
+json globalToJson(const GlobalStats& stats) {
+    json j;
+    j["totalMarketCap"] = stats.totalMarketCap;
+    j["totalVolume"] = stats.totalVolume;
+    j["btcDominance"] = stats.btcDominance;
+    j["activeCryptocurrencies"] = stats.activeCryptocurrencies;
+    j["marketCapChange24h"] = stats.marketCapChange24h;
+    return j;
+}
+
+// Convert trending coins and categories to JSON
+json trendingToJson(const vector<TrendingCoin>& coins, const vector<TrendingCategory>& categories) {
+    json j;
+
+    json coinsJson = json::array();
+    for(const auto& tc : coins) {
+        json coin;
+        coin["id"] = tc.id;
+        coin["name"] = tc.name;
+        coin["symbol"] = tc.symbol;
+        coin["logo"] = tc.logo;
+        coin["rank"] = tc.rank;
+        coinsJson.push_back(coin);
+    }
+    j["coins"] = coinsJson;
+
+    json categoriesJson = json::array();
+    for(const auto& cat : categories) {
+        json c;
+        c["name"] = cat.name;
+        c["trend"] = cat.trend;
+        categoriesJson.push_back(c);
+    }
+    j["categories"] = categoriesJson;
+
+    return j;
+}
+
+json statsToJson(const MarketStats& stats, const vector<CoinData>& coins) {
+    auto movers = [&](const vector<uint32_t>& slots) {
+        json list = json::array();
+        for(uint32_t slot : slots) {
+            const CoinData& coin = coins[slot];
+            list.push_back({
+                {"id", coin.id},
+                {"rank", coin.rank},
+                {"symbol", coin.symbol},
+                {"name", coin.name},
+                {"logo", coin.logo},
+                {"price", coin.price},
+                {"change24h", coin.change24h}
+            });
+        }
+        return list;
+    };
+
+    json j;
+    j["coins"] = stats.coins;
+    j["gainers"] = movers(stats.gainers);
+    j["losers"] = movers(stats.losers);
+    j["meanChange24h"] = stats.meanChange24h;
+    j["dispersion24h"] = stats.dispersion24h;
+    j["volumeWeightedChange24h"] = stats.volumeWeightedChange24h;
+    j["marketCapWeightedChange24h"] = stats.marketCapWeightedChange24h;
+    j["marketCapIndex"] = stats.marketCapIndex;
+    return j;
+}
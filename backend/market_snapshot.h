@@ -0,0 +1,176 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <nlohmann/json.hpp>
+
+#include "change_log.h"
+#include "coin_index.h"
+#include "coin_query.h"
+#include "compression.h"
+#include "currency.h"
+#include "search_index.h"
+#include "market_data.h"
+#include "market_table.h"
+#include "metrics.h"
+#include "wire_format.h"
+
+// Pre-serialized responses, rendered and compressed once per data version.
+// Handlers hand these bytes out instead of rebuilding JSON on every hit.
+struct ResponseCache {
+    EncodedBody coinsJson;
+    // Detail body per slot, parallel to MarketSnapshot::coins. Shared with the
+    // previous version for coins that didn't change.
+    std::vector<std::shared_ptr<const EncodedBody>> coinJson;
+    EncodedBody globalJson;
+    EncodedBody trendingJson;
+    EncodedBody statsJson;
+};
+
+// Responses rendered on demand, because they depend on request parameters,
+// and kept for the life of one data version. Bounded: once full, further
+// results are still served but not kept.
+class ResponseMemo {
+public:
+    using Body = std::shared_ptr<const EncodedBody>;
+
+    // Copying or assigning a snapshot leaves its memo empty: what was
+    // rendered belongs to the data it was rendered from
+    ResponseMemo() = default;
+    ResponseMemo(const ResponseMemo&) {}
+    ResponseMemo& operator=(const ResponseMemo&) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        return *this;
+    }
+
+    // The body kept under `key`, or null
+    Body find(const std::string& key) const;
+
+    // Keep `body` under `key` unless full. Returns the kept body, which is an
+    // earlier one if a concurrent request stored the key first.
+    Body insert(const std::string& key, Body body);
+
+private:
+    static constexpr size_t MAX_ENTRIES = 4096;
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, Body> entries_;
+};
+
+struct MarketSnapshot;
+
+// A snapshot's conversions into other quote currencies (see currencyView()),
+// built on first use. Like ResponseMemo, copies start out empty.
+class CurrencyViews {
+public:
+    using View = std::shared_ptr<const MarketSnapshot>;
+
+    CurrencyViews() = default;
+    CurrencyViews(const CurrencyViews&) {}
+    CurrencyViews& operator=(const CurrencyViews&) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        views_.clear();
+        return *this;
+    }
+
+    View find(std::string_view currency) const;
+
+    // Keep `view` unless a concurrent request stored one first; returns the kept one
+    View insert(const std::string& currency, View view);
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, View, std::less<>> views_;
+};
+
+// Immutable view of all market data at one data version.
+// Writers build the next snapshot off to the side and publish it with a
+// single atomic pointer swap; readers keep whatever snapshot they loaded
+// alive for as long as they need it and never wait on a writer.
+struct MarketSnapshot {
+    unsigned long long version = 0; // increases by one per publish, unique across restarts
+    long long publishedAt = 0; // unix seconds, used as Last-Modified
+    std::vector<CoinData> coins;
+    CoinIndex index; // id/symbol -> slot in coins, rebuilt on every publish
+    CoinOrders orders; // /api/coins sort orders, rebuilt on every publish
+    MarketTable table; // numeric columns of coins, rebuilt on every publish
+    MarketStats stats; // /api/stats aggregates over table
+    std::shared_ptr<const SearchIndex> search; // /api/search, shared until the coin list changes
+    ChangeLog changes; // what recent versions changed, for ?since= requests
+    FxRates fx; // USD to other quote currencies, refreshed every live tick
+    std::string currency = "usd"; // of every money field; only currency views hold another
+    double quoteRate = 1; // currency units per USD
+    GlobalStats globalStats = {};
+    std::vector<TrendingCoin> trendingCoins;
+    std::vector<TrendingCategory> trendingCategories;
+    ResponseCache responses;
+    mutable ResponseMemo memo; // the parts readers add to
+    mutable CurrencyViews views;
+};
+
+using SnapshotPtr = std::shared_ptr<const MarketSnapshot>;
+
+// Resolve a coin by id, falling back to its ticker symbol (e.g. "btc").
+// Returns nullptr when neither matches.
+const CoinData* findCoin(const MarketSnapshot& snapshot, std::string_view idOrSymbol, size_t* slot = nullptr);
+
+// `snapshot` with every money field (prices, market caps, volumes, ATHs,
+// sparklines, global totals) converted to `currency` (lower case), built
+// once per (currency, version) and kept with the snapshot. Percentages,
+// supplies, sort orders and the change log carry over unchanged. Chart
+// histories are left empty - see quotedCoin(). Returns `snapshot` itself for
+// its own currency, and null for a currency without a rate.
+SnapshotPtr currencyView(const SnapshotPtr& snapshot, std::string_view currency);
+
+// Coin `slot` of a currency view of `base`, with its chart history converted
+// as well, for rendering its detail or history
+CoinData quotedCoin(const MarketSnapshot& base, const MarketSnapshot& view, size_t slot);
+
+// Current published snapshot (never null; version 0 is the empty startup snapshot)
+SnapshotPtr currentSnapshot();
+
+// Copy the current snapshot, apply `mutate` to the copy, render its responses
+// and publish it as the next version. Writers are serialized against each
+// other; readers are never blocked. Returns the published snapshot.
+SnapshotPtr updateSnapshot(const std::function<void(MarketSnapshot&)>& mutate);
+
+// Writer lock of updateSnapshot(), microseconds: time spent waiting for it,
+// and time held (copy, mutate, render and publish)
+struct PublishMetrics {
+    Histogram lockWaitUs{LATENCY_BUCKETS_US};
+    Histogram lockHoldUs{LATENCY_BUCKETS_US};
+};
+
+const PublishMetrics& publishMetrics();
+
+// Render every payload of `snapshot` into snapshot.responses. Payloads whose
+// bytes are unchanged from `previous` reuse its compressed variants; coins
+// whose data is unchanged aren't re-rendered at all.
+void renderResponses(MarketSnapshot& snapshot, const MarketSnapshot* previous = nullptr);
+
+// Detail bodies of coins ranked below `rank` (or unranked) are encoded with
+// EncodedBody::encodeFast instead of every coding at full level, so a large
+// universe renders in time linear in its size. 0 (the default) = no limit.
+void setFullPrecompressionRanks(int rank);
+
+// Coin descriptions for /api/search to index next to names and symbols.
+// Takes effect (re-indexing every coin) at the next publish.
+void setSearchNotes(std::shared_ptr<const CoinNotes> notes);
+
+// Bodies written straight from the data in any representation: the
+// /api/coins list and the /api/coin/:id detail (history per period)
+std::string encodeCoinList(const std::vector<CoinData>& coins, const Representation& rep);
+std::string encodeCoinDetail(const CoinData& coin, const Representation& rep);
+
+// JSON builders
+nlohmann::json coinToJson(const CoinData& coin, bool includeHistorical = false);
+nlohmann::json globalToJson(const GlobalStats& stats);
+nlohmann::json trendingToJson(const std::vector<TrendingCoin>& coins,
+                              const std::vector<TrendingCategory>& categories);
+nlohmann::json statsToJson(const MarketStats& stats, const std::vector<CoinData>& coins);
@@ -0,0 +1,178 @@
+#include "market_table.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define CRYPTOLIZARD_X86_KERNELS 1
+#endif
+
+using namespace std;
+
+namespace {
+
+void sumScalar(const MarketTable& t, size_t begin, size_t end, ColumnSums& out) {
+    // Accumulate in locals: stores through `out` could alias the columns
+    const double* change = t.change24h.data();
+    const double* volume = t.volume24h.data();
+    const double* marketCap = t.marketCap.data();
+    ColumnSums s = out;
+    for(size_t i = begin; i < end; i++) {
+        double c = change[i];
+        if(!isfinite(c)) continue;
+        s.changeCount += 1;
+        s.changeSum += c;
+        s.changeSquares += c * c;
+
+        double v = volume[i];
+        if(v > 0) {
+            s.volume += v;
+            s.volumeChange += v * c;
+        }
+
+        double m = marketCap[i];
+        double growth = 1 + c * 0.01;
+        if(m > 0 && growth > 0) {
+            s.cap += m;
+            s.capChange += m * c;
+            s.capBefore += m / growth;
+        }
+    }
+    out = s;
+}
+
+#ifdef CRYPTOLIZARD_X86_KERNELS
+
+__attribute__((target("avx2"))) double horizontalSum(__m256d v) {
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+}
+
+// Same sums as sumScalar, four coins per step. Masks replace the branches:
+// a lane that fails a test contributes zeros.
+__attribute__((target("avx2"))) void sumAvx2(const MarketTable& t, ColumnSums& s) {
+    const size_t n = t.size();
+    const size_t vectorEnd = n - n % 4;
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d one = _mm256_set1_pd(1.0);
+    const __m256d percent = _mm256_set1_pd(0.01);
+    const __m256d infinity = _mm256_set1_pd(INFINITY);
+
+    __m256d count = zero, sum = zero, squares = zero;
+    __m256d volume = zero, volumeChange = zero;
+    __m256d cap = zero, capChange = zero, capBefore = zero;
+
+    const double* change = t.change24h.data();
+    const double* volumes = t.volume24h.data();
+    const double* caps = t.marketCap.data();
+    for(size_t i = 0; i < vectorEnd; i += 4) {
+        __m256d c = _mm256_loadu_pd(change + i);
+        __m256d finite = _mm256_cmp_pd(_mm256_andnot_pd(_mm256_set1_pd(-0.0), c), infinity, _CMP_LT_OQ);
+        c = _mm256_and_pd(c, finite);
+        count = _mm256_add_pd(count, _mm256_and_pd(one, finite));
+        sum = _mm256_add_pd(sum, c);
+        squares = _mm256_add_pd(squares, _mm256_mul_pd(c, c));
+
+        __m256d v = _mm256_loadu_pd(volumes + i);
+        v = _mm256_and_pd(v, _mm256_and_pd(finite, _mm256_cmp_pd(v, zero, _CMP_GT_OQ)));
+        volume = _mm256_add_pd(volume, v);
+        volumeChange = _mm256_add_pd(volumeChange, _mm256_mul_pd(v, c));
+
+        __m256d m = _mm256_loadu_pd(caps + i);
+        __m256d growth = _mm256_add_pd(one, _mm256_mul_pd(c, percent));
+        __m256d counted = _mm256_and_pd(finite, _mm256_and_pd(_mm256_cmp_pd(m, zero, _CMP_GT_OQ),
+                                                               _mm256_cmp_pd(growth, zero, _CMP_GT_OQ)));
+        m = _mm256_and_pd(m, counted);
+        growth = _mm256_blendv_pd(one, growth, counted);
+        cap = _mm256_add_pd(cap, m);
+        capChange = _mm256_add_pd(capChange, _mm256_mul_pd(m, c));
+        capBefore = _mm256_add_pd(capBefore, _mm256_div_pd(m, growth));
+    }
+
+    s.changeCount = horizontalSum(count);
+    s.changeSum = horizontalSum(sum);
+    s.changeSquares = horizontalSum(squares);
+    s.volume = horizontalSum(volume);
+    s.volumeChange = horizontalSum(volumeChange);
+    s.cap = horizontalSum(cap);
+    s.capChange = horizontalSum(capChange);
+    s.capBefore = horizontalSum(capBefore);
+    sumScalar(t, vectorEnd, n, s);
+}
+
+#endif
+
+// The `count` slots with a finite change, ordered by `before`
+template<typename Compare>
+vector<uint32_t> topByChange(const MarketTable& t, size_t count, Compare before) {
+    vector<uint32_t> slots;
+    slots.reserve(t.size());
+    for(size_t i = 0; i < t.size(); i++) {
+        if(isfinite(t.change24h[i])) slots.push_back((uint32_t)i);
+    }
+    count = min(count, slots.size());
+    partial_sort(slots.begin(), slots.begin() + count, slots.end(), [&](uint32_t a, uint32_t b) {
+        return before(t.change24h[a], t.change24h[b]) || (t.change24h[a] == t.change24h[b] && a < b);
+    });
+    slots.resize(count);
+    return slots;
+}
+
+} // namespace
+
+void MarketTable::rebuild(const vector<CoinData>& coins) {
+    const size_t n = coins.size();
+    price.resize(n);
+    change24h.resize(n);
+    marketCap.resize(n);
+    volume24h.resize(n);
+    for(size_t i = 0; i < n; i++) {
+        price[i] = coins[i].price;
+        change24h[i] = coins[i].change24h;
+        marketCap[i] = coins[i].marketCap;
+        volume24h[i] = coins[i].volume24h;
+    }
+}
+
+SimdKernel bestKernel() {
+#ifdef CRYPTOLIZARD_X86_KERNELS
+    static const SimdKernel best = __builtin_cpu_supports("avx2") ? SimdKernel::Avx2 : SimdKernel::Scalar;
+    return best;
+#else
+    return SimdKernel::Scalar;
+#endif
+}
+
+const char* kernelName(SimdKernel kernel) {
+    return kernel == SimdKernel::Avx2 ? "avx2" : "scalar";
+}
+
+ColumnSums sumColumns(const MarketTable& table, SimdKernel kernel) {
+    ColumnSums sums;
+#ifdef CRYPTOLIZARD_X86_KERNELS
+    if(kernel == SimdKernel::Avx2 && bestKernel() == SimdKernel::Avx2) {
+        sumAvx2(table, sums);
+        return sums;
+    }
+#endif
+    sumScalar(table, 0, table.size(), sums);
+    return sums;
+}
+
+MarketStats computeMarketStats(const MarketTable& table, SimdKernel kernel) {
+    MarketStats stats;
+    stats.coins = table.size();
+    stats.gainers = topByChange(table, MarketStats::TOP_COUNT, [](double a, double b) { return a > b; });
+    stats.losers = topByChange(table, MarketStats::TOP_COUNT, [](double a, double b) { return a < b; });
+
+    ColumnSums s = sumColumns(table, kernel);
+    auto ratio = [](double num, double den) { return den > 0 ? num / den : NAN; };
+    stats.meanChange24h = ratio(s.changeSum, s.changeCount);
+    double variance = ratio(s.changeSquares, s.changeCount) - stats.meanChange24h * stats.meanChange24h;
+    stats.dispersion24h = isnan(variance) ? NAN : sqrt(max(0.0, variance));
+    stats.volumeWeightedChange24h = ratio(s.volumeChange, s.volume);
+    stats.marketCapWeightedChange24h = ratio(s.capChange, s.cap);
+    stats.marketCapIndex = 100 * ratio(s.cap, s.capBefore);
+    return stats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "market_data.h"
+
+// The numeric market fields of a coin list as struct-of-arrays columns,
+// parallel to MarketSnapshot::coins. Scanning one field walks one dense
+// array instead of a CoinData (strings, sparkline, history) per coin.
+// Rebuilt on every publish; values are copied as-is, NaN included.
+struct MarketTable {
+    std::vector<double> price;
+    std::vector<double> change24h;
+    std::vector<double> marketCap;
+    std::vector<double> volume24h;
+
+    size_t size() const { return price.size(); }
+
+    void rebuild(const std::vector<CoinData>& coins);
+};
+
+// Implementations of the column kernels
+enum class SimdKernel : uint8_t {
+    Scalar,
+    Avx2,
+};
+
+// AVX2 when this CPU has it, scalar otherwise
+SimdKernel bestKernel();
+const char* kernelName(SimdKernel kernel);
+
+// One pass over change24h, volume24h and marketCap. Coins without a finite
+// change are left out entirely; volumes and caps only count when positive.
+struct ColumnSums {
+    double changeCount = 0, changeSum = 0, changeSquares = 0;
+    double volume = 0, volumeChange = 0;              // sum v, sum v*c
+    double cap = 0, capChange = 0, capBefore = 0;     // sum m, sum m*c, sum m/(1+c/100)
+};
+
+ColumnSums sumColumns(const MarketTable& table, SimdKernel kernel = bestKernel());
+
+// /api/stats: market-wide aggregates, computed once per data version
+struct MarketStats {
+    static constexpr size_t TOP_COUNT = 10;
+
+    size_t coins = 0;
+    std::vector<uint32_t> gainers; // slots, biggest 24h rise first
+    std::vector<uint32_t> losers;  // slots, biggest 24h fall first
+    double meanChange24h = 0;
+    double dispersion24h = 0;              // standard deviation of change24h across coins
+    double volumeWeightedChange24h = 0;
+    double marketCapWeightedChange24h = 0;
+    double marketCapIndex = 0;             // cap-weighted level, 100 = the same coins 24h ago
+};
+
+// NaN marks an aggregate with nothing to aggregate
+MarketStats computeMarketStats(const MarketTable& table, SimdKernel kernel = bestKernel());
@@ -0,0 +1,98 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+
+using namespace std;
+
+const vector<uint64_t> LATENCY_BUCKETS_US = {100,    250,    500,     1000,    2500,    5000,    10000,   25000,
+                                             50000,  100000, 250000,  500000,  1000000, 2500000, 5000000, 10000000};
+const vector<uint64_t> SIZE_BUCKETS_BYTES = {256,    1024,    4096,     16384,   65536,
+                                             262144, 1048576, 4194304,  16777216};
+
+namespace {
+
+void appendNumber(string& out, double value) {
+    if(isnan(value)) {
+        out += "NaN";
+    } else if(isinf(value)) {
+        out += value > 0 ? "+Inf" : "-Inf";
+    } else {
+        // Counts print as integers rather than the shortest form ("4e+05")
+        char buffer[32];
+        auto result = value == floor(value) && fabs(value) < 1e15
+                          ? to_chars(buffer, buffer + sizeof(buffer), (long long)value)
+                          : to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, result.ptr);
+    }
+}
+
+} // namespace
+
+Histogram::Histogram(const vector<uint64_t>& bounds)
+    : bounds_(bounds), buckets_(new atomic<uint64_t>[bounds.size() + 1]) {
+    for(size_t i = 0; i <= bounds_.size(); i++) buckets_[i].store(0, memory_order_relaxed);
+}
+
+void Histogram::observe(uint64_t value) {
+    size_t bucket = lower_bound(bounds_.begin(), bounds_.end(), value) - bounds_.begin();
+    buckets_[bucket].fetch_add(1, memory_order_relaxed);
+    sum_.fetch_add(value, memory_order_relaxed);
+    count_.fetch_add(1, memory_order_relaxed);
+}
+
+Histogram::Counts Histogram::read() const {
+    Counts counts;
+    counts.bounds = bounds_;
+    counts.buckets.resize(bounds_.size() + 1);
+    for(size_t i = 0; i <= bounds_.size(); i++) counts.buckets[i] = buckets_[i].load(memory_order_relaxed);
+    counts.sum = sum_.load(memory_order_relaxed);
+    // Concurrent observations may land between the loads; keep the series
+    // consistent by deriving the count from the buckets that were read
+    for(uint64_t n : counts.buckets) counts.count += n;
+    return counts;
+}
+
+void MetricsText::family(const char* name, const char* type, const char* help) {
+    out_ += "# HELP ";
+    out_ += name;
+    out_ += ' ';
+    out_ += help;
+    out_ += "\n# TYPE ";
+    out_ += name;
+    out_ += ' ';
+    out_ += type;
+    out_ += '\n';
+}
+
+void MetricsText::sample(const char* name, const string& labels, double value) {
+    out_ += name;
+    if(!labels.empty()) {
+        out_ += '{';
+        out_ += labels;
+        out_ += '}';
+    }
+    out_ += ' ';
+    appendNumber(out_, value);
+    out_ += '\n';
+}
+
+void MetricsText::histogram(const char* name, const string& labels, const Histogram::Counts& counts, double scale) {
+    const string bucketName = string(name) + "_bucket";
+    const string prefix = labels.empty() ? "" : labels + ",";
+
+    uint64_t cumulative = 0;
+    for(size_t i = 0; i < counts.buckets.size(); i++) {
+        cumulative += counts.buckets[i];
+        string le;
+        if(i < counts.bounds.size()) {
+            appendNumber(le, counts.bounds[i] / scale);
+        } else {
+            le = "+Inf";
+        }
+        sample(bucketName.c_str(), prefix + "le=\"" + le + "\"", (double)cumulative);
+    }
+    sample((string(name) + "_sum").c_str(), labels, counts.sum / scale);
+    sample((string(name) + "_count").c_str(), labels, (double)counts.count);
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Bucket bounds shared by the histograms that use them
+extern const std::vector<uint64_t> LATENCY_BUCKETS_US; // 100us .. 10s
+extern const std::vector<uint64_t> SIZE_BUCKETS_BYTES; // 256B .. 16MB
+
+// Fixed-bucket histogram of integer observations (microseconds, bytes).
+// observe() is a few relaxed atomic adds - no lock, no allocation - so it
+// can sit on the request path without adding to what it measures.
+class Histogram {
+public:
+    // `bounds`: bucket upper bounds (inclusive), ascending
+    explicit Histogram(const std::vector<uint64_t>& bounds);
+
+    void observe(uint64_t value);
+
+    // Point-in-time copy; counts per bucket are not cumulative, the last
+    // bucket is everything above the highest bound
+    struct Counts {
+        std::vector<uint64_t> bounds;
+        std::vector<uint64_t> buckets;
+        uint64_t count = 0;
+        uint64_t sum = 0;
+    };
+    Counts read() const;
+
+private:
+    std::vector<uint64_t> bounds_;
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    std::atomic<uint64_t> count_{0};
+    std::atomic<uint64_t> sum_{0};
+};
+
+// Builds a Prometheus text exposition (format 0.0.4). Call family() once per
+// metric name, then add its samples. `labels` is the inside of the braces,
+// e.g. route="coins", or empty.
+class MetricsText {
+public:
+    void family(const char* name, const char* type, const char* help);
+    void sample(const char* name, const std::string& labels, double value);
+
+    // _bucket/_sum/_count series; bounds and sum are divided by `scale`
+    // (1e6 turns microseconds into the base unit, seconds)
+    void histogram(const char* name, const std::string& labels, const Histogram::Counts& counts, double scale = 1);
+
+    std::string take() { return std::move(out_); }
+
+private:
+    std::string out_;
+};
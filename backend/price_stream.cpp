@@ -0,0 +1,193 @@
+#include "price_stream.h"
+
+#include <algorithm>
+
+using json = nlohmann::json;
+using namespace std;
+
+string encodeStreamFrame(const char* type, unsigned long long version, const vector<const CoinData*>& coins) {
+    json d = json::array();
+    for(const CoinData* coin : coins) {
+        d.push_back({coin->id, coin->price, coin->rank, coin->change24h});
+    }
+    json frame;
+    frame["type"] = type;
+    frame["v"] = version;
+    frame["d"] = move(d);
+    return frame.dump();
+}
+
+PriceStream::SubscriberId PriceStream::connect(SendFn send, CloseFn close) {
+    lock_guard<recursive_mutex> lock(mutex_);
+    SubscriberId id = nextId_++;
+    Subscriber& sub = subscribers_[id];
+    sub.send = move(send);
+    sub.close = move(close);
+    return id;
+}
+
+void PriceStream::disconnect(SubscriberId id) {
+    lock_guard<recursive_mutex> lock(mutex_);
+    subscribers_.erase(id);
+}
+
+size_t PriceStream::subscriberCount() const {
+    lock_guard<recursive_mutex> lock(mutex_);
+    return subscribers_.size();
+}
+
+bool PriceStream::trySend(SubscriberId id, Subscriber& sub, unsigned long long version,
+                          shared_ptr<const string> frame, vector<Outgoing>& out) {
+    // Frames of one version (a tick fanned out per coin) share one credit
+    bool newVersion = sub.inFlight.empty() || sub.inFlight.back() != version;
+    if(newVersion && (int)sub.inFlight.size() >= MAX_UNACKED_FRAMES) {
+        sub.needsResync = true;
+        return false;
+    }
+    if(newVersion) sub.inFlight.push_back(version);
+    out.push_back({id, move(frame)});
+    return true;
+}
+
+void PriceStream::flush(const vector<Outgoing>& out) {
+    for(const Outgoing& outgoing : out) {
+        // Looked up per frame: an earlier send may have disconnected it. The
+        // callback is copied, since it may disconnect (and destroy) itself.
+        auto it = subscribers_.find(outgoing.id);
+        if(it == subscribers_.end()) continue;
+        SendFn send = it->second.send;
+        send(*outgoing.frame);
+    }
+}
+
+void PriceStream::sendSnapshot(SubscriberId id, Subscriber& sub, const MarketSnapshot& current,
+                               vector<Outgoing>& out) {
+    vector<const CoinData*> coins;
+    if(sub.all) {
+        for(const auto& coin : current.coins) coins.push_back(&coin);
+    } else {
+        for(const auto& id : sub.coins) {
+            if(const CoinData* coin = findCoin(current, id)) coins.push_back(coin);
+        }
+    }
+    auto frame = make_shared<const string>(encodeStreamFrame("snapshot", current.version, coins));
+    if(trySend(id, sub, current.version, move(frame), out)) {
+        sub.needsResync = false;
+        sub.skippedTicks = 0;
+    }
+}
+
+void PriceStream::onMessage(SubscriberId id, string_view message, const MarketSnapshot& current) {
+    json msg = json::parse(message.begin(), message.end(), nullptr, false);
+    if(msg.is_discarded() || !msg.is_object()) return;
+
+    lock_guard<recursive_mutex> lock(mutex_);
+    auto it = subscribers_.find(id);
+    if(it == subscribers_.end()) return;
+    Subscriber& sub = it->second;
+    vector<Outgoing> out;
+
+    if(msg.contains("ack") && msg["ack"].is_number_unsigned()) {
+        unsigned long long acked = msg["ack"].get<unsigned long long>();
+        while(!sub.inFlight.empty() && sub.inFlight.front() <= acked) sub.inFlight.pop_front();
+        if(sub.needsResync) sendSnapshot(id, sub, current, out);
+    }
+
+    bool changed = false;
+    for(const char* key : {"subscribe", "unsubscribe"}) {
+        if(!msg.contains(key)) continue;
+        bool subscribe = key[0] == 's';
+        const json& target = msg[key];
+
+        if(target.is_string() && target.get<string>() == "*") {
+            sub.all = subscribe;
+            sub.coins.clear();
+            changed = true;
+        } else if(target.is_array()) {
+            for(const auto& item : target) {
+                if(!item.is_string()) continue;
+                // Accept symbols as well as ids; track by id
+                const CoinData* coin = findCoin(current, item.get<string>());
+                string coinId = coin ? coin->id : item.get<string>();
+                if(subscribe) {
+                    sub.coins.insert(coinId);
+                } else {
+                    sub.coins.erase(coinId);
+                }
+                changed = true;
+            }
+        }
+    }
+
+    // Bring the client in sync with its new subscription
+    if(changed && (sub.all || !sub.coins.empty())) {
+        sendSnapshot(id, sub, current, out);
+    }
+    flush(out);
+}
+
+void PriceStream::publishTick(const MarketSnapshot& previous, const MarketSnapshot& next) {
+    // Coins whose streamed fields moved in this update
+    vector<const CoinData*> changed;
+    for(const auto& coin : next.coins) {
+        size_t slot = previous.index.findById(previous.coins, coin.id);
+        if(slot == CoinIndex::npos) {
+            changed.push_back(&coin);
+            continue;
+        }
+        const CoinData& before = previous.coins[slot];
+        if(before.price != coin.price || before.rank != coin.rank || before.change24h != coin.change24h) {
+            changed.push_back(&coin);
+        }
+    }
+    if(changed.empty()) return;
+
+    // Encoded once and shared by every subscriber that needs them
+    auto allFrame = make_shared<const string>(encodeStreamFrame("tick", next.version, changed));
+    unordered_map<string_view, shared_ptr<const string>> coinFrames;
+
+    lock_guard<recursive_mutex> lock(mutex_);
+    vector<Outgoing> out;
+    vector<SubscriberId> slow;
+
+    for(auto& [id, sub] : subscribers_) {
+        if(!sub.all && sub.coins.empty()) continue;
+
+        bool delivered = false;
+        if(!sub.needsResync) {
+            if(sub.all) {
+                delivered = trySend(id, sub, next.version, allFrame, out);
+            } else {
+                delivered = true;
+                for(const CoinData* coin : changed) {
+                    if(!sub.coins.count(coin->id)) continue;
+                    auto frame = coinFrames.find(coin->id);
+                    if(frame == coinFrames.end()) {
+                        frame = coinFrames.emplace(coin->id, make_shared<const string>(
+                            encodeStreamFrame("tick", next.version, {coin}))).first;
+                    }
+                    if(!trySend(id, sub, next.version, frame->second, out)) {
+                        delivered = false;
+                        break;
+                    }
+                }
+            }
+        }
+
+        if(delivered) {
+            sub.skippedTicks = 0;
+        } else if(++sub.skippedTicks > MAX_SKIPPED_TICKS) {
+            slow.push_back(id);
+        }
+    }
+
+    flush(out);
+
+    for(SubscriberId id : slow) {
+        auto it = subscribers_.find(id);
+        if(it == subscribers_.end()) continue;
+        CloseFn close = it->second.close;
+        subscribers_.erase(it);
+        close("slow consumer");
+    }
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "market_snapshot.h"
+
+// Push channel for live price ticks (served as the /api/stream websocket).
+//
+// Protocol (JSON text frames):
+//   client -> server   {"subscribe": "*"} or {"subscribe": ["bitcoin", "eth"]}
+//                      {"unsubscribe": [...]} or {"unsubscribe": "*"}
+//                      {"ack": <v>}        after handling the frame with version v
+//   server -> client   {"type": "snapshot", "v": <v>, "d": [[id, price, rank, change24h], ...]}
+//                      {"type": "tick", "v": <v>, "d": [[id, price, rank, change24h], ...]}
+//
+// A "snapshot" carries current values for the client's subscription and is
+// sent on subscribe and after a resync; a "tick" carries only the coins whose
+// price, rank or 24h change moved in that update.
+//
+// Fan-out encodes each frame once: one frame with every changed coin for
+// wildcard subscribers, and one single-coin frame per changed coin shared by
+// all per-coin subscribers.
+//
+// Backpressure: a subscriber may have at most MAX_UNACKED_FRAMES versions
+// outstanding (all frames of one tick count once). Ticks arriving while it is out of credit are not queued; the
+// subscriber is marked for resync and gets one fresh "snapshot" once it acks
+// again. A subscriber that misses MAX_SKIPPED_TICKS ticks in a row is
+// disconnected.
+class PriceStream {
+public:
+    using SubscriberId = uint64_t;
+    using SendFn = std::function<void(const std::string& frame)>;
+    using CloseFn = std::function<void(const std::string& reason)>;
+
+    static constexpr int MAX_UNACKED_FRAMES = 8;
+    static constexpr int MAX_SKIPPED_TICKS = 3;
+
+    // Register a connection. `send` and `close` are only called while the
+    // subscriber is registered, so they may capture the connection directly.
+    SubscriberId connect(SendFn send, CloseFn close);
+
+    void disconnect(SubscriberId id);
+
+    // Handle a client control message
+    void onMessage(SubscriberId id, std::string_view message, const MarketSnapshot& current);
+
+    // Fan out the changes between two published snapshots
+    void publishTick(const MarketSnapshot& previous, const MarketSnapshot& next);
+
+    size_t subscriberCount() const;
+
+private:
+    struct Subscriber {
+        SendFn send;
+        CloseFn close;
+        bool all = false;
+        std::unordered_set<std::string> coins; // subscribed coin ids
+        std::deque<unsigned long long> inFlight; // versions sent but not yet acked
+        bool needsResync = false;
+        int skippedTicks = 0;
+    };
+
+    // A frame due to a subscriber. Frames are queued while subscribers_ is
+    // walked and sent afterwards by flush(), so a callback that disconnects
+    // never pulls a subscriber out from under a loop or a reference.
+    struct Outgoing {
+        SubscriberId id;
+        std::shared_ptr<const std::string> frame;
+    };
+
+    // Queue a frame if the subscriber has credit; otherwise flag a resync
+    bool trySend(SubscriberId id, Subscriber& sub, unsigned long long version,
+                 std::shared_ptr<const std::string> frame, std::vector<Outgoing>& out);
+    void sendSnapshot(SubscriberId id, Subscriber& sub, const MarketSnapshot& current, std::vector<Outgoing>& out);
+
+    // Send queued frames to the subscribers still registered
+    void flush(const std::vector<Outgoing>& out);
+
+    // Recursive: a send or close callback may re-enter disconnect() on the same thread
+    mutable std::recursive_mutex mutex_;
+    std::unordered_map<SubscriberId, Subscriber> subscribers_;
+    SubscriberId nextId_ = 1;
+};
+
+// Encode a tick/snapshot frame for the given coins
+std::string encodeStreamFrame(const char* type, unsigned long long version,
+                              const std::vector<const CoinData*>& coins);
@@ -0,0 +1,263 @@
+#include "replica.h"
+
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "snapshot_store.h"
+
+using namespace std;
+
+namespace {
+
+const char REPLICA_MAGIC[8] = {'C', 'L', 'Z', 'R', 'E', 'P', 'L', '\0'};
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+const uint64_t PAGE_SIZE_BYTES = 4096;
+
+// Reads of one poll that raced the leader before giving up until the next
+const int MAX_READ_ATTEMPTS = 3;
+
+uint64_t roundUpToPage(uint64_t size) {
+    return (size + PAGE_SIZE_BYTES - 1) / PAGE_SIZE_BYTES * PAGE_SIZE_BYTES;
+}
+
+uint32_t checksum(const char* data, uint64_t size) {
+    return (uint32_t)crc32(0L, reinterpret_cast<const Bytef*>(data), (uInt)size);
+}
+
+} // namespace
+
+ReplicaWriter::ReplicaWriter(string path, uint64_t leaderId) : path_(move(path)) {
+    // Built under a temporary name so followers never map a half-initialized header
+    string tmpPath = path_ + ".tmp";
+    fd_ = open(tmpPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd_ < 0) {
+        cerr << "❌ Cannot create replica file " << tmpPath << endl;
+        return;
+    }
+    if(!resize(REPLICA_HEADER_SIZE)) {
+        close(fd_);
+        fd_ = -1;
+        unlink(tmpPath.c_str());
+        return;
+    }
+
+    ReplicaHeader* header = new(map_) ReplicaHeader();
+    memcpy(header->magic, REPLICA_MAGIC, sizeof(header->magic));
+    header->byteOrder = BYTE_ORDER_MARK;
+    header->formatVersion = REPLICA_FORMAT_VERSION;
+    header->payloadFormat = SNAPSHOT_FORMAT_VERSION;
+    header->periodCount = (uint32_t)PERIOD_COUNT;
+    header->leaderId = leaderId;
+    header->heartbeat.store(time(nullptr), memory_order_relaxed);
+
+    if(rename(tmpPath.c_str(), path_.c_str()) != 0) {
+        cerr << "❌ Cannot create replica file " << path_ << endl;
+        munmap(map_, mapSize_);
+        close(fd_);
+        fd_ = -1;
+        map_ = nullptr;
+        unlink(tmpPath.c_str());
+        return;
+    }
+    header_ = header;
+}
+
+ReplicaWriter::~ReplicaWriter() {
+    // The file stays: followers keep serving its last generation until a
+    // leader replaces it
+    if(map_) munmap(map_, mapSize_);
+    if(fd_ >= 0) close(fd_);
+}
+
+bool ReplicaWriter::resize(uint64_t size) {
+    if(ftruncate(fd_, (off_t)size) != 0) {
+        cerr << "❌ Cannot grow replica file " << path_ << " to " << size << " bytes" << endl;
+        return false;
+    }
+    void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if(addr == MAP_FAILED) {
+        cerr << "❌ Cannot map replica file " << path_ << endl;
+        return false;
+    }
+    if(map_) munmap(map_, mapSize_);
+    map_ = static_cast<char*>(addr);
+    mapSize_ = size;
+    if(header_) header_ = reinterpret_cast<ReplicaHeader*>(map_);
+    return true;
+}
+
+bool ReplicaWriter::publish(const MarketSnapshot& snapshot, const ReplicaClock& clock) {
+    if(!header_) return false;
+
+    string payload = encodeSnapshotPayload(snapshot);
+
+    // Never the region followers may be reading the current generation from
+    int target = current_ == 0 ? 1 : 0;
+    Region& region = regions_[target];
+    if(region.capacity < payload.size()) {
+        // Room to grow, so the history filling in doesn't move it every time
+        uint64_t capacity = roundUpToPage(payload.size() + payload.size() / 2);
+        uint64_t offset = mapSize_;
+        if(!resize(offset + capacity)) return false;
+        region = {offset, capacity};
+    }
+    uint32_t crc = checksum(payload.data(), payload.size());
+
+    uint64_t sequence = header_->sequence.load(memory_order_relaxed);
+    header_->sequence.store(sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    memcpy(map_ + region.offset, payload.data(), payload.size());
+    header_->fileSize.store(mapSize_, memory_order_relaxed);
+    header_->payloadOffset.store(region.offset, memory_order_relaxed);
+    header_->payloadSize.store(payload.size(), memory_order_relaxed);
+    header_->payloadCrc32.store(crc, memory_order_relaxed);
+    header_->coinCount.store((uint32_t)snapshot.coins.size(), memory_order_relaxed);
+    header_->dataVersion.store(snapshot.version, memory_order_relaxed);
+    header_->publishedAt.store(snapshot.publishedAt, memory_order_relaxed);
+    header_->nextUpdateAt.store(clock.nextUpdateAt, memory_order_relaxed);
+    header_->pricesAt.store(clock.pricesAt, memory_order_relaxed);
+
+    header_->sequence.store(sequence + 2, memory_order_release);
+    header_->heartbeat.store(time(nullptr), memory_order_relaxed);
+    current_ = target;
+    return true;
+}
+
+void ReplicaWriter::beat() {
+    if(header_) header_->heartbeat.store(time(nullptr), memory_order_relaxed);
+}
+
+uint64_t ReplicaWriter::generation() const {
+    return header_ ? header_->sequence.load(memory_order_relaxed) / 2 : 0;
+}
+
+ReplicaReader::ReplicaReader(string path) : path_(move(path)) {}
+
+ReplicaReader::~ReplicaReader() {
+    detach();
+}
+
+bool ReplicaReader::attach() {
+    fd_ = open(path_.c_str(), O_RDONLY);
+    if(fd_ < 0) return false;
+
+    struct stat st;
+    if(fstat(fd_, &st) != 0 || (uint64_t)st.st_size < REPLICA_HEADER_SIZE || !remap(st.st_size)) {
+        detach();
+        return false;
+    }
+    inode_ = st.st_ino;
+
+    if(memcmp(header_->magic, REPLICA_MAGIC, sizeof(header_->magic)) != 0 ||
+       header_->byteOrder != BYTE_ORDER_MARK ||
+       header_->formatVersion != REPLICA_FORMAT_VERSION ||
+       header_->payloadFormat != SNAPSHOT_FORMAT_VERSION ||
+       header_->periodCount != PERIOD_COUNT) {
+        if(!warned_) cerr << "⚠️  Replica file " << path_ << " is from an incompatible leader" << endl;
+        warned_ = true;
+        detach();
+        return false;
+    }
+    warned_ = false;
+    lastSequence_ = 0;
+    return true;
+}
+
+void ReplicaReader::detach() {
+    if(map_) munmap(const_cast<char*>(map_), mapSize_);
+    if(fd_ >= 0) close(fd_);
+    fd_ = -1;
+    map_ = nullptr;
+    mapSize_ = 0;
+    header_ = nullptr;
+}
+
+bool ReplicaReader::remap(uint64_t size) {
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd_, 0);
+    if(addr == MAP_FAILED) return false;
+    if(map_) munmap(const_cast<char*>(map_), mapSize_);
+    map_ = static_cast<const char*>(addr);
+    mapSize_ = size;
+    header_ = reinterpret_cast<const ReplicaHeader*>(map_);
+    return true;
+}
+
+ReplicaReader::Result ReplicaReader::poll(ReplicaGeneration& out) {
+    // A restarted leader renames a new file over the old one
+    struct stat st;
+    if(fd_ >= 0 && (stat(path_.c_str(), &st) != 0 || st.st_ino != inode_)) detach();
+    if(fd_ < 0 && !attach()) return Result::Unavailable;
+
+    for(int attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+        uint64_t sequence = header_->sequence.load(memory_order_acquire);
+        // Nothing new, nothing published yet, or a generation being written
+        if(sequence == lastSequence_ || (sequence & 1)) return Result::NoChange;
+
+        uint64_t fileSize = header_->fileSize.load(memory_order_relaxed);
+        uint64_t offset = header_->payloadOffset.load(memory_order_relaxed);
+        uint64_t size = header_->payloadSize.load(memory_order_relaxed);
+        uint32_t crc = header_->payloadCrc32.load(memory_order_relaxed);
+        uint32_t coinCount = header_->coinCount.load(memory_order_relaxed);
+        uint64_t dataVersion = header_->dataVersion.load(memory_order_relaxed);
+        long long publishedAt = header_->publishedAt.load(memory_order_relaxed);
+        ReplicaClock clock;
+        clock.nextUpdateAt = header_->nextUpdateAt.load(memory_order_relaxed);
+        clock.pricesAt = header_->pricesAt.load(memory_order_relaxed);
+        atomic_thread_fence(memory_order_acquire);
+        if(header_->sequence.load(memory_order_relaxed) != sequence) continue;
+
+        if(fileSize > mapSize_ && !remap(fileSize)) return Result::Unavailable;
+        if(offset < REPLICA_HEADER_SIZE || offset > mapSize_ || size > mapSize_ - offset) {
+            cerr << "⚠️  Replica file " << path_ << " points outside itself, ignoring generation "
+                 << sequence / 2 << endl;
+            lastSequence_ = sequence;
+            return Result::NoChange;
+        }
+
+        // Checked and decoded in place, from the shared pages
+        const char* payload = map_ + offset;
+        MarketSnapshot decoded;
+        bool valid = checksum(payload, size) == crc &&
+                     decodeSnapshotPayload(payload, size, coinCount, header_->payloadFormat, decoded);
+
+        // Two generations on, the leader may have rewritten the region under us
+        atomic_thread_fence(memory_order_acquire);
+        if(header_->sequence.load(memory_order_relaxed) > sequence + 2) continue;
+
+        lastSequence_ = sequence;
+        if(!valid) {
+            cerr << "⚠️  Replica generation " << sequence / 2 << " failed its checksum, skipping it" << endl;
+            return Result::NoChange;
+        }
+
+        decoded.version = dataVersion;
+        decoded.publishedAt = publishedAt;
+        out.generation = sequence / 2;
+        out.leaderId = header_->leaderId;
+        out.clock = clock;
+        out.snapshot = move(decoded);
+        return Result::Updated;
+    }
+    return Result::NoChange;
+}
+
+long long ReplicaReader::heartbeat() const {
+    return header_ ? header_->heartbeat.load(memory_order_relaxed) : 0;
+}
+
+void shareUnchangedHistory(const MarketSnapshot& previous, vector<CoinData>& coins) {
+    for(CoinData& coin : coins) {
+        size_t slot = previous.index.findById(previous.coins, coin.id);
+        if(slot == CoinIndex::npos) continue;
+        const SharedHistory& before = previous.coins[slot].historicalData;
+        if(before.get().samePoints(coin.historicalData.get())) coin.historicalData = before;
+    }
+}
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "market_snapshot.h"
+
+// Leader/follower replication on one host. One leader process fetches from
+// upstream and writes each new snapshot, as a generation, into a shared file
+// (normally under /dev/shm, so it never touches a disk). Any number of
+// follower processes map that file read-only and serve what it holds; they
+// make no upstream calls, so adding followers adds HTTP capacity without
+// spending quota.
+//
+// Layout (native little-endian):
+//   ReplicaHeader, padded to REPLICA_HEADER_SIZE
+//   payload regions, each holding one generation's snapshot payload (see
+//   encodeSnapshotPayload() in snapshot_store.h)
+//
+// The header is a seqlock. `sequence` turns odd before the leader writes a
+// generation and even (sequence / 2 = generation) once the payload and the
+// fields describing it are complete. A generation goes into the region the
+// current one doesn't use, so readers of the current generation are never
+// written under; a region too small for the payload is replaced by a bigger
+// one at the end of the file. The file only grows while mapped. A leader
+// restart creates a new file and renames it over the old one; followers
+// notice the new inode and remap.
+//
+// A follower reads `sequence` (even), the fields, then `sequence` again (the
+// same, or it retries); decodes and checksums the payload; then checks that
+// `sequence` hasn't moved more than one generation on - past that, the
+// leader may have started rewriting the region it was reading.
+
+constexpr uint32_t REPLICA_FORMAT_VERSION = 1;
+constexpr size_t REPLICA_HEADER_SIZE = 4096;
+
+struct ReplicaHeader {
+    // Fixed when the leader creates the file
+    char magic[8];                      // "CLZREPL\0"
+    uint32_t byteOrder;                 // 0x01020304 as written by the leader
+    uint32_t formatVersion;             // REPLICA_FORMAT_VERSION
+    uint32_t payloadFormat;             // SNAPSHOT_FORMAT_VERSION of the payloads
+    uint32_t periodCount;               // PERIOD_COUNT of the leader
+    uint64_t leaderId;                  // the leader's boot time (ms), also its ETag origin
+
+    std::atomic<uint64_t> sequence;     // odd while a generation is being written
+    std::atomic<int64_t> heartbeat;     // unix seconds, the leader's last sign of life
+
+    // The current generation; change only while `sequence` is odd
+    std::atomic<uint64_t> fileSize;
+    std::atomic<uint64_t> payloadOffset;
+    std::atomic<uint64_t> payloadSize;
+    std::atomic<uint32_t> payloadCrc32;
+    std::atomic<uint32_t> coinCount;
+    std::atomic<uint64_t> dataVersion;  // MarketSnapshot::version
+    std::atomic<int64_t> publishedAt;   // MarketSnapshot::publishedAt
+    std::atomic<int64_t> nextUpdateAt;  // the leader's next live update (unix seconds)
+    std::atomic<int64_t> pricesAt;      // when the leader last fetched prices (unix seconds)
+};
+
+static_assert(sizeof(ReplicaHeader) <= REPLICA_HEADER_SIZE, "ReplicaHeader must fit its page");
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<int64_t>::is_always_lock_free &&
+              std::atomic<uint32_t>::is_always_lock_free,
+              "header atomics are shared between processes and must be lock-free");
+
+// Leader timestamps travelling with a generation
+struct ReplicaClock {
+    long long nextUpdateAt = 0;
+    long long pricesAt = 0;
+};
+
+// The leader's side. Not thread-safe: one replicator thread owns it.
+class ReplicaWriter {
+public:
+    // Create the shared file at `path` (replacing any previous one)
+    ReplicaWriter(std::string path, uint64_t leaderId);
+    ~ReplicaWriter();
+
+    ReplicaWriter(const ReplicaWriter&) = delete;
+    ReplicaWriter& operator=(const ReplicaWriter&) = delete;
+
+    // Whether the file was created
+    bool ok() const { return header_ != nullptr; }
+
+    // Write `snapshot` as the next generation. Returns false and logs on failure.
+    bool publish(const MarketSnapshot& snapshot, const ReplicaClock& clock);
+
+    // Tell followers the leader is alive when there is nothing new to publish
+    void beat();
+
+    uint64_t generation() const;
+
+private:
+    struct Region {
+        uint64_t offset = 0;
+        uint64_t capacity = 0;
+    };
+
+    bool resize(uint64_t size);
+
+    std::string path_;
+    int fd_ = -1;
+    char* map_ = nullptr;
+    uint64_t mapSize_ = 0;
+    ReplicaHeader* header_ = nullptr;
+    Region regions_[2];
+    int current_ = -1; // region of the current generation
+};
+
+// One generation as a follower read it
+struct ReplicaGeneration {
+    uint64_t generation = 0;
+    uint64_t leaderId = 0;
+    ReplicaClock clock;
+    MarketSnapshot snapshot; // market data with the leader's version and publishedAt
+};
+
+// A follower's side. Not thread-safe: one poller thread owns it.
+class ReplicaReader {
+public:
+    explicit ReplicaReader(std::string path);
+    ~ReplicaReader();
+
+    ReplicaReader(const ReplicaReader&) = delete;
+    ReplicaReader& operator=(const ReplicaReader&) = delete;
+
+    enum class Result { Updated, NoChange, Unavailable };
+
+    // Decode the newest generation into `out` if it is newer than the last one
+    // read. Unavailable while there is no usable file (no leader yet, or an
+    // incompatible one).
+    Result poll(ReplicaGeneration& out);
+
+    // The leader's last heartbeat (unix seconds; 0 with no file)
+    long long heartbeat() const;
+
+private:
+    bool attach();
+    void detach();
+    bool remap(uint64_t size);
+
+    std::string path_;
+    int fd_ = -1;
+    unsigned long long inode_ = 0;
+    const char* map_ = nullptr;
+    uint64_t mapSize_ = 0;
+    const ReplicaHeader* header_ = nullptr;
+    uint64_t lastSequence_ = 0;
+    bool warned_ = false;
+};
+
+// Point coins whose history is identical to the same coin's in `previous` at
+// that snapshot's history, so publishing a decoded generation re-renders only
+// the coins that changed
+void shareUnchangedHistory(const MarketSnapshot& previous, std::vector<CoinData>& coins);
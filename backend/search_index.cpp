@@ -0,0 +1,458 @@
+#include "search_index.h"
+
+#include <algorithm>
+#include <cctype>
+#include <climits>
+#include <cstdlib>
+#include <nlohmann/json.hpp>
+
+#include "coin_query.h"
+#include "market_snapshot.h"
+
+using json = nlohmann::json;
+using namespace std;
+
+namespace {
+
+constexpr uint32_t NONE = 0xFFFFFFFFu;
+
+// Query words up to this many; every one has to match
+constexpr size_t MAX_QUERY_WORDS = 8;
+
+// Note words shorter than this are neither indexed nor matched
+constexpr size_t MIN_NOTE_WORD = 3;
+
+// Typo matching: words of FUZZY_MIN_WORD to MAX_FUZZY_WORD letters, with at most 1 edit (2 from
+// FUZZY_TWO_EDITS letters), checking at most FUZZY_CHECKS candidates
+constexpr size_t FUZZY_MIN_WORD = 3;
+constexpr size_t MAX_FUZZY_WORD = 32;
+constexpr size_t FUZZY_TWO_EDITS = 6;
+constexpr size_t FUZZY_CHECKS = 64;
+
+// Per field: an exact term, a term the word is a prefix of
+int termScore(uint8_t field, bool exact) {
+    static const int EXACT[] = {100, 95, 90, 70, 25};
+    static const int PREFIX[] = {60, 80, 75, 55, 15};
+    return exact ? EXACT[field] : PREFIX[field];
+}
+
+int fuzzyScore(size_t edits) {
+    return edits <= 1 ? 35 : 25;
+}
+
+// Bonus when a several-word query is a coin's whole name, or starts it
+constexpr int PHRASE_EXACT = 40;
+constexpr int PHRASE_PREFIX = 20;
+
+bool isWordChar(unsigned char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+string lowerAscii(string_view text) {
+    string out(text);
+    for(char& c : out) {
+        if(c >= 'A' && c <= 'Z') c = char(c - 'A' + 'a');
+    }
+    return out;
+}
+
+// Lower-case words of `text`, appended to `out` (UTF-8 letters count as word characters)
+void splitWords(string_view text, vector<string>& out) {
+    size_t i = 0;
+    while(i < text.size()) {
+        while(i < text.size() && !isWordChar(text[i])) i++;
+        size_t start = i;
+        while(i < text.size() && isWordChar(text[i])) i++;
+        if(i > start) out.push_back(lowerAscii(text.substr(start, i - start)));
+    }
+}
+
+bool startsWith(const string& text, string_view prefix) {
+    return text.size() >= prefix.size() && text.compare(0, prefix.size(), prefix) == 0;
+}
+
+// Trigrams of "^word": the start of a word counts, its end doesn't, so a
+// query that is only the beginning of a word still shares all its grams
+void appendGrams(string_view word, vector<uint32_t>& out) {
+    string padded = "^" + string(word);
+    for(size_t i = 0; i + 3 <= padded.size(); i++) {
+        out.push_back((uint32_t)(unsigned char)padded[i] << 16 | (uint32_t)(unsigned char)padded[i + 1] << 8 |
+                      (unsigned char)padded[i + 2]);
+    }
+}
+
+// Fewest edits (insertions, deletions, substitutions, adjacent swaps) that
+// turn `word` into some prefix of `term`, or limit + 1 if more than `limit`.
+// `word` is at most MAX_FUZZY_WORD long.
+size_t prefixDistance(const string& word, const string& term, size_t limit) {
+    const size_t m = word.size();
+    const size_t n = min(term.size(), m + limit);
+    size_t rows[3][MAX_FUZZY_WORD + 3];
+    size_t* before = rows[0];
+    size_t* previous = rows[1];
+    size_t* row = rows[2];
+    for(size_t j = 0; j <= n; j++) previous[j] = j;
+
+    for(size_t i = 1; i <= m; i++) {
+        row[0] = i;
+        size_t rowMin = row[0];
+        for(size_t j = 1; j <= n; j++) {
+            size_t cost = word[i - 1] == term[j - 1] ? 0 : 1;
+            row[j] = min({previous[j] + 1, row[j - 1] + 1, previous[j - 1] + cost});
+            if(i > 1 && j > 1 && word[i - 1] == term[j - 2] && word[i - 2] == term[j - 1]) {
+                row[j] = min(row[j], before[j - 2] + 1);
+            }
+            rowMin = min(rowMin, row[j]);
+        }
+        if(rowMin > limit) return limit + 1;
+        size_t* oldest = before;
+        before = previous;
+        previous = row;
+        row = oldest;
+    }
+    return *min_element(previous, previous + n + 1);
+}
+
+} // namespace
+
+bool parseCoinNotes(string_view body, CoinNotes& notes, string& error) {
+    json data = json::parse(body.begin(), body.end(), nullptr, false);
+    if(data.is_discarded() || !data.is_object()) {
+        error = "coin info: expected an object of coins";
+        return false;
+    }
+
+    notes.clear();
+    for(const auto& [id, info] : data.items()) {
+        if(id.empty() || id[0] == '_' || !info.is_object()) continue;
+        string text;
+        for(const char* field : {"description", "founder"}) {
+            if(info.contains(field) && info[field].is_string()) {
+                text += info[field].get<string>();
+                text += ' ';
+            }
+        }
+        if(!text.empty()) notes[id] = move(text);
+    }
+    return true;
+}
+
+const char* searchMatchName(SearchMatch match) {
+    static const char* const NAMES[] = {"symbol", "name", "id", "word", "description", "fuzzy"};
+    return NAMES[static_cast<size_t>(match)];
+}
+
+void SearchIndex::indexCoin(const CoinData& coin, uint32_t doc, const CoinNotes* notes, Doc& out,
+                            vector<Term>& terms, vector<Gram>& grams) {
+    out.id = coin.id;
+    out.name = coin.name;
+    out.symbol = coin.symbol;
+    out.keys.clear();
+
+    string symbol = lowerAscii(coin.symbol);
+    string name = lowerAscii(coin.name);
+    string id = lowerAscii(coin.id);
+    if(!symbol.empty()) terms.push_back({symbol, doc, Field::Symbol});
+    if(!name.empty()) terms.push_back({name, doc, Field::Name});
+    if(!id.empty() && id != name) terms.push_back({id, doc, Field::Id});
+
+    // Single words of the name and id ("cash" in "Bitcoin Cash", "2" in "avalanche-2")
+    vector<string> words;
+    splitWords(coin.name, words);
+    splitWords(coin.id, words);
+    sort(words.begin(), words.end());
+    words.erase(unique(words.begin(), words.end()), words.end());
+    for(const string& word : words) {
+        if(word != name && word != id && word != symbol) terms.push_back({word, doc, Field::Word});
+    }
+
+    if(!symbol.empty()) out.keys.push_back(symbol);
+    for(const string& word : words) {
+        if(word != symbol) out.keys.push_back(word);
+    }
+    vector<uint32_t> docGrams;
+    for(const string& key : out.keys) appendGrams(key, docGrams);
+    sort(docGrams.begin(), docGrams.end());
+    docGrams.erase(unique(docGrams.begin(), docGrams.end()), docGrams.end());
+    for(uint32_t gram : docGrams) grams.push_back({gram, doc});
+
+    if(!notes) return;
+    auto it = notes->find(coin.id);
+    if(it == notes->end()) return;
+    vector<string> noteWords;
+    splitWords(it->second, noteWords);
+    sort(noteWords.begin(), noteWords.end());
+    noteWords.erase(unique(noteWords.begin(), noteWords.end()), noteWords.end());
+    for(string& word : noteWords) {
+        if(word.size() < MIN_NOTE_WORD || binary_search(words.begin(), words.end(), word)) continue;
+        terms.push_back({move(word), doc, Field::Note});
+    }
+}
+
+bool SearchIndex::sameCoins(const vector<CoinData>& coins) const {
+    if(coins.size() != docs_.size()) return false;
+    for(size_t i = 0; i < coins.size(); i++) {
+        const Doc& doc = docs_[i];
+        if(doc.id != coins[i].id || doc.name != coins[i].name || doc.symbol != coins[i].symbol) return false;
+    }
+    return true;
+}
+
+shared_ptr<const SearchIndex> SearchIndex::update(const shared_ptr<const SearchIndex>& previous,
+                                                  const vector<CoinData>& coins,
+                                                  const shared_ptr<const CoinNotes>& notes) {
+    bool incremental = previous && previous->notes_ == notes;
+    if(incremental && previous->sameCoins(coins)) return previous;
+
+    auto next = make_shared<SearchIndex>();
+    next->notes_ = notes;
+    next->docs_.resize(coins.size());
+
+    // Coins still listed under the same name and symbol keep their terms;
+    // the others are tokenized afresh
+    vector<uint32_t> renumber; // old document -> new one, or NONE
+    unordered_map<string_view, uint32_t> oldDocs;
+    if(incremental) {
+        renumber.assign(previous->docs_.size(), NONE);
+        for(uint32_t d = 0; d < previous->docs_.size(); d++) oldDocs.emplace(previous->docs_[d].id, d);
+    }
+    vector<Term> fresh;
+    vector<Gram> freshGrams;
+    for(uint32_t i = 0; i < coins.size(); i++) {
+        if(incremental) {
+            auto it = oldDocs.find(coins[i].id);
+            if(it != oldDocs.end() && renumber[it->second] == NONE) {
+                const Doc& old = previous->docs_[it->second];
+                if(old.name == coins[i].name && old.symbol == coins[i].symbol) {
+                    renumber[it->second] = i;
+                    next->docs_[i] = old;
+                    continue;
+                }
+            }
+        }
+        indexCoin(coins[i], i, notes.get(), next->docs_[i], fresh, freshGrams);
+    }
+    sort(fresh.begin(), fresh.end(), [](const Term& a, const Term& b) { return a.text < b.text; });
+    sort(freshGrams.begin(), freshGrams.end(), [](const Gram& a, const Gram& b) { return a.gram < b.gram; });
+
+    // Carried-over entries stay in term order; only their document numbers
+    // change, so they merge with the new ones in one linear pass
+    vector<Term> kept;
+    vector<Gram> keptGrams;
+    if(incremental) {
+        kept.reserve(previous->terms_.size());
+        for(const Term& term : previous->terms_) {
+            if(renumber[term.doc] != NONE) kept.push_back({term.text, renumber[term.doc], term.field});
+        }
+        keptGrams.reserve(previous->grams_.size());
+        for(const Gram& gram : previous->grams_) {
+            if(renumber[gram.doc] != NONE) keptGrams.push_back({gram.gram, renumber[gram.doc]});
+        }
+    }
+    next->terms_.reserve(kept.size() + fresh.size());
+    merge(make_move_iterator(kept.begin()), make_move_iterator(kept.end()), make_move_iterator(fresh.begin()),
+          make_move_iterator(fresh.end()), back_inserter(next->terms_),
+          [](const Term& a, const Term& b) { return a.text < b.text; });
+    next->grams_.reserve(keptGrams.size() + freshGrams.size());
+    merge(keptGrams.begin(), keptGrams.end(), freshGrams.begin(), freshGrams.end(), back_inserter(next->grams_),
+          [](const Gram& a, const Gram& b) { return a.gram < b.gram; });
+    return next;
+}
+
+// Per-document working state of a search, sized to the largest index seen
+// and kept per request thread. Only the entries a query touched are reset
+// afterwards, so a query costs the documents it matches, not the universe.
+struct SearchIndex::Scratch {
+    vector<uint8_t> matched;    // query words matched so far
+    vector<int> total;
+    vector<int> bestPart;       // best single word score, and what it matched
+    vector<SearchMatch> kinds;
+    vector<int> wordScore;      // best score for the current word
+    vector<SearchMatch> wordKind;
+    vector<uint8_t> shared;     // trigrams shared with the current word
+    vector<uint32_t> found;     // documents matching the current word
+    vector<uint32_t> counted;   // documents with shared > 0
+    vector<uint32_t> candidates;
+
+    void fit(size_t count) {
+        if(matched.size() >= count) return;
+        matched.resize(count);
+        total.resize(count);
+        bestPart.resize(count);
+        kinds.resize(count);
+        wordScore.resize(count);
+        wordKind.resize(count);
+        shared.resize(count);
+    }
+};
+
+void SearchIndex::fuzzyMatches(const string& word, uint8_t round, Scratch& scratch) const {
+    const size_t limit = word.size() >= FUZZY_TWO_EDITS ? 2 : 1;
+    vector<uint32_t> queryGrams;
+    appendGrams(word, queryGrams);
+    sort(queryGrams.begin(), queryGrams.end());
+    queryGrams.erase(unique(queryGrams.begin(), queryGrams.end()), queryGrams.end());
+
+    // One edit breaks at most three trigrams
+    size_t needed = queryGrams.size() > 3 * limit ? queryGrams.size() - 3 * limit : 1;
+
+    scratch.counted.clear();
+    scratch.candidates.clear();
+    for(uint32_t gram : queryGrams) {
+        auto range = equal_range(grams_.begin(), grams_.end(), Gram{gram, 0},
+                                 [](const Gram& a, const Gram& b) { return a.gram < b.gram; });
+        for(auto it = range.first; it != range.second; ++it) {
+            uint32_t doc = it->doc;
+            if(scratch.matched[doc] != round || scratch.wordScore[doc] > 0) continue;
+            if(scratch.shared[doc]++ == 0) scratch.counted.push_back(doc);
+            if(scratch.shared[doc] == needed) scratch.candidates.push_back(doc);
+        }
+    }
+
+    // Only the candidates sharing the most trigrams (then the best ranked) are checked
+    vector<uint32_t>& candidates = scratch.candidates;
+    auto closer = [&](uint32_t a, uint32_t b) {
+        return scratch.shared[a] != scratch.shared[b] ? scratch.shared[a] > scratch.shared[b] : a < b;
+    };
+    if(candidates.size() > FUZZY_CHECKS) {
+        nth_element(candidates.begin(), candidates.begin() + FUZZY_CHECKS, candidates.end(), closer);
+        candidates.resize(FUZZY_CHECKS);
+    }
+
+    for(uint32_t doc : candidates) {
+        size_t best = limit + 1;
+        for(const string& key : docs_[doc].keys) best = min(best, prefixDistance(word, key, limit));
+        if(best > limit) continue;
+        scratch.wordScore[doc] = fuzzyScore(best);
+        scratch.wordKind[doc] = SearchMatch::Fuzzy;
+        scratch.found.push_back(doc);
+    }
+    for(uint32_t doc : scratch.counted) scratch.shared[doc] = 0;
+}
+
+vector<SearchHit> SearchIndex::search(string_view query, size_t limit, const vector<CoinData>& coins) const {
+    vector<string> words;
+    splitWords(query, words);
+    if(words.size() > MAX_QUERY_WORDS) words.resize(MAX_QUERY_WORDS);
+    if(words.empty() || limit == 0) return {};
+
+    thread_local Scratch scratch;
+    scratch.fit(docs_.size());
+    vector<uint8_t>& matched = scratch.matched;
+    vector<int>& total = scratch.total;
+    vector<int>& wordScore = scratch.wordScore;
+    vector<uint32_t>& found = scratch.found;
+
+    // Every document scored at all matched the first word
+    vector<uint32_t> touched;
+
+    auto byText = [](const Term& term, string_view text) { return term.text < text; };
+    for(size_t round = 0; round < words.size(); round++) {
+        const string& word = words[round];
+        found.clear();
+        for(auto it = lower_bound(terms_.begin(), terms_.end(), word, byText);
+            it != terms_.end() && startsWith(it->text, word); ++it) {
+            if(matched[it->doc] != round) continue;
+            if(it->field == Field::Note && word.size() < MIN_NOTE_WORD) continue;
+            int score = termScore(static_cast<uint8_t>(it->field), it->text.size() == word.size());
+            if(wordScore[it->doc] == 0) found.push_back(it->doc);
+            if(score > wordScore[it->doc]) {
+                wordScore[it->doc] = score;
+                scratch.wordKind[it->doc] = static_cast<SearchMatch>(it->field);
+            }
+        }
+        if(found.size() < limit && word.size() >= FUZZY_MIN_WORD && word.size() <= MAX_FUZZY_WORD) {
+            fuzzyMatches(word, (uint8_t)round, scratch);
+        }
+
+        for(uint32_t doc : found) {
+            matched[doc] = uint8_t(round + 1);
+            total[doc] += wordScore[doc];
+            if(wordScore[doc] > scratch.bestPart[doc]) {
+                scratch.bestPart[doc] = wordScore[doc];
+                scratch.kinds[doc] = scratch.wordKind[doc];
+            }
+            wordScore[doc] = 0;
+        }
+        if(round == 0) touched = found;
+    }
+
+    // Whoever matched the last word matched them all
+    if(words.size() > 1) {
+        string phrase = words[0];
+        for(size_t i = 1; i < words.size(); i++) phrase += " " + words[i];
+        for(auto it = lower_bound(terms_.begin(), terms_.end(), phrase, byText);
+            it != terms_.end() && startsWith(it->text, phrase); ++it) {
+            if(it->field != Field::Name || matched[it->doc] != words.size()) continue;
+            total[it->doc] += it->text.size() == phrase.size() ? PHRASE_EXACT : PHRASE_PREFIX;
+        }
+    }
+
+    auto rankOf = [&](uint32_t doc) {
+        int rank = doc < coins.size() ? coins[doc].rank : 0;
+        return rank > 0 ? rank : INT_MAX;
+    };
+    auto better = [&](uint32_t a, uint32_t b) {
+        if(total[a] != total[b]) return total[a] > total[b];
+        if(rankOf(a) != rankOf(b)) return rankOf(a) < rankOf(b);
+        return a < b;
+    };
+    size_t shown = min(limit, found.size());
+    partial_sort(found.begin(), found.begin() + shown, found.end(), better);
+
+    vector<SearchHit> hits;
+    hits.reserve(shown);
+    for(size_t i = 0; i < shown; i++) hits.push_back({found[i], total[found[i]], scratch.kinds[found[i]]});
+
+    for(uint32_t doc : touched) {
+        matched[doc] = 0;
+        total[doc] = 0;
+        scratch.bestPart[doc] = 0;
+    }
+    return hits;
+}
+
+bool parseSearchQuery(const function<const char*(const char*)>& param, SearchQuery& out, string& error) {
+    const char* text = param("q");
+    if(!text || !*text) {
+        error = "q is required";
+        return false;
+    }
+    out.text = text;
+
+    if(const char* limit = param("limit")) {
+        char* end;
+        unsigned long value = strtoul(limit, &end, 10);
+        if(!isdigit((unsigned char)*limit) || *end || value == 0 || value > SearchIndex::MAX_LIMIT) {
+            error = "limit must be between 1 and " + to_string(SearchIndex::MAX_LIMIT);
+            return false;
+        }
+        out.limit = value;
+    }
+    return true;
+}
+
+string encodeSearchResults(const MarketSnapshot& snapshot, string_view query, const vector<SearchHit>& hits,
+                           const Representation& rep) {
+    uint32_t mask = 0;
+    for(CoinField field : {CoinField::Id, CoinField::Rank, CoinField::Name, CoinField::Symbol, CoinField::Logo}) {
+        mask |= 1u << static_cast<size_t>(field);
+    }
+
+    WireWriter out(rep.format);
+    out.beginMap(2);
+    out.key("query");
+    out.string(string(query));
+    out.key("results");
+    out.beginArray(hits.size());
+    for(const SearchHit& hit : hits) {
+        out.beginMap(coinFieldCount(mask) + 1);
+        writeCoinFields(out, snapshot.coins[hit.slot], mask, rep.layout);
+        out.key("match");
+        out.string(searchMatchName(hit.match));
+        out.endMap();
+    }
+    out.endArray();
+    out.endMap();
+    return out.take();
+}
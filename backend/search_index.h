@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "market_data.h"
+#include "wire_format.h"
+
+struct MarketSnapshot;
+
+// Free text about coins beyond their market data, by coin id: the
+// descriptions and founders of frontend/coin-info.json
+using CoinNotes = std::unordered_map<std::string, std::string>;
+
+// Parse coin-info.json ({"bitcoin": {"description": "...", "founder": "..."}, ...}).
+// Keys starting with "_" (templates) are skipped. On a malformed file
+// returns false with a message in `error`.
+bool parseCoinNotes(std::string_view body, CoinNotes& notes, std::string& error);
+
+// How a search result matched, strongest first
+enum class SearchMatch : uint8_t { Symbol, Name, Id, Word, Note, Fuzzy };
+
+const char* searchMatchName(SearchMatch match);
+
+struct SearchHit {
+    size_t slot;        // in the coins the index was built for
+    int score;
+    SearchMatch match;  // the field behind the best part of the score
+};
+
+// Prefix and typo-tolerant search over coin ids, names, symbols and notes.
+//
+// Every term (symbol, full name, full id, each word of the name and id, and
+// each word of the coin's notes) is kept in one vector sorted by term, so the
+// terms starting with a query word are one binary search and a contiguous
+// scan. Typos are caught through a second sorted vector of letter trigrams of
+// the short terms: documents sharing enough trigrams with the query word are
+// checked with a bounded edit distance against their terms' prefixes.
+//
+// Document n is coin slot n. An index is immutable once published and shared
+// between snapshots until the coin list changes; update() then carries the
+// unchanged coins' terms over (renumbered to their new slots) and only
+// tokenizes the new or renamed ones.
+class SearchIndex {
+public:
+    static constexpr size_t DEFAULT_LIMIT = 10;
+    static constexpr size_t MAX_LIMIT = 50;
+
+    // `previous` (may be null) brought up to date with `coins` and `notes`;
+    // returns `previous` itself when nothing it indexes changed
+    static std::shared_ptr<const SearchIndex> update(const std::shared_ptr<const SearchIndex>& previous,
+                                                     const std::vector<CoinData>& coins,
+                                                     const std::shared_ptr<const CoinNotes>& notes);
+
+    // The best `limit` matches for `query` (case-insensitive; every word must
+    // match), ties going to the better market-cap rank. `coins` must be the
+    // list the index was last updated with.
+    std::vector<SearchHit> search(std::string_view query, size_t limit, const std::vector<CoinData>& coins) const;
+
+    size_t documents() const { return docs_.size(); }
+    size_t terms() const { return terms_.size(); }
+
+private:
+    enum class Field : uint8_t { Symbol, Name, Id, Word, Note };
+
+    struct Term {
+        std::string text;
+        uint32_t doc;
+        Field field;
+    };
+
+    struct Gram {
+        uint32_t gram;
+        uint32_t doc;
+    };
+
+    // What a document was indexed from, to tell whether it needs re-indexing
+    struct Doc {
+        std::string id;
+        std::string name;
+        std::string symbol;
+        std::vector<std::string> keys; // lower-case symbol and name/id words, for the typo check
+    };
+
+    static void indexCoin(const CoinData& coin, uint32_t doc, const CoinNotes* notes, Doc& out,
+                          std::vector<Term>& terms, std::vector<Gram>& grams);
+    bool sameCoins(const std::vector<CoinData>& coins) const;
+
+    struct Scratch;
+
+    // Add typo matches of `word` to the current word's scores, among the
+    // documents that matched the `round` words before it and not this one yet
+    void fuzzyMatches(const std::string& word, uint8_t round, Scratch& scratch) const;
+
+    std::shared_ptr<const CoinNotes> notes_;
+    std::vector<Doc> docs_;
+    std::vector<Term> terms_; // sorted by text
+    std::vector<Gram> grams_; // sorted by gram
+};
+
+// GET /api/search parameters
+struct SearchQuery {
+    std::string text; // q
+    size_t limit = SearchIndex::DEFAULT_LIMIT;
+};
+
+// Parse q= (required) and limit= (1 to SearchIndex::MAX_LIMIT), reading each
+// with `param` (nullptr when absent). On a bad value returns false with a
+// message in `error`.
+bool parseSearchQuery(const std::function<const char*(const char*)>& param, SearchQuery& out, std::string& error);
+
+// Render search results: {"query": "...", "results": [{id, rank, name,
+// symbol, logo, match}, ...]}
+std::string encodeSearchResults(const MarketSnapshot& snapshot, std::string_view query,
+                                const std::vector<SearchHit>& hits, const Representation& rep);
@@ -0,0 +1,340 @@
+#include "snapshot_store.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <zlib.h>
+
+using namespace std;
+
+namespace {
+
+const char SNAPSHOT_MAGIC[8] = {'C', 'L', 'Z', 'S', 'N', 'A', 'P', '\0'};
+const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// Append-only binary writer
+class Writer {
+public:
+    template<typename T>
+    void put(const T& value) {
+        const char* p = reinterpret_cast<const char*>(&value);
+        buf_.append(p, sizeof(T));
+    }
+
+    void putBytes(const void* data, size_t size) {
+        buf_.append(static_cast<const char*>(data), size);
+    }
+
+    void putString(const string& s) {
+        put<uint32_t>((uint32_t)s.size());
+        buf_.append(s);
+    }
+
+    string& buffer() { return buf_; }
+
+private:
+    string buf_;
+};
+
+// Bounds-checked reader over the mapped payload
+class Reader {
+public:
+    Reader(const char* data, size_t size) : p_(data), end_(data + size) {}
+
+    template<typename T>
+    T get() {
+        T value{};
+        if(!take(sizeof(T))) return value;
+        memcpy(&value, p_ - sizeof(T), sizeof(T));
+        return value;
+    }
+
+    string getString() {
+        uint32_t size = get<uint32_t>();
+        if(!take(size)) return {};
+        return string(p_ - size, size);
+    }
+
+    const char* getBytes(size_t size) {
+        return take(size) ? p_ - size : nullptr;
+    }
+
+    bool ok() const { return ok_; }
+    bool atEnd() const { return p_ == end_; }
+
+private:
+    bool take(size_t size) {
+        if(!ok_ || (size_t)(end_ - p_) < size) {
+            ok_ = false;
+            return false;
+        }
+        p_ += size;
+        return true;
+    }
+
+    const char* p_;
+    const char* end_;
+    bool ok_ = true;
+};
+
+// Read-only mapping of a whole file
+class MappedFile {
+public:
+    explicit MappedFile(const string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if(fd < 0) return;
+        struct stat st;
+        if(fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* addr = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(addr != MAP_FAILED) {
+                data_ = static_cast<const char*>(addr);
+                size_ = st.st_size;
+            }
+        }
+        close(fd);
+    }
+
+    ~MappedFile() {
+        if(data_) munmap(const_cast<char*>(data_), size_);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const char* data() const { return data_; }
+    size_t size() const { return size_; }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+void writeCoin(Writer& w, const CoinData& c) {
+    w.putString(c.id);
+    w.put<int32_t>(c.rank);
+    w.putString(c.name);
+    w.putString(c.symbol);
+    w.putString(c.logo);
+    for(double v : {c.price, c.change24h, c.marketCap, c.volume24h, c.circulatingSupply,
+                    c.totalSupply, c.maxSupply, c.ath, c.athChangePercentage}) {
+        w.put<double>(v);
+    }
+    w.putString(c.athDate);
+    w.put<uint32_t>((uint32_t)c.sparkline7d.size());
+    w.putBytes(c.sparkline7d.data(), c.sparkline7d.size() * sizeof(double));
+
+    for(const auto& spec : PERIODS) {
+        CoinHistory::Spans spans = c.historicalData.spans(spec.period);
+        w.put<uint8_t>(c.historicalData.has(spec.period) ? 1 : 0);
+        w.put<uint16_t>((uint16_t)spans.size());
+        for(int run = 0; run < 2; run++) w.putBytes(spans.times[run], spans.lengths[run] * sizeof(long long));
+        for(int run = 0; run < 2; run++) w.putBytes(spans.prices[run], spans.lengths[run] * sizeof(double));
+    }
+}
+
+bool readCoin(Reader& r, CoinData& c) {
+    c.id = r.getString();
+    c.rank = r.get<int32_t>();
+    c.name = r.getString();
+    c.symbol = r.getString();
+    c.logo = r.getString();
+    for(double* v : {&c.price, &c.change24h, &c.marketCap, &c.volume24h, &c.circulatingSupply,
+                     &c.totalSupply, &c.maxSupply, &c.ath, &c.athChangePercentage}) {
+        *v = r.get<double>();
+    }
+    c.athDate = r.getString();
+
+    uint32_t sparkSize = r.get<uint32_t>();
+    const char* spark = r.getBytes((size_t)sparkSize * sizeof(double));
+    if(!spark) return false;
+    c.sparkline7d.resize(sparkSize);
+    memcpy(c.sparkline7d.data(), spark, (size_t)sparkSize * sizeof(double));
+
+    vector<pair<long long, double>> points;
+    for(const auto& spec : PERIODS) {
+        bool loaded = r.get<uint8_t>() != 0;
+        uint16_t count = r.get<uint16_t>();
+        const char* times = r.getBytes((size_t)count * sizeof(long long));
+        const char* prices = r.getBytes((size_t)count * sizeof(double));
+        if(!times || !prices) return false;
+        if(!loaded) continue;
+
+        points.resize(count);
+        for(size_t k = 0; k < count; k++) {
+            memcpy(&points[k].first, times + k * sizeof(long long), sizeof(long long));
+            memcpy(&points[k].second, prices + k * sizeof(double), sizeof(double));
+        }
+        c.historicalData.mutate().assign(spec.period, points);
+    }
+    return r.ok();
+}
+
+} // namespace
+
+string encodeSnapshotPayload(const MarketSnapshot& snapshot) {
+    Writer payload;
+    for(const auto& coin : snapshot.coins) writeCoin(payload, coin);
+
+    const GlobalStats& g = snapshot.globalStats;
+    for(double v : {g.totalMarketCap, g.totalVolume, g.btcDominance, g.marketCapChange24h, g.volumeChange24h}) {
+        payload.put<double>(v);
+    }
+    payload.put<int32_t>(g.activeCryptocurrencies);
+
+    payload.put<uint32_t>((uint32_t)snapshot.trendingCoins.size());
+    for(const auto& tc : snapshot.trendingCoins) {
+        payload.putString(tc.id);
+        payload.putString(tc.name);
+        payload.putString(tc.symbol);
+        payload.putString(tc.logo);
+        payload.put<int32_t>(tc.rank);
+    }
+    payload.put<uint32_t>((uint32_t)snapshot.trendingCategories.size());
+    for(const auto& cat : snapshot.trendingCategories) {
+        payload.putString(cat.name);
+        payload.putString(cat.trend);
+    }
+
+    payload.put<uint32_t>((uint32_t)snapshot.fx.perUsd.size());
+    for(const auto& [code, rate] : snapshot.fx.perUsd) {
+        payload.putString(code);
+        payload.put<double>(rate);
+    }
+    payload.put<uint64_t>(snapshot.fx.changedAt);
+
+    return move(payload.buffer());
+}
+
+bool decodeSnapshotPayload(const char* payload, size_t size, uint32_t coinCount, uint32_t formatVersion,
+                           MarketSnapshot& out) {
+    Reader r(payload, size);
+    MarketSnapshot loaded;
+    loaded.coins.resize(coinCount);
+    for(auto& coin : loaded.coins) {
+        if(!readCoin(r, coin)) break;
+    }
+
+    GlobalStats& g = loaded.globalStats;
+    for(double* v : {&g.totalMarketCap, &g.totalVolume, &g.btcDominance, &g.marketCapChange24h, &g.volumeChange24h}) {
+        *v = r.get<double>();
+    }
+    g.activeCryptocurrencies = r.get<int32_t>();
+
+    loaded.trendingCoins.resize(r.get<uint32_t>() & 0xFFFF);
+    for(auto& tc : loaded.trendingCoins) {
+        tc.id = r.getString();
+        tc.name = r.getString();
+        tc.symbol = r.getString();
+        tc.logo = r.getString();
+        tc.rank = r.get<int32_t>();
+    }
+    loaded.trendingCategories.resize(r.get<uint32_t>() & 0xFFFF);
+    for(auto& cat : loaded.trendingCategories) {
+        cat.name = r.getString();
+        cat.trend = r.getString();
+    }
+
+    // Version 1 files predate exchange rates
+    if(formatVersion >= 2) {
+        uint32_t rateCount = r.get<uint32_t>() & 0xFFFF;
+        for(uint32_t i = 0; i < rateCount && r.ok(); i++) {
+            string code = r.getString();
+            double rate = r.get<double>();
+            loaded.fx.perUsd[move(code)] = rate;
+        }
+        loaded.fx.changedAt = r.get<uint64_t>();
+    }
+
+    if(!r.ok() || !r.atEnd()) return false;
+
+    loaded.index.rebuild(loaded.coins);
+    out = move(loaded);
+    return true;
+}
+
+bool saveSnapshotFile(const MarketSnapshot& snapshot, const string& path) {
+    string body = encodeSnapshotPayload(snapshot);
+
+    SnapshotFileHeader header = {};
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.byteOrder = BYTE_ORDER_MARK;
+    header.formatVersion = SNAPSHOT_FORMAT_VERSION;
+    header.dataVersion = snapshot.version;
+    header.savedAt = time(nullptr);
+    header.publishedAt = snapshot.publishedAt;
+    header.coinCount = (uint32_t)snapshot.coins.size();
+    header.periodCount = (uint32_t)PERIOD_COUNT;
+    header.payloadSize = body.size();
+    header.payloadCrc32 = (uint32_t)crc32(0L, reinterpret_cast<const Bytef*>(body.data()), (uInt)body.size());
+
+    string tmpPath = path + ".tmp";
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if(!f) {
+        cerr << "❌ Cannot write snapshot file " << tmpPath << endl;
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+              fwrite(body.data(), 1, body.size(), f) == body.size();
+    ok = (fflush(f) == 0) && ok;
+    ok = (fsync(fileno(f)) == 0) && ok;
+    ok = (fclose(f) == 0) && ok;
+
+    if(!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        cerr << "❌ Failed to save snapshot file " << path << endl;
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool loadSnapshotFile(const string& path, MarketSnapshot& out, SnapshotFileInfo* info) {
+    MappedFile file(path);
+    if(!file.data()) return false;
+
+    if(file.size() < sizeof(SnapshotFileHeader)) {
+        cerr << "⚠️  Snapshot file " << path << " is truncated" << endl;
+        return false;
+    }
+
+    SnapshotFileHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+    if(memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+       header.byteOrder != BYTE_ORDER_MARK ||
+       header.formatVersion < 1 || header.formatVersion > SNAPSHOT_FORMAT_VERSION ||
+       header.periodCount != PERIOD_COUNT) {
+        cerr << "⚠️  Snapshot file " << path << " has an incompatible format, ignoring it" << endl;
+        return false;
+    }
+    if(header.payloadSize != file.size() - sizeof(header)) {
+        cerr << "⚠️  Snapshot file " << path << " is truncated" << endl;
+        return false;
+    }
+
+    const char* payload = file.data() + sizeof(header);
+    uint32_t crc = (uint32_t)crc32(0L, reinterpret_cast<const Bytef*>(payload), (uInt)header.payloadSize);
+    if(crc != header.payloadCrc32) {
+        cerr << "⚠️  Snapshot file " << path << " failed its checksum, ignoring it" << endl;
+        return false;
+    }
+
+    MarketSnapshot loaded;
+    if(!decodeSnapshotPayload(payload, header.payloadSize, header.coinCount, header.formatVersion, loaded)) {
+        cerr << "⚠️  Snapshot file " << path << " is malformed, ignoring it" << endl;
+        return false;
+    }
+    loaded.version = header.dataVersion;
+    loaded.publishedAt = header.publishedAt;
+    out = move(loaded);
+
+    if(info) {
+        info->dataVersion = header.dataVersion;
+        info->savedAt = header.savedAt;
+        info->coinCount = header.coinCount;
+        info->fileSize = file.size();
+    }
+    return true;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "market_snapshot.h"
+
+// Warm-start persistence: the full market state (coins with their rolling
+// history windows, global stats, trending, exchange rates) in a versioned,
+// checksummed binary file. The file is memory-mapped on load and decoded
+// straight from the mapping.
+//
+// Layout (native little-endian):
+//   SnapshotFileHeader
+//   payload: coins, global stats, trending coins, trending categories,
+//            exchange rates (from version 2). Strings are u32 length +
+//            bytes. Each coin's history is stored per period as u8 loaded,
+//            u16 count, then count timestamps followed by count prices
+//            (oldest first).
+
+constexpr uint32_t SNAPSHOT_FORMAT_VERSION = 2;
+
+struct SnapshotFileHeader {
+    char magic[8];              // "CLZSNAP\0"
+    uint32_t byteOrder;         // 0x01020304 as written by the producer
+    uint32_t formatVersion;     // SNAPSHOT_FORMAT_VERSION (1 is still read)
+    uint64_t dataVersion;       // MarketSnapshot::version that was saved
+    int64_t savedAt;            // unix seconds
+    int64_t publishedAt;        // MarketSnapshot::publishedAt
+    uint32_t coinCount;
+    uint32_t periodCount;       // PERIOD_COUNT when written
+    uint64_t payloadSize;
+    uint32_t payloadCrc32;
+    uint32_t reserved;
+};
+
+struct SnapshotFileInfo {
+    uint64_t dataVersion = 0;
+    long long savedAt = 0;
+    uint32_t coinCount = 0;
+    uint64_t fileSize = 0;
+};
+
+// Write `snapshot` to `path` atomically (temp file + rename).
+// Returns false and logs on failure.
+bool saveSnapshotFile(const MarketSnapshot& snapshot, const std::string& path);
+
+// Map and decode `path` into `out` (market data only; responses are not
+// rendered). Returns false - leaving `out` untouched - if the file is missing,
+// truncated, from another format version or fails its checksum.
+bool loadSnapshotFile(const std::string& path, MarketSnapshot& out, SnapshotFileInfo* info = nullptr);
+
+// The payload on its own, for other containers of it (see replica.h)
+std::string encodeSnapshotPayload(const MarketSnapshot& snapshot);
+
+// Decode a payload of `formatVersion` into `out` (market data and the coin
+// index; version and publishedAt are the container's). Bounds-checked, so
+// safe on a torn or corrupt payload: returns false and leaves `out` untouched.
+bool decodeSnapshotPayload(const char* payload, size_t size, uint32_t coinCount, uint32_t formatVersion,
+                           MarketSnapshot& out);
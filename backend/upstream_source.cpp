@@ -0,0 +1,213 @@
+#include "upstream_source.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+// Replayed bodies reach the sink in chunks of about what a socket read returns
+const size_t REPLAY_CHUNK_BYTES = 16 * 1024;
+
+const char* envOr(const char* name, const char* fallback) {
+    const char* value = getenv(name);
+    return value && *value ? value : fallback;
+}
+
+bool readFile(const string& path, string& out) {
+    FILE* f = fopen(path.c_str(), "rb");
+    if(!f) return false;
+    out.clear();
+    char buffer[64 * 1024];
+    size_t n;
+    while((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+        out.append(buffer, n);
+    }
+    bool ok = !ferror(f);
+    fclose(f);
+    return ok;
+}
+
+bool fileExists(const string& path) {
+    struct stat info;
+    return stat(path.c_str(), &info) == 0;
+}
+
+// Written via a temp file so a replay never picks up half a body
+bool writeFile(const string& path, const string& body) {
+    string tmpPath = path + ".tmp";
+    FILE* f = fopen(tmpPath.c_str(), "wb");
+    if(!f) return false;
+    bool ok = fwrite(body.data(), 1, body.size(), f) == body.size();
+    ok = (fclose(f) == 0) && ok;
+    if(!ok || rename(tmpPath.c_str(), path.c_str()) != 0) {
+        remove(tmpPath.c_str());
+        return false;
+    }
+    return true;
+}
+
+string recordingPath(const string& dir, const string& key, int n) {
+    return dir + "/" + key + "." + to_string(n) + ".json";
+}
+
+// Passes a streamed body on to the caller's sink while keeping a copy
+class TeeSink : public ResponseSink {
+public:
+    explicit TeeSink(shared_ptr<ResponseSink> inner) : inner_(move(inner)) {}
+
+    void reset() override {
+        copy_.clear();
+        inner_->reset();
+    }
+
+    bool write(const char* data, size_t size) override {
+        copy_.append(data, size);
+        return inner_->write(data, size);
+    }
+
+    string& copy() { return copy_; }
+
+private:
+    shared_ptr<ResponseSink> inner_;
+    string copy_;
+};
+
+} // namespace
+
+UpstreamConfig UpstreamConfig::fromEnv(string* error) {
+    UpstreamConfig config;
+
+    string mode = envOr("UPSTREAM_MODE", "live");
+    if(mode == "record") {
+        config.mode = Mode::Record;
+    } else if(mode == "replay") {
+        config.mode = Mode::Replay;
+    } else if(mode != "live" && error) {
+        *error = "unknown UPSTREAM_MODE '" + mode + "' (expected live, record or replay)";
+    }
+
+    config.baseUrl = envOr("COINGECKO_BASE_URL", config.baseUrl.c_str());
+    config.apiKey = envOr("COINGECKO_API_KEY", "");
+    config.recordDir = envOr("UPSTREAM_RECORD_DIR", config.recordDir.c_str());
+    config.replayLatency = chrono::milliseconds(max(0, atoi(envOr("REPLAY_LATENCY_MS", "0"))));
+    double compression = atof(envOr("REPLAY_TIME_COMPRESSION", "1"));
+    config.timeCompression = compression > 0 ? compression : 1;
+    return config;
+}
+
+LiveSource::LiveSource(string baseUrl, FetchSchedulerOptions options)
+    : baseUrl_(move(baseUrl)), scheduler_(move(options)) {}
+
+future<FetchResult> LiveSource::submit(FetchPriority priority, const string& endpoint, shared_ptr<ResponseSink> sink) {
+    return scheduler_.submit(priority, baseUrl_ + endpoint, move(sink));
+}
+
+string recordingKey(const string& endpoint) {
+    string key = endpoint;
+    for(char& c : key) {
+        bool keep = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+                    c == '.' || c == '_' || c == '-';
+        if(!keep) c = '_';
+    }
+    return key;
+}
+
+RecordSource::RecordSource(unique_ptr<LiveSource> live, string dir) : live_(move(live)), dir_(move(dir)) {
+    if(mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+        cerr << "❌ Cannot create recording directory " << dir_ << endl;
+    }
+}
+
+string RecordSource::nextPath(const string& endpoint) {
+    string key = recordingKey(endpoint);
+    lock_guard<mutex> lock(mutex_);
+    return recordingPath(dir_, key, counts_[key]++);
+}
+
+future<FetchResult> RecordSource::submit(FetchPriority priority, const string& endpoint, shared_ptr<ResponseSink> sink) {
+    // Numbered at submit time, so pages queued together keep their order
+    string path = nextPath(endpoint);
+    shared_ptr<TeeSink> tee = sink ? make_shared<TeeSink>(move(sink)) : nullptr;
+
+    // Saved by the worker as the request finishes; the request owns the tee
+    auto record = [tee, path](const FetchResult& result) {
+        if(result.ok() && !writeFile(path, tee ? tee->copy() : result.body)) {
+            cerr << "⚠️  Failed to record " << path << endl;
+        }
+    };
+    return live_->scheduler()->submit(priority, live_->baseUrl() + endpoint, tee, record);
+}
+
+ReplaySource::ReplaySource(string dir, chrono::milliseconds latency, double timeCompression)
+    : dir_(move(dir)), latency_(latency), timeCompression_(timeCompression) {}
+
+string ReplaySource::nextPath(const string& endpoint) {
+    string key = recordingKey(endpoint);
+    lock_guard<mutex> lock(mutex_);
+    int& cursor = cursors_[key];
+    string path = recordingPath(dir_, key, cursor);
+    if(fileExists(path)) {
+        cursor++;
+    } else if(cursor > 0) {
+        path = recordingPath(dir_, key, cursor - 1);
+    }
+    return path;
+}
+
+future<FetchResult> ReplaySource::submit(FetchPriority, const string& endpoint, shared_ptr<ResponseSink> sink) {
+    string path = nextPath(endpoint);
+
+    // Every request runs at once: there is no quota to pace against
+    return async(launch::async, [this, path, endpoint, sink]() {
+        auto start = chrono::steady_clock::now();
+        this_thread::sleep_for(latency_);
+
+        FetchResult result;
+        result.attempts = 1;
+        string body;
+        if(!readFile(path, body)) {
+            result.status = 404;
+            result.error = "no recording for " + endpoint;
+            return result;
+        }
+
+        result.status = 200;
+        if(sink) {
+            sink->reset();
+            for(size_t offset = 0; offset < body.size(); offset += REPLAY_CHUNK_BYTES) {
+                if(!sink->write(body.data() + offset, min(REPLAY_CHUNK_BYTES, body.size() - offset))) {
+                    result.status = 0;
+                    result.error = "malformed response body";
+                    break;
+                }
+            }
+        } else {
+            result.body = move(body);
+        }
+        result.timing.totalUs =
+            chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+        return result;
+    });
+}
+
+unique_ptr<UpstreamSource> makeUpstreamSource(const UpstreamConfig& config, FetchSchedulerOptions options) {
+    if(config.mode == UpstreamConfig::Mode::Replay) {
+        return make_unique<ReplaySource>(config.recordDir, config.replayLatency, config.timeCompression);
+    }
+
+    if(!config.apiKey.empty()) {
+        options.headers.push_back("x-cg-demo-api-key: " + config.apiKey);
+    }
+    auto live = make_unique<LiveSource>(config.baseUrl, move(options));
+    if(config.mode == UpstreamConfig::Mode::Record) {
+        return make_unique<RecordSource>(move(live), config.recordDir);
+    }
+    return live;
+}
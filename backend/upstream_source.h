@@ -0,0 +1,124 @@
+#pragma once
+
+#include <chrono>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "fetch_scheduler.h"
+
+// Where upstream responses come from. Requests name an endpoint relative to
+// the API root ("/global", "/coins/markets?vs_currency=usd&page=1", ...), so
+// callers never see the base URL or credentials.
+class UpstreamSource {
+public:
+    virtual ~UpstreamSource() = default;
+
+    // Same contract as FetchScheduler::submit: a 2xx body is streamed into
+    // `sink` when given, and the request holds the sink until it finishes
+    virtual std::future<FetchResult> submit(FetchPriority priority, const std::string& endpoint,
+                                            std::shared_ptr<ResponseSink> sink = nullptr) = 0;
+
+    // "live", "record" or "replay", for logs and /health
+    virtual const char* name() const = 0;
+
+    // The rate-limited HTTP client behind this source, if there is one
+    virtual FetchScheduler* scheduler() { return nullptr; }
+
+    // How much faster than real time the server's schedule runs (replay only)
+    virtual double timeCompression() const { return 1; }
+};
+
+// Upstream settings, all from the environment:
+//   UPSTREAM_MODE          live (default), record or replay
+//   COINGECKO_BASE_URL     API root (default https://api.coingecko.com/api/v3)
+//   COINGECKO_API_KEY      sent as x-cg-demo-api-key when set
+//   UPSTREAM_RECORD_DIR    where record writes and replay reads (default upstream-recordings)
+//   REPLAY_LATENCY_MS      delay before each replayed response (default 0)
+//   REPLAY_TIME_COMPRESSION  schedule speed-up in replay, e.g. 60 = 5-minute ticks every 5s (default 1)
+struct UpstreamConfig {
+    enum class Mode { Live, Record, Replay };
+
+    Mode mode = Mode::Live;
+    std::string baseUrl = "https://api.coingecko.com/api/v3";
+    std::string apiKey;
+    std::string recordDir = "upstream-recordings";
+    std::chrono::milliseconds replayLatency{0};
+    double timeCompression = 1;
+
+    // Unknown modes are reported in `error` and fall back to live
+    static UpstreamConfig fromEnv(std::string* error = nullptr);
+};
+
+// Real HTTP through a FetchScheduler (token bucket, priorities, retries)
+class LiveSource : public UpstreamSource {
+public:
+    LiveSource(std::string baseUrl, FetchSchedulerOptions options);
+
+    std::future<FetchResult> submit(FetchPriority priority, const std::string& endpoint,
+                                    std::shared_ptr<ResponseSink> sink = nullptr) override;
+    const char* name() const override { return "live"; }
+    FetchScheduler* scheduler() override { return &scheduler_; }
+
+    const std::string& baseUrl() const { return baseUrl_; }
+
+private:
+    std::string baseUrl_;
+    FetchScheduler scheduler_;
+};
+
+// Recorded responses are stored one file per response, keyed by endpoint:
+// <dir>/<key>.<n>.json, where key is the endpoint with anything outside
+// [A-Za-z0-9._-] replaced by '_' and n counts responses to that endpoint
+// (0, 1, ...). A replay serves them in the same order.
+std::string recordingKey(const std::string& endpoint);
+
+// Live, plus every successful body written to disk for a later replay. Bodies
+// are saved on the scheduler's worker as requests finish, so a caller that
+// drops its future still gets its response recorded.
+// Record into an empty directory: files from a longer earlier run are not removed.
+class RecordSource : public UpstreamSource {
+public:
+    RecordSource(std::unique_ptr<LiveSource> live, std::string dir);
+
+    std::future<FetchResult> submit(FetchPriority priority, const std::string& endpoint,
+                                    std::shared_ptr<ResponseSink> sink = nullptr) override;
+    const char* name() const override { return "record"; }
+    FetchScheduler* scheduler() override { return live_->scheduler(); }
+
+private:
+    std::string nextPath(const std::string& endpoint);
+
+    std::unique_ptr<LiveSource> live_;
+    std::string dir_;
+    std::mutex mutex_;
+    std::map<std::string, int> counts_;
+};
+
+// Serves a recording with no network and no rate limit: each request waits
+// `latency`, then gets the endpoint's next recorded body (the last one again
+// once they run out). A missing recording answers 404.
+class ReplaySource : public UpstreamSource {
+public:
+    ReplaySource(std::string dir, std::chrono::milliseconds latency, double timeCompression);
+
+    std::future<FetchResult> submit(FetchPriority priority, const std::string& endpoint,
+                                    std::shared_ptr<ResponseSink> sink = nullptr) override;
+    const char* name() const override { return "replay"; }
+    double timeCompression() const override { return timeCompression_; }
+
+private:
+    std::string nextPath(const std::string& endpoint);
+
+    std::string dir_;
+    std::chrono::milliseconds latency_;
+    double timeCompression_;
+    std::mutex mutex_;
+    std::map<std::string, int> cursors_;
+};
+
+// The source a config asks for. `options` configures the HTTP client of the
+// live and record modes; the API key header is added from the config.
+std::unique_ptr<UpstreamSource> makeUpstreamSource(const UpstreamConfig& config, FetchSchedulerOptions options);
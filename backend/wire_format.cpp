@@ -0,0 +1,355 @@
+#include "wire_format.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+// RFC 8746 typed array tags
+const uint8_t CBOR_TAG_INT64_LE = 79;
+const uint8_t CBOR_TAG_FLOAT64_LE = 86;
+
+// CBOR major types
+const uint8_t CBOR_UINT = 0, CBOR_NEGINT = 1, CBOR_BYTES = 2, CBOR_TEXT = 3, CBOR_ARRAY = 4, CBOR_MAP = 5, CBOR_TAG = 6;
+
+bool hostIsLittleEndian() {
+    const uint16_t probe = 1;
+    uint8_t first;
+    memcpy(&first, &probe, 1);
+    return first == 1;
+}
+
+void putBigEndian(string& out, uint64_t value, size_t bytes) {
+    for(size_t i = bytes; i-- > 0;) out.push_back((char)(value >> (8 * i)));
+}
+
+// Head of a CBOR data item: major type plus the shortest length/value encoding
+void cborHead(string& out, uint8_t major, uint64_t value) {
+    uint8_t type = uint8_t(major << 5);
+    if(value < 24) {
+        out.push_back((char)(type | value));
+    } else if(value <= 0xFF) {
+        out.push_back((char)(type | 24));
+        putBigEndian(out, value, 1);
+    } else if(value <= 0xFFFF) {
+        out.push_back((char)(type | 25));
+        putBigEndian(out, value, 2);
+    } else if(value <= 0xFFFFFFFFull) {
+        out.push_back((char)(type | 26));
+        putBigEndian(out, value, 4);
+    } else {
+        out.push_back((char)(type | 27));
+        putBigEndian(out, value, 8);
+    }
+}
+
+// msgpack length prefix: fix form when it fits, else the 16/32-bit marker
+void msgpackLength(string& out, size_t length, uint8_t fix, size_t fixMax, uint8_t marker8, uint8_t marker16,
+                   uint8_t marker32) {
+    if(fix && length <= fixMax) {
+        out.push_back((char)(fix | length));
+    } else if(marker8 && length <= 0xFF) {
+        out.push_back((char)marker8);
+        putBigEndian(out, length, 1);
+    } else if(length <= 0xFFFF) {
+        out.push_back((char)marker16);
+        putBigEndian(out, length, 2);
+    } else {
+        out.push_back((char)marker32);
+        putBigEndian(out, length, 4);
+    }
+}
+
+void jsonString(string& out, string_view value) {
+    static const char HEX[] = "0123456789abcdef";
+    out.push_back('"');
+    for(char c : value) {
+        switch(c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if((unsigned char)c < 0x20) {
+                    out += "\\u00";
+                    out.push_back(HEX[(unsigned char)c >> 4]);
+                    out.push_back(HEX[c & 0xF]);
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+    out.push_back('"');
+}
+
+template<typename T>
+void jsonNumber(string& out, T value) {
+    char buffer[32];
+    auto result = to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+} // namespace
+
+const char* Representation::contentType() const {
+    switch(format) {
+        case WireFormat::MsgPack: return "application/msgpack";
+        case WireFormat::Cbor: return "application/cbor";
+        default: return "application/json";
+    }
+}
+
+string Representation::tag() const {
+    string tag = format == WireFormat::MsgPack ? "msgpack" : format == WireFormat::Cbor ? "cbor" : "";
+    if(layout == SeriesLayout::Columns) tag += tag.empty() ? "columns" : "+columns";
+    return tag;
+}
+
+bool negotiateRepresentation(string_view accept, const char* layout, Representation& out, string& error) {
+    out = Representation();
+
+    if(layout) {
+        string_view value = layout;
+        if(value == "columns") {
+            out.layout = SeriesLayout::Columns;
+        } else if(value != "rows") {
+            error = "Unknown layout: " + string(value) + " (use rows or columns)";
+            return false;
+        }
+    }
+
+    // q of each format; JSON also takes wildcard ranges, the binary formats
+    // only count when named
+    double json = -1, msgpack = -1, cbor = -1, wildcard = -1;
+    while(!accept.empty()) {
+        size_t comma = accept.find(',');
+        string_view item = accept.substr(0, comma);
+        accept.remove_prefix(comma == string_view::npos ? accept.size() : comma + 1);
+
+        size_t semi = item.find(';');
+        string_view type = item.substr(0, semi);
+        while(!type.empty() && type.front() == ' ') type.remove_prefix(1);
+        while(!type.empty() && type.back() == ' ') type.remove_suffix(1);
+
+        double q = 1.0;
+        for(size_t at = semi; at != string_view::npos;) {
+            string_view param = item.substr(at + 1);
+            size_t next = param.find(';');
+            param = param.substr(0, next);
+            while(!param.empty() && param.front() == ' ') param.remove_prefix(1);
+            if(param.size() > 2 && param[0] == 'q' && param[1] == '=') q = strtod(string(param.substr(2)).c_str(), nullptr);
+            at = next == string_view::npos ? next : at + 1 + next;
+        }
+
+        if(type == "application/json") {
+            json = q;
+        } else if(type == "application/msgpack" || type == "application/x-msgpack" ||
+                  type == "application/vnd.msgpack") {
+            msgpack = q;
+        } else if(type == "application/cbor") {
+            cbor = q;
+        } else if(type == "*/*" || type == "application/*") {
+            wildcard = max(wildcard, q);
+        }
+    }
+    if(json < 0) json = wildcard;
+
+    if(msgpack > 0 && msgpack > json && msgpack >= cbor) {
+        out.format = WireFormat::MsgPack;
+    } else if(cbor > 0 && cbor > json) {
+        out.format = WireFormat::Cbor;
+    }
+    return true;
+}
+
+WireWriter::WireWriter(WireFormat format) : format_(format) {}
+
+void WireWriter::beforeValue() {
+    if(format_ != WireFormat::Json) return;
+    if(afterKey_) {
+        afterKey_ = false;
+        return;
+    }
+    if(!needComma_.empty()) {
+        if(needComma_.back()) out_.push_back(',');
+        needComma_.back() = true;
+    }
+}
+
+void WireWriter::beginMap(size_t entries) {
+    beforeValue();
+    switch(format_) {
+        case WireFormat::Json:
+            out_.push_back('{');
+            needComma_.push_back(false);
+            break;
+        case WireFormat::MsgPack: msgpackLength(out_, entries, 0x80, 15, 0, 0xde, 0xdf); break;
+        case WireFormat::Cbor: cborHead(out_, CBOR_MAP, entries); break;
+    }
+}
+
+void WireWriter::endMap() {
+    if(format_ != WireFormat::Json) return;
+    out_.push_back('}');
+    needComma_.pop_back();
+}
+
+void WireWriter::beginArray(size_t items) {
+    beforeValue();
+    switch(format_) {
+        case WireFormat::Json:
+            out_.push_back('[');
+            needComma_.push_back(false);
+            break;
+        case WireFormat::MsgPack: msgpackLength(out_, items, 0x90, 15, 0, 0xdc, 0xdd); break;
+        case WireFormat::Cbor: cborHead(out_, CBOR_ARRAY, items); break;
+    }
+}
+
+void WireWriter::endArray() {
+    if(format_ != WireFormat::Json) return;
+    out_.push_back(']');
+    needComma_.pop_back();
+}
+
+void WireWriter::key(string_view name) {
+    string(name);
+    if(format_ == WireFormat::Json) {
+        out_.push_back(':');
+        afterKey_ = true;
+    }
+}
+
+void WireWriter::string(string_view value) {
+    beforeValue();
+    switch(format_) {
+        case WireFormat::Json: jsonString(out_, value); return;
+        case WireFormat::MsgPack: msgpackLength(out_, value.size(), 0xa0, 31, 0xd9, 0xda, 0xdb); break;
+        case WireFormat::Cbor: cborHead(out_, CBOR_TEXT, value.size()); break;
+    }
+    out_.append(value);
+}
+
+void WireWriter::integer(long long value) {
+    beforeValue();
+    switch(format_) {
+        case WireFormat::Json:
+            jsonNumber(out_, value);
+            break;
+        case WireFormat::MsgPack:
+            if(value >= -32 && value <= 127) {
+                out_.push_back((char)(int8_t)value); // positive/negative fixint
+            } else if(value >= INT32_MIN && value <= INT32_MAX) {
+                out_.push_back((char)0xd2);
+                putBigEndian(out_, (uint32_t)(int32_t)value, 4);
+            } else {
+                out_.push_back((char)0xd3);
+                putBigEndian(out_, (uint64_t)value, 8);
+            }
+            break;
+        case WireFormat::Cbor:
+            if(value >= 0) {
+                cborHead(out_, CBOR_UINT, (uint64_t)value);
+            } else {
+                cborHead(out_, CBOR_NEGINT, (uint64_t)(-1 - value));
+            }
+            break;
+    }
+}
+
+void WireWriter::number(double value) {
+    if(format_ == WireFormat::Json && !isfinite(value)) {
+        null();
+        return;
+    }
+    beforeValue();
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    switch(format_) {
+        case WireFormat::Json: jsonNumber(out_, value); break;
+        case WireFormat::MsgPack:
+            out_.push_back((char)0xcb);
+            putBigEndian(out_, bits, 8);
+            break;
+        case WireFormat::Cbor:
+            out_.push_back((char)0xfb);
+            putBigEndian(out_, bits, 8);
+            break;
+    }
+}
+
+void WireWriter::null() {
+    beforeValue();
+    switch(format_) {
+        case WireFormat::Json: out_ += "null"; break;
+        case WireFormat::MsgPack: out_.push_back((char)0xc0); break;
+        case WireFormat::Cbor: out_.push_back((char)0xf6); break;
+    }
+}
+
+void WireWriter::beginColumn(size_t count, uint8_t cborTag) {
+    if(format_ == WireFormat::Json) {
+        beginArray(count);
+        return;
+    }
+    beforeValue();
+    if(format_ == WireFormat::MsgPack) {
+        msgpackLength(out_, count * 8, 0, 0, 0xc4, 0xc5, 0xc6);
+    } else {
+        cborHead(out_, CBOR_TAG, cborTag);
+        cborHead(out_, CBOR_BYTES, count * 8);
+    }
+}
+
+void WireWriter::beginFloat64Column(size_t count) {
+    beginColumn(count, CBOR_TAG_FLOAT64_LE);
+}
+
+void WireWriter::beginInt64Column(size_t count) {
+    beginColumn(count, CBOR_TAG_INT64_LE);
+}
+
+void WireWriter::rawColumn(const void* values, size_t count) {
+    const char* bytes = static_cast<const char*>(values);
+    if(hostIsLittleEndian()) {
+        out_.append(bytes, count * 8);
+        return;
+    }
+    for(size_t i = 0; i < count; i++) {
+        for(size_t b = 8; b-- > 0;) out_.push_back(bytes[i * 8 + b]);
+    }
+}
+
+void WireWriter::columnValues(const double* values, size_t count) {
+    if(format_ != WireFormat::Json) {
+        rawColumn(values, count);
+        return;
+    }
+    for(size_t i = 0; i < count; i++) number(values[i]);
+}
+
+void WireWriter::columnValues(const long long* values, size_t count) {
+    static_assert(sizeof(long long) == 8, "int64 columns are written from long long");
+    if(format_ != WireFormat::Json) {
+        rawColumn(values, count);
+        return;
+    }
+    for(size_t i = 0; i < count; i++) integer(values[i]);
+}
+
+void WireWriter::endColumn() {
+    if(format_ == WireFormat::Json) endArray();
+}
+
+string WireWriter::take() {
+    needComma_.clear();
+    afterKey_ = false;
+    return move(out_);
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Serialization formats the API can answer in, chosen by the Accept header
+enum class WireFormat : uint8_t {
+    Json,
+    MsgPack, // application/msgpack
+    Cbor,    // application/cbor
+};
+
+// How time series (chart history, sparklines) are laid out
+enum class SeriesLayout : uint8_t {
+    Rows,    // [{"time":..,"price":..}, ..] and plain number arrays (the default)
+    Columns, // {"t":[..],"p":[..]}; raw little-endian arrays in the binary formats
+};
+
+// Everything about a response body a client chooses besides its content
+// coding: format from Accept, layout from ?layout=columns
+struct Representation {
+    WireFormat format = WireFormat::Json;
+    SeriesLayout layout = SeriesLayout::Rows;
+
+    // Plain JSON rows, i.e. what the pre-rendered bodies hold
+    bool isDefault() const { return format == WireFormat::Json && layout == SeriesLayout::Rows; }
+
+    const char* contentType() const;
+
+    // Short name for ETags and memo keys ("" for the default, "msgpack", "cbor+columns", ...)
+    std::string tag() const;
+};
+
+// Pick a representation from an Accept header (q-values honored; ties and
+// anything unsupported fall back to JSON) and a ?layout= value (may be null).
+// Returns false, with a message in `error`, for an unknown layout.
+bool negotiateRepresentation(std::string_view accept, const char* layout, Representation& out, std::string& error);
+
+// Streaming encoder for the three formats, written straight from the data
+// without building a document first. Containers are sized up front (the
+// binary formats store lengths before contents). Maps take key() before each
+// value. NaN and infinities are written as null in JSON, as nlohmann does.
+class WireWriter {
+public:
+    explicit WireWriter(WireFormat format);
+
+    void beginMap(size_t entries);
+    void endMap();
+    void beginArray(size_t items);
+    void endArray();
+
+    void key(std::string_view name);
+    void string(std::string_view value);
+    void integer(long long value);
+    void number(double value);
+    void null();
+
+    // A column of numbers: a JSON array, or a single raw little-endian typed
+    // array in the binary formats (msgpack bin, CBOR RFC 8746 tag 79/86).
+    // Values may arrive in several runs; their total must match `count`.
+    void beginFloat64Column(size_t count);
+    void beginInt64Column(size_t count);
+    void columnValues(const double* values, size_t count);
+    void columnValues(const long long* values, size_t count);
+    void endColumn();
+
+    // The encoded bytes (the writer is left empty)
+    std::string take();
+
+private:
+    void beforeValue();
+    void beginColumn(size_t count, uint8_t cborTag);
+    void rawColumn(const void* values, size_t count);
+
+    WireFormat format_;
+    std::string out_;
+    std::vector<bool> needComma_; // JSON: per open container
+    bool afterKey_ = false;
+};
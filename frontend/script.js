@@ -18,6 +18,9 @@ const API_BASE_URL = (() => {
 console.log('🦎 API URL:', API_BASE_URL);
 
 const UPDATE_INTERVAL = 5 * 60 * 1000; // 5 minutes
+const STREAM_URL = API_BASE_URL.replace(/^http/, 'ws') + '/stream'; // Live price push
+const STREAM_RETRY_DELAY = 30 * 1000; // Reconnect delay after the stream drops
+const STREAM_POLL_INTERVAL = 15 * 60 * 1000; // Polling while the stream is open, for what it doesn't carry
 const COIN_INFO_URL = 'coin-info.json'; // Local JSON file with detailed coin info
 
 // State management
@@ -28,6 +31,7 @@ let allCoinsData = [];
 let trendingData = {};
 let globalData = {};
 let updateTimer = null;
+let priceSocket = null;
 let coinInfoData = {}; // Store coin detailed info
 
 // ============================================================================
@@ -49,8 +53,17 @@ async function fetchCoins() {
     }
 }
 
-// Fetch detailed coin data including historical charts
+// Points requested per chart period (the server downsamples to this)
+const CHART_POINTS = 200;
+
+// Fetch coin data for the detail page. When the coin list already has the
+// coin, only its chart periods are left to load, one at a time (updateChart)
 async function fetchCoinDetails(coinId) {
+    const listed = allCoinsData.find(c => c.id === coinId);
+    if (listed) {
+        return { ...listed, historicalData: {} };
+    }
+    
     try {
         const response = await fetch(`${API_BASE_URL}/coin/${coinId}`);
         if (!response.ok) {
@@ -64,6 +77,21 @@ async function fetchCoinDetails(coinId) {
     }
 }
 
+// Fetch one chart period of a coin, downsampled on the server
+async function fetchCoinHistory(coinId, period) {
+    try {
+        const response = await fetch(`${API_BASE_URL}/coin/${coinId}/history?period=${period}&points=${CHART_POINTS}`);
+        if (!response.ok) {
+            throw new Error(`HTTP error! status: ${response.status}`);
+        }
+        const data = await response.json();
+        return data.data;
+    } catch (error) {
+        console.error('Error fetching coin history:', error);
+        return null;
+    }
+}
+
 // Fetch global market stats
 async function fetchGlobalStats() {
     try {
@@ -193,8 +221,9 @@ async function loadAllData() {
         console.log('✅ All data loaded successfully!');
         hideLoading();
         
-        // Start auto-update timer
+        // Start auto-update timer, then switch to pushed updates if the stream is available
         startAutoUpdate();
+        startPriceStream();
         
     } catch (error) {
         console.error('Error loading data:', error);
@@ -203,12 +232,27 @@ async function loadAllData() {
     }
 }
 
-// Update live data (every 5 minutes)
+// Update live data (every 5 minutes, or every 15 while the price stream is open)
 async function updateLiveData() {
     console.log('🔄 Updating live data...');
     
     try {
-        const coins = await fetchCoins();
+        const [coins, global, trending] = await Promise.all([
+            fetchCoins(),
+            fetchGlobalStats(),
+            fetchTrending()
+        ]);
+        
+        // Keep what we had if a refresh failed
+        if (global && Object.keys(global).length > 0) {
+            globalData = global;
+            renderGlobalStats();
+        }
+        if (trending && trending.coins && trending.coins.length > 0) {
+            trendingData = trending;
+            renderTrendingCoins();
+            renderTrendingCategories();
+        }
         
         if (coins && coins.length > 0) {
             allCoinsData = coins;
@@ -251,13 +295,77 @@ async function updateLiveData() {
 }
 
 // Start auto-update timer
-function startAutoUpdate() {
+function startAutoUpdate(interval = UPDATE_INTERVAL) {
     if (updateTimer) {
         clearInterval(updateTimer);
     }
     
-    updateTimer = setInterval(updateLiveData, UPDATE_INTERVAL);
-    console.log(`🔄 Auto-update started (every ${UPDATE_INTERVAL / 1000 / 60} minutes)`);
+    updateTimer = setInterval(updateLiveData, interval);
+    console.log(`🔄 Auto-update started (every ${interval / 1000 / 60} minutes)`);
+}
+
+// Subscribe to pushed price ticks. Frames carry only price, rank and 24h
+// change, so while the stream is open we still poll, less often, for market
+// cap, volume, sparklines, global stats and trending. If it drops we go back
+// to polling at the full rate and retry later.
+function startPriceStream() {
+    if (!('WebSocket' in window)) return;
+    
+    priceSocket = new WebSocket(STREAM_URL);
+    let opened = false;
+    
+    priceSocket.onopen = () => {
+        opened = true;
+        console.log('📡 Price stream connected');
+        priceSocket.send(JSON.stringify({ subscribe: '*' }));
+        startAutoUpdate(STREAM_POLL_INTERVAL);
+    };
+    
+    priceSocket.onmessage = (event) => {
+        const frame = JSON.parse(event.data);
+        applyPriceFrame(frame);
+        // Acknowledge so the server keeps sending (flow control)
+        priceSocket.send(JSON.stringify({ ack: frame.v }));
+    };
+    
+    priceSocket.onclose = () => {
+        console.log('📡 Price stream closed, falling back to polling');
+        priceSocket = null;
+        // A failed reconnect leaves the full-rate timer running as it is
+        if (opened || !updateTimer) {
+            startAutoUpdate();
+        }
+        setTimeout(startPriceStream, STREAM_RETRY_DELAY);
+    };
+}
+
+// Apply a stream frame: each entry is [id, price, rank, change24h]
+function applyPriceFrame(frame) {
+    const coinsById = new Map(allCoinsData.map(coin => [coin.id, coin]));
+    let selectedChanged = false;
+    
+    for (const [id, price, rank, change24h] of frame.d) {
+        const coin = coinsById.get(id);
+        if (coin) {
+            coin.price = price;
+            coin.rank = rank;
+            coin.change24h = change24h;
+        }
+        if (selectedCoin && selectedCoin.id === id) {
+            selectedChanged = true;
+        }
+    }
+    
+    if (frame.type !== 'tick') return;
+    
+    if (!selectedCoin) {
+        renderCoinList(allCoinsData.slice(0, 20), 'coin-list');
+        renderCoinList(allCoinsData, 'all-coins-list');
+        renderTopMovers();
+    } else if (selectedChanged) {
+        // The detail page also needs the new chart point
+        updateLiveData();
+    }
 }
 
 // ============================================================================
@@ -568,6 +676,7 @@ async function showDetailPage(coinId) {
         }
         
         // Initialize chart with 24h period
+        document.querySelectorAll('.chart-btn').forEach(b => b.classList.toggle('active', b.getAttribute('data-period') === '24h'));
         updateChart(coin, '24h');
         
         hideLoading();
@@ -600,13 +709,30 @@ function hideDetailPage() {
 // ============================================================================
 
 // Update chart with Chart.js
-function updateChart(coin, period) {
+async function updateChart(coin, period) {
     // Check if Chart.js is loaded
     if (typeof Chart === 'undefined') {
         console.error('Chart.js is not loaded');
         return;
     }
     
+    // Load the period on first use
+    if (!coin.historicalData) {
+        coin.historicalData = {};
+    }
+    if (!coin.historicalData[period]) {
+        const points = await fetchCoinHistory(coin.id, period);
+        if (points) {
+            coin.historicalData[period] = points;
+        }
+        
+        // The user may have moved on while this was loading
+        const activePeriod = document.querySelector('.chart-btn.active');
+        if (selectedCoin !== coin || (activePeriod && activePeriod.getAttribute('data-period') !== period)) {
+            return;
+        }
+    }
+    
     // Destroy existing chart if it exists
     if (currentChart) {
         currentChart.destroy();
@@ -764,25 +890,51 @@ function updateChart(coin, period) {
 // SEARCH FUNCTIONALITY
 // ============================================================================
 
+// Search on the server (/api/search matches symbols, names, ids and
+// descriptions, with typos); the local coin list is the fallback
+async function searchCoins(query) {
+    try {
+        const response = await fetch(`${API_BASE_URL}/search?q=${encodeURIComponent(query)}&limit=5`);
+        if (!response.ok) throw new Error(`HTTP ${response.status}`);
+        const data = await response.json();
+        return data.results;
+    } catch (error) {
+        console.warn('Search API unavailable, filtering locally:', error);
+        return allCoinsData.filter(coin => 
+            coin.name.toLowerCase().includes(query) ||
+            coin.symbol.toLowerCase().includes(query)
+        ).slice(0, 5); // Show top 5 results
+    }
+}
+
 function setupSearch() {
     const searchInput = document.getElementById('search-input');
     const searchDropdown = document.getElementById('search-dropdown');
     
     if (!searchInput || !searchDropdown) return;
     
+    let searchTimer = null;
+    let latestQuery = '';
+    
     searchInput.addEventListener('input', (e) => {
         const query = e.target.value.toLowerCase().trim();
+        latestQuery = query;
+        clearTimeout(searchTimer);
         
         if (query.length === 0) {
             searchDropdown.classList.remove('active');
             return;
         }
         
-        // Filter coins
-        const results = allCoinsData.filter(coin => 
-            coin.name.toLowerCase().includes(query) ||
-            coin.symbol.toLowerCase().includes(query)
-        ).slice(0, 5); // Show top 5 results
+        // Wait for a pause in typing before asking the server
+        searchTimer = setTimeout(() => showSearchResults(query), 120);
+    });
+    
+    async function showSearchResults(query) {
+        const results = await searchCoins(query);
+        
+        // A newer query has been typed meanwhile
+        if (query !== latestQuery) return;
         
         // Clear previous results
         searchDropdown.innerHTML = '';
@@ -815,7 +967,7 @@ function setupSearch() {
         });
         
         searchDropdown.classList.add('active');
-    });
+    }
     
     // Close dropdown when clicking outside
     document.addEventListener('click', (e) => {
@@ -1013,4 +1165,8 @@ window.addEventListener('beforeunload', () => {
     if (updateTimer) {
         clearInterval(updateTimer);
     }
+    if (priceSocket) {
+        priceSocket.onclose = null;
+        priceSocket.close();
+    }
 });